@@ -0,0 +1,483 @@
+/* action.c
+   Commands executed by the daemons, tokenized once and launched without a
+   shell.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "action.h"
+
+#include <limits.h>     // PATH_MAX
+#include <signal.h>     // sigset_t
+#include <spawn.h>      // posix_spawn
+#include <stdlib.h>     // malloc
+#include <string.h>     // strdup
+#include <sys/stat.h>   // stat
+#include <unistd.h>     // environ
+
+// Shell used to execute the commands that start by ACTION_SHELL_PREFIX
+#define ACTION_SHELL    "/bin/sh"
+
+// Search path used when the PATH environment variable is not set
+#define ACTION_DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+
+// Characters that have a special meaning for the shell outside quotes. A
+// command that contains any of them needs the shell to be executed.
+#define ACTION_SHELL_CHARS  "|&;<>()$`*?["
+
+// Error message for the commands that need the shell
+#define ACTION_SHELL_ERROR  \
+    "shell syntax in command (use '!' to run it in a shell)"
+
+extern char **environ;
+
+/* Allocate memory for an action, from its arena or with malloc.
+
+   Parameters:
+     * a: the action.
+     * size: the number of bytes.
+
+   Return the memory, or NULL if it couldn't be allocated.
+*/
+static void*
+action_alloc(struct action_t *a, size_t size)
+{
+    return a->arena ? arena_alloc(a->arena, size) : malloc(size);
+}
+
+/* Duplicate a string for an action, in its arena or with malloc.
+
+   Parameters:
+     * a: the action.
+     * str: the string.
+
+   Return the copy, or NULL if it couldn't be allocated.
+*/
+static char*
+action_strdup(struct action_t *a, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *copy = (char*)action_alloc(a, len);
+
+    if (copy) {
+        memcpy(copy, str, len);
+    }
+    return copy;
+}
+
+/* Tokenize the command of an action into its arguments.
+
+   Parameters:
+     * a: the action. Its command must be already set.
+     * error: at output, in case of error, a message that describes it.
+
+   Return 0 if the command was correctly tokenized, 1 otherwise.
+*/
+static int
+action_tokenize(struct action_t *a, const char **error)
+{
+    const char *src = a->command;
+    char *dst;
+    size_t len = strlen(src), n = 0;
+
+    // The arguments are copied unquoted to a buffer, that is never longer
+    // than the command. Each argument takes at least two characters of the
+    // command (itself and a separator), that bounds the number of arguments.
+    a->args = (char*)action_alloc(a, len + 1);
+    a->argv = (char**)action_alloc(a, sizeof(char*) * (len / 2 + 2));
+    if (!a->args || !a->argv) {
+        *error = "out of memory";
+        return 1;
+    }
+    dst = a->args;
+    while (1) {
+        // Skip the blanks before the argument
+        while (*src == ' ' || *src == '\t') src++;
+        if (*src == '\0' || *src == '\n') {
+            break;
+        }
+        if (*src == '#' || *src == '~') {
+            *error = ACTION_SHELL_ERROR;
+            return 1;
+        }
+        a->argv[n++] = dst;
+        // Copy the argument, removing the quotes
+        while (*src != '\0' && *src != ' ' && *src != '\t' && *src != '\n') {
+            if (*src == '\'') {
+                // Single quotes, everything is literal until the next one
+                src++;
+                while (*src != '\'') {
+                    if (*src == '\0') {
+                        *error = "unterminated quote";
+                        return 1;
+                    }
+                    *dst++ = *src++;
+                }
+                src++;
+            } else if (*src == '"') {
+                // Double quotes, only \ escapes the next character
+                src++;
+                while (*src != '"') {
+                    if (*src == '\0') {
+                        *error = "unterminated quote";
+                        return 1;
+                    } else if (*src == '$' || *src == '`') {
+                        *error = ACTION_SHELL_ERROR;
+                        return 1;
+                    } else if (*src == '\\' && src[1] != '\0'
+                        && strchr("\"\\$`", src[1]))
+                    {
+                        src++;
+                    }
+                    *dst++ = *src++;
+                }
+                src++;
+            } else if (*src == '\\') {
+                // Backslash, the next character is literal
+                src++;
+                if (*src == '\0') {
+                    *error = "backslash at the end of the command";
+                    return 1;
+                }
+                *dst++ = *src++;
+            } else if (strchr(ACTION_SHELL_CHARS, *src)
+                || (n == 1 && *src == '='))
+            {
+                // Redirections, pipes, variables, wildcards or an assignment
+                // of an environment variable
+                *error = ACTION_SHELL_ERROR;
+                return 1;
+            } else {
+                *dst++ = *src++;
+            }
+        }
+        *dst++ = '\0';
+    }
+    if (!n) {
+        *error = "empty command";
+        return 1;
+    }
+    a->argv[n] = NULL;
+    return 0;
+}
+
+/* Search the executable of an action in the directories of PATH.
+
+   Parameters:
+     * a: the action. Its arguments must be already set.
+     * error: at output, in case of error, a message that describes it.
+
+   Return 0 if the executable was found, 1 otherwise.
+*/
+static int
+action_resolve(struct action_t *a, const char **error)
+{
+    const char *name = a->argv[0], *dir, *end;
+    size_t nlen = strlen(name), dlen;
+    char path[PATH_MAX];
+    struct stat st;
+
+    // A name with a slash is not searched
+    if (strchr(name, '/')) {
+        a->path = action_strdup(a, name);
+        if (!a->path) {
+            *error = "out of memory";
+            return 1;
+        }
+        return 0;
+    }
+    dir = getenv("PATH");
+    if (!dir) {
+        dir = ACTION_DEFAULT_PATH;
+    }
+    while (1) {
+        end = strchr(dir, ':');
+        if (!end) {
+            end = dir + strlen(dir);
+        }
+        // Build the candidate path (an empty directory is the current one),
+        // only the one that is found is copied to the action
+        dlen = end - dir;
+        if (dlen + nlen + 3 <= sizeof(path)) {
+            if (dlen) {
+                memcpy(path, dir, dlen);
+            } else {
+                path[dlen++] = '.';
+            }
+            path[dlen] = '/';
+            memcpy(path + dlen + 1, name, nlen + 1);
+            if (!stat(path, &st) && S_ISREG(st.st_mode)
+                && !access(path, X_OK))
+            {
+                a->path = action_strdup(a, path);
+                if (!a->path) {
+                    *error = "out of memory";
+                    return 1;
+                }
+                return 0;
+            }
+        }
+        if (*end == '\0') {
+            break;
+        }
+        dir = end + 1;
+    }
+    *error = "command not found";
+    return 1;
+}
+
+/* Tokenize a command and search its executable in PATH.
+   The command is split in words separated by blanks. Single quotes, double
+   quotes and backslashes can be used as in the shell to put blanks or quotes
+   inside a word, but any other shell syntax (redirections, pipes, variables,
+   wildcards...) is rejected. A command that starts by ACTION_SHELL_PREFIX is
+   not tokenized, the rest of it is passed to /bin/sh -c instead.
+
+   Parameters:
+     * a: the action to initialize.
+     * command: the command.
+     * arena: the arena where the strings of the action are allocated, or
+         NULL to allocate them with malloc.
+     * error: at output, in case of error, a message that describes it.
+
+   Return 0 if the action was correctly initialized, 1 otherwise.
+*/
+int
+action_init(struct action_t *a, const char *command, struct arena_t *arena,
+    const char **error)
+{
+    a->path = NULL;
+    a->argv = NULL;
+    a->args = NULL;
+    a->arena = arena;
+    a->command = action_strdup(a, command);
+    if (!a->command) {
+        *error = "out of memory";
+        return 1;
+    }
+    if (command[0] == ACTION_SHELL_PREFIX) {
+        // The command is executed by the shell
+        a->path = action_strdup(a, ACTION_SHELL);
+        a->argv = (char**)action_alloc(a, sizeof(char*) * 4);
+        if (!a->path || !a->argv) {
+            *error = "out of memory";
+            return 1;
+        }
+        a->argv[0] = "sh";
+        a->argv[1] = "-c";
+        a->argv[2] = a->command + 1;
+        a->argv[3] = NULL;
+        return 0;
+    }
+    if (action_tokenize(a, error)) {
+        return 1;
+    }
+    return action_resolve(a, error);
+}
+
+/* Return an upper bound of the bytes that action_init takes from an arena
+   for a command. The command doesn't need to be null terminated.
+
+   Parameters:
+     * command: the command.
+     * len: length of the command.
+*/
+size_t
+action_arena_size(const char *command, size_t len)
+{
+    const char *dir, *end;
+    size_t size = ARENA_SIZE(len + 1), dlen = 1;
+
+    if (len && command[0] == ACTION_SHELL_PREFIX) {
+        return size + ARENA_SIZE(sizeof(ACTION_SHELL))
+            + ARENA_SIZE(sizeof(char*) * 4);
+    }
+    // The arguments, and the path built from the longest directory of PATH
+    dir = getenv("PATH");
+    if (!dir) {
+        dir = ACTION_DEFAULT_PATH;
+    }
+    for (; (end = strchr(dir, ':')); dir = end + 1) {
+        if ((size_t)(end - dir) > dlen) {
+            dlen = end - dir;
+        }
+    }
+    if (strlen(dir) > dlen) {
+        dlen = strlen(dir);
+    }
+    return size + ARENA_SIZE(len + 1)
+        + ARENA_SIZE(sizeof(char*) * (len / 2 + 2))
+        + ARENA_SIZE(dlen + len + 2);
+}
+
+/* Launch a process that executes an action. The process is created with
+   posix_spawn, so the daemon's address space is not copied. The signal mask
+   and the signal dispositions of the new process are reset to the defaults.
+
+   Parameters:
+     * a: the action to execute.
+     * envp: environment of the new process, or NULL to inherit the current
+         one.
+     * pid: at output, the process id of the new process.
+
+   Return 0 if the process was launched, an error number otherwise.
+*/
+int
+action_spawn(struct action_t *a, char *const *envp, pid_t *pid)
+{
+    posix_spawnattr_t attr;
+    sigset_t mask;
+    int e;
+
+    if ((e = posix_spawnattr_init(&attr))) {
+        return e;
+    }
+    // The daemon blocks and ignores some signals, that must not be inherited
+    // by the action
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    sigfillset(&mask);
+    posix_spawnattr_setsigdefault(&attr, &mask);
+    posix_spawnattr_setflags(&attr,
+        POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    e = posix_spawn(pid, a->path, NULL, &attr, a->argv,
+        envp ? envp : environ);
+    posix_spawnattr_destroy(&attr);
+    return e;
+}
+
+/* Append a string to a serialized action, if there's room for it.
+
+   Parameters:
+     * buf: the buffer where the action is being written.
+     * size: size of the buffer.
+     * len: current length of the serialized action.
+     * str: the string to append.
+
+   Return the new length of the serialized action.
+*/
+static size_t
+action_pack_string(char *buf, size_t size, size_t len, const char *str)
+{
+    size_t slen = strlen(str) + 1;
+
+    if (len + slen <= size) {
+        memcpy(buf + len, str, slen);
+    }
+    return len + slen;
+}
+
+/* Serialize an action, so it can be sent to another process. The serialized
+   action is a sequence of null terminated strings: the command, the path and
+   the arguments.
+
+   Parameters:
+     * a: the action to serialize.
+     * buf: the buffer where the action is written.
+     * size: size of the buffer.
+
+   Return the length of the serialized action. If it is greater than size,
+   the buffer was too small and its contents are not valid.
+*/
+size_t
+action_pack(struct action_t *a, char *buf, size_t size)
+{
+    size_t len;
+
+    len = action_pack_string(buf, size, 0, a->command);
+    len = action_pack_string(buf, size, len, a->path);
+    for (char **arg = a->argv; *arg; arg++) {
+        len = action_pack_string(buf, size, len, *arg);
+    }
+    return len;
+}
+
+/* Initialize an action from its serialized form (see action_pack).
+
+   Parameters:
+     * a: the action to initialize.
+     * buf: the serialized action.
+     * len: length of the serialized action.
+
+   Return 0 if the action was correctly initialized, 1 otherwise.
+*/
+int
+action_unpack(struct action_t *a, const char *buf, size_t len)
+{
+    const char *end = buf + len;
+    size_t n = 0;
+    char *ptr;
+
+    a->command = NULL;
+    a->path = NULL;
+    a->argv = NULL;
+    a->args = NULL;
+    a->arena = NULL;
+    // The serialized action must end by a null character and contain at
+    // least the command, the path and one argument
+    if (!len || buf[len - 1] != '\0') {
+        return 1;
+    }
+    for (const char *p = buf; p < end; p += strlen(p) + 1) {
+        n++;
+    }
+    if (n < 3) {
+        return 1;
+    }
+    // The arguments point to a copy of the buffer
+    a->args = (char*)malloc(len);
+    a->argv = (char**)malloc(sizeof(char*) * (n - 1));
+    if (!a->args || !a->argv) {
+        return 1;
+    }
+    memcpy(a->args, buf, len);
+    ptr = a->args;
+    a->command = strdup(ptr);
+    ptr += strlen(ptr) + 1;
+    a->path = strdup(ptr);
+    ptr += strlen(ptr) + 1;
+    if (!a->command || !a->path) {
+        return 1;
+    }
+    for (size_t i = 0; i < n - 2; i++) {
+        a->argv[i] = ptr;
+        ptr += strlen(ptr) + 1;
+    }
+    a->argv[n - 2] = NULL;
+    return 0;
+}
+
+/* Free the memory used by an action. The strings allocated from an arena
+   are freed with the arena.
+
+   Parameters:
+     * a: the action.
+*/
+void
+action_free(struct action_t *a)
+{
+    if (a->arena) {
+        return;
+    }
+    free(a->command);
+    free(a->path);
+    free(a->argv);
+    free(a->args);
+}
+
@@ -0,0 +1,135 @@
+/* action.h
+   Commands executed by the daemons, tokenized once and launched without a
+   shell.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ACTION_H
+#define ACTION_H
+
+#include <sys/types.h>  // pid_t, size_t
+
+#include "arena.h"
+
+// Character that, at the beginning of a command, tells that the command must
+// be executed by the shell.
+#define ACTION_SHELL_PREFIX '!'
+
+// A command ready to be executed
+struct action_t {
+    // The command, as written in the configuration
+    char *command;
+
+    // Path of the executable, already searched in PATH
+    char *path;
+
+    // Arguments of the command, ended by NULL
+    char **argv;
+
+    // Buffer that stores the arguments
+    char *args;
+
+    // Arena of the strings, NULL if they are allocated with malloc
+    struct arena_t *arena;
+};
+
+/* Tokenize a command and search its executable in PATH.
+   The command is split in words separated by blanks. Single quotes, double
+   quotes and backslashes can be used as in the shell to put blanks or quotes
+   inside a word, but any other shell syntax (redirections, pipes, variables,
+   wildcards...) is rejected. A command that starts by ACTION_SHELL_PREFIX is
+   not tokenized, the rest of it is passed to /bin/sh -c instead.
+
+   Parameters:
+     * a: the action to initialize.
+     * command: the command.
+     * arena: the arena where the strings of the action are allocated, or
+         NULL to allocate them with malloc.
+     * error: at output, in case of error, a message that describes it.
+
+   Return 0 if the action was correctly initialized, 1 otherwise.
+*/
+int
+action_init(struct action_t *a, const char *command, struct arena_t *arena,
+    const char **error);
+
+/* Return an upper bound of the bytes that action_init takes from an arena
+   for a command. The command doesn't need to be null terminated.
+
+   Parameters:
+     * command: the command.
+     * len: length of the command.
+*/
+size_t
+action_arena_size(const char *command, size_t len);
+
+/* Launch a process that executes an action. The process is created with
+   posix_spawn, so the daemon's address space is not copied. The signal mask
+   and the signal dispositions of the new process are reset to the defaults.
+
+   Parameters:
+     * a: the action to execute.
+     * envp: environment of the new process, or NULL to inherit the current
+         one.
+     * pid: at output, the process id of the new process.
+
+   Return 0 if the process was launched, an error number otherwise.
+*/
+int
+action_spawn(struct action_t *a, char *const *envp, pid_t *pid);
+
+/* Serialize an action, so it can be sent to another process. The serialized
+   action is a sequence of null terminated strings: the command, the path and
+   the arguments.
+
+   Parameters:
+     * a: the action to serialize.
+     * buf: the buffer where the action is written.
+     * size: size of the buffer.
+
+   Return the length of the serialized action. If it is greater than size,
+   the buffer was too small and its contents are not valid.
+*/
+size_t
+action_pack(struct action_t *a, char *buf, size_t size);
+
+/* Initialize an action from its serialized form (see action_pack).
+
+   Parameters:
+     * a: the action to initialize.
+     * buf: the serialized action.
+     * len: length of the serialized action.
+
+   Return 0 if the action was correctly initialized, 1 otherwise.
+*/
+int
+action_unpack(struct action_t *a, const char *buf, size_t len);
+
+/* Free the memory used by an action. The strings allocated from an arena
+   are freed with the arena.
+
+   Parameters:
+     * a: the action.
+*/
+void
+action_free(struct action_t *a);
+
+#endif
+
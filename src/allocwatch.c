@@ -0,0 +1,108 @@
+/* allocwatch.c
+   Count of the heap allocations, to check that a loop doesn't allocate.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "allocwatch.h"
+
+#include <stdatomic.h>  // atomic_int
+#include <stddef.h>     // size_t
+
+// The allocator of the C library, called by the functions that replace it
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+// Flag that tells if the allocations are counted
+static atomic_int watching = 0;
+
+// Number of allocations counted
+static atomic_ulong allocations = 0;
+
+// Count an allocation, if they are being counted
+static void
+count()
+{
+    if (atomic_load_explicit(&watching, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    }
+}
+
+/* Allocate memory, as the malloc of the C library, and count it.
+
+   Parameters:
+     * size: number of bytes to allocate.
+*/
+void*
+malloc(size_t size)
+{
+    count();
+    return __libc_malloc(size);
+}
+
+/* Allocate an array initialized to 0, as the calloc of the C library, and
+   count it.
+
+   Parameters:
+     * n: number of elements.
+     * size: size of each element.
+*/
+void*
+calloc(size_t n, size_t size)
+{
+    count();
+    return __libc_calloc(n, size);
+}
+
+/* Resize memory, as the realloc of the C library, and count it.
+
+   Parameters:
+     * ptr: the memory to resize, or NULL.
+     * size: the new size.
+*/
+void*
+realloc(void *ptr, size_t size)
+{
+    count();
+    return __libc_realloc(ptr, size);
+}
+
+/* Start counting the heap allocations (malloc, calloc and realloc) of all
+   the threads of the process. The program must be linked with allocwatch.c,
+   that replaces those functions.
+*/
+void
+allocwatch_start()
+{
+    atomic_store(&allocations, 0);
+    atomic_store(&watching, 1);
+}
+
+/* Stop counting the heap allocations.
+
+   Return the number of allocations counted since allocwatch_start.
+*/
+unsigned long
+allocwatch_stop()
+{
+    atomic_store(&watching, 0);
+    return atomic_load(&allocations);
+}
+
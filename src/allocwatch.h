@@ -0,0 +1,41 @@
+/* allocwatch.h
+   Count of the heap allocations, to check that a loop doesn't allocate.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ALLOCWATCH_H
+#define ALLOCWATCH_H
+
+/* Start counting the heap allocations (malloc, calloc and realloc) of all
+   the threads of the process. The program must be linked with allocwatch.c,
+   that replaces those functions.
+*/
+void
+allocwatch_start();
+
+/* Stop counting the heap allocations.
+
+   Return the number of allocations counted since allocwatch_start.
+*/
+unsigned long
+allocwatch_stop();
+
+#endif
+
@@ -0,0 +1,27 @@
+#!/bin/sh
+# allocwatchtest.sh
+#   Drive buttonsd_allocwatch with a short load of simulated buttons, so make
+#   check fails if the edges, the timers or the actions allocate memory in the
+#   main loop of buttonsd.
+#
+#   Copyright 2018 Antonio Serrano Hernandez
+#
+#   This file is part of rfsutils.
+#
+#   rfsutils is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   rfsutils is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with rfsutils; see the file COPYING.  If not, see
+
+# buttonsbench fails if buttonsd fails, as buttonsd_allocwatch does if its
+# main loop allocated memory, or if an action is missing
+./buttonsbench -b ./buttonsd_allocwatch -t 1 -n 50 -r 200
+
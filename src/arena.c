@@ -0,0 +1,129 @@
+/* arena.c
+   Arena allocator: many objects that are freed at once.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "arena.h"
+
+#include <stdlib.h>     // malloc
+
+// Minimum size of a chunk
+#define ARENA_MIN_CHUNK 4096
+
+/* Initialize an arena. The memory is not allocated until the first object
+   is.
+
+   Parameters:
+     * a: the arena.
+     * size: size of the first chunk. If all the objects fit in it, they are
+         all in contiguous memory.
+*/
+void
+arena_init(struct arena_t *a, size_t size)
+{
+    a->chunk = NULL;
+    a->next_size = size < ARENA_MIN_CHUNK ? ARENA_MIN_CHUNK : size;
+    a->used = 0;
+}
+
+/* Allocate an object from an arena, aligned for any type.
+
+   Parameters:
+     * a: the arena.
+     * size: size of the object.
+
+   Return the object, or NULL if there's no memory, and errno is set
+   accordingly.
+*/
+void*
+arena_alloc(struct arena_t *a, size_t size)
+{
+    struct arena_chunk_t *c = a->chunk;
+    void *p;
+
+    size = ARENA_SIZE(size);
+    if (!c || c->size - c->used < size) {
+        // A new chunk, big enough for the object
+        while (a->next_size < size) {
+            a->next_size *= 2;
+        }
+        c = (struct arena_chunk_t*)malloc(
+            sizeof(struct arena_chunk_t) + a->next_size);
+        if (!c) {
+            return NULL;
+        }
+        c->prev = a->chunk;
+        c->size = a->next_size;
+        c->used = 0;
+        a->chunk = c;
+        a->next_size *= 2;
+    }
+    p = (char*)c->data + c->used;
+    c->used += size;
+    a->used += size;
+    return p;
+}
+
+/* Return the number of bytes taken by the objects of an arena.
+
+   Parameters:
+     * a: the arena.
+*/
+size_t
+arena_used(const struct arena_t *a)
+{
+    return a->used;
+}
+
+/* Return the number of chunks of an arena.
+
+   Parameters:
+     * a: the arena.
+*/
+unsigned int
+arena_chunks(const struct arena_t *a)
+{
+    unsigned int n = 0;
+
+    for (struct arena_chunk_t *c = a->chunk; c; c = c->prev) {
+        n++;
+    }
+    return n;
+}
+
+/* Free an arena and all its objects. The arena can be used again.
+
+   Parameters:
+     * a: the arena.
+*/
+void
+arena_free(struct arena_t *a)
+{
+    struct arena_chunk_t *c, *prev;
+
+    for (c = a->chunk; c; c = prev) {
+        prev = c->prev;
+        free(c);
+    }
+    a->chunk = NULL;
+    a->used = 0;
+}
+
@@ -0,0 +1,114 @@
+/* arena.h
+   Arena allocator: many objects that are freed at once.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>     // size_t
+
+// Alignment of the objects
+#define ARENA_ALIGN     sizeof(max_align_t)
+
+// Bytes taken from an arena by an object of n bytes
+#define ARENA_SIZE(n)   (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+// A chunk of memory of an arena. The objects are taken from its data, one
+// after the other.
+struct arena_chunk_t {
+    // The previous chunk of the arena
+    struct arena_chunk_t *prev;
+
+    // Size of the data of the chunk
+    size_t size;
+
+    // Bytes of the data already taken
+    size_t used;
+
+    // The data of the chunk
+    max_align_t data[];
+};
+
+// An arena. The objects are allocated from a chunk until it's full, then a
+// new chunk twice as big is added. The objects are not freed one by one,
+// they are all freed with the arena.
+struct arena_t {
+    // The last chunk, where the objects are allocated, NULL if no object was
+    // allocated yet
+    struct arena_chunk_t *chunk;
+
+    // Size of the next chunk
+    size_t next_size;
+
+    // Bytes taken by the objects in all the chunks
+    size_t used;
+};
+
+/* Initialize an arena. The memory is not allocated until the first object
+   is.
+
+   Parameters:
+     * a: the arena.
+     * size: size of the first chunk. If all the objects fit in it, they are
+         all in contiguous memory.
+*/
+void
+arena_init(struct arena_t *a, size_t size);
+
+/* Allocate an object from an arena, aligned for any type.
+
+   Parameters:
+     * a: the arena.
+     * size: size of the object.
+
+   Return the object, or NULL if there's no memory, and errno is set
+   accordingly.
+*/
+void*
+arena_alloc(struct arena_t *a, size_t size);
+
+/* Return the number of bytes taken by the objects of an arena.
+
+   Parameters:
+     * a: the arena.
+*/
+size_t
+arena_used(const struct arena_t *a);
+
+/* Return the number of chunks of an arena.
+
+   Parameters:
+     * a: the arena.
+*/
+unsigned int
+arena_chunks(const struct arena_t *a);
+
+/* Free an arena and all its objects. The arena can be used again.
+
+   Parameters:
+     * a: the arena.
+*/
+void
+arena_free(struct arena_t *a);
+
+#endif
+
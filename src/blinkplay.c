@@ -0,0 +1,121 @@
+/* blinkplay.c
+   Player of the blink sequences of several LEDs from a timing wheel.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "blinkplay.h"
+
+#include "clock.h"
+
+// Nanoseconds in a millisecond, the resolution of the timers
+#define NS_PER_MS   1000000ULL
+
+/* Start the next step of the sequence of a LED, when the previous one ends.
+   At the end of the sequence the LED is switched off and its timer is not
+   armed again.
+
+   Parameters:
+     * t: the timer of the LED.
+*/
+static void
+step(struct timerwheel_timer_t *t)
+{
+    struct blinkplay_led_t *led = (struct blinkplay_led_t*)t;
+    struct blinkplay_t *p = led->player;
+    unsigned int ms;
+    int on;
+
+    if (!blinkseq_iterator_next(&(led->next), &on, &ms)) {
+        p->set(led, 0);
+        return;
+    }
+    p->set(led, on);
+    led->deadline += (uint64_t)ms * NS_PER_MS;
+    timerwheel_arm(&(p->wheel), t, led->deadline);
+}
+
+/* Initialize a player without LEDs. The sequences start at the next
+   millisecond.
+
+   Parameters:
+     * p: the player.
+     * set: the function that turns a LED ON or OFF.
+     * tick: the function called after the steps of each tick, NULL if none.
+*/
+void
+blinkplay_init(struct blinkplay_t *p, blinkplay_set_t set,
+    blinkplay_tick_t tick)
+{
+    // The wheel starts a tick before the first steps, that expire at the
+    // next tick after its current one
+    p->start = (clock_now() / NS_PER_MS + 1) * NS_PER_MS;
+    timerwheel_init(&(p->wheel), NS_PER_MS, p->start - NS_PER_MS);
+    p->set = set;
+    p->tick = tick;
+}
+
+/* Add a LED to a player, at the start of its sequence.
+
+   Parameters:
+     * p: the player.
+     * led: the LED.
+     * seq: the compiled sequence of the LED, kept until the end.
+*/
+void
+blinkplay_add(struct blinkplay_t *p, struct blinkplay_led_t *led,
+    const struct blinkseq_t *seq)
+{
+    timerwheel_timer_init(&(led->timer), step);
+    led->player = p;
+    blinkseq_iterator_begin(seq, &(led->next));
+    led->deadline = p->start;
+    timerwheel_arm(&(p->wheel), &(led->timer), p->start);
+}
+
+/* Play the sequences of the LEDs from this thread, until all of them end or
+   a flag is set. Each step is scheduled at an absolute time from the start,
+   so the time spent setting the LEDs and waking up doesn't accumulate along
+   the sequences. At the end of its sequence a LED is switched off.
+
+   Parameters:
+     * p: the player.
+     * sigmask: the signals blocked while sleeping, NULL to keep the current
+         ones. The signals that set the flag should be blocked the rest of the
+         time, so they can't come between its check and the sleep.
+     * stopped: flag that stops the sequences at once, NULL if none.
+*/
+void
+blinkplay_run(struct blinkplay_t *p, const sigset_t *sigmask,
+    volatile sig_atomic_t *stopped)
+{
+    uint64_t next;
+
+    while (!(stopped && *stopped) && (next = timerwheel_next(&(p->wheel)))) {
+        // Check if the signal that interrupted the sleep stops the sequences
+        if (clock_sleep_until(next, sigmask)) {
+            continue;
+        }
+        timerwheel_advance(&(p->wheel), clock_now());
+        if (p->tick) {
+            p->tick(p);
+        }
+    }
+}
+
@@ -0,0 +1,113 @@
+/* blinkplay.h
+   Player of the blink sequences of several LEDs from a timing wheel.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BLINKPLAY_H
+#define BLINKPLAY_H
+
+#include <signal.h>     // sig_atomic_t, sigset_t
+#include <stdint.h>     // uint64_t
+
+#include "blinkseq.h"
+#include "timerwheel.h"
+
+struct blinkplay_t;
+struct blinkplay_led_t;
+
+// Function that turns a LED ON or OFF at the start of a step
+typedef void (*blinkplay_set_t)(struct blinkplay_led_t *led, int on);
+
+// Function called after the steps of a tick, once for all the LEDs
+typedef void (*blinkplay_tick_t)(struct blinkplay_t *p);
+
+// A LED played. It is the first member of the LED of the program, so the
+// player passes it to the program's functions.
+struct blinkplay_led_t {
+    // Timer that expires at the end of each step of the sequence. It is the
+    // first member, so the LED is what the wheel passes to its function.
+    struct timerwheel_timer_t timer;
+
+    // The player of the LED
+    struct blinkplay_t *player;
+
+    // The next step of the sequence
+    struct blinkseq_iterator_t next;
+
+    // Start of the current step, its scheduled time (ns of CLOCK_MONOTONIC)
+    uint64_t deadline;
+};
+
+// The player. The timers of the LEDs are kept in a timing wheel of 1 ms
+// ticks, and the sequences start at a tick, so every step ends exactly at a
+// tick: the player wakes up once for all the LEDs toggled at the same time.
+struct blinkplay_t {
+    // Timing wheel that keeps the timers of all the LEDs
+    struct timerwheel_t wheel;
+
+    // Time of the first steps (ns)
+    uint64_t start;
+
+    // Functions to set a LED and to end a tick (NULL if not needed)
+    blinkplay_set_t set;
+    blinkplay_tick_t tick;
+};
+
+/* Initialize a player without LEDs. The sequences start at the next
+   millisecond.
+
+   Parameters:
+     * p: the player.
+     * set: the function that turns a LED ON or OFF.
+     * tick: the function called after the steps of each tick, NULL if none.
+*/
+void
+blinkplay_init(struct blinkplay_t *p, blinkplay_set_t set,
+    blinkplay_tick_t tick);
+
+/* Add a LED to a player, at the start of its sequence.
+
+   Parameters:
+     * p: the player.
+     * led: the LED.
+     * seq: the compiled sequence of the LED, kept until the end.
+*/
+void
+blinkplay_add(struct blinkplay_t *p, struct blinkplay_led_t *led,
+    const struct blinkseq_t *seq);
+
+/* Play the sequences of the LEDs from this thread, until all of them end or
+   a flag is set. Each step is scheduled at an absolute time from the start,
+   so the time spent setting the LEDs and waking up doesn't accumulate along
+   the sequences. At the end of its sequence a LED is switched off.
+
+   Parameters:
+     * p: the player.
+     * sigmask: the signals blocked while sleeping, NULL to keep the current
+         ones. The signals that set the flag should be blocked the rest of the
+         time, so they can't come between its check and the sleep.
+     * stopped: flag that stops the sequences at once, NULL if none.
+*/
+void
+blinkplay_run(struct blinkplay_t *p, const sigset_t *sigmask,
+    volatile sig_atomic_t *stopped);
+
+#endif
+
@@ -0,0 +1,234 @@
+/* blinkseq.c
+   Implements the compiler and the executor of the blink sequences.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "blinkseq.h"
+
+#include <stdlib.h> // malloc
+
+#include "parsenum.h"
+
+// A group being compiled
+struct group_t {
+    // Index of its BLINKSEQ_REPEAT instruction
+    size_t start;
+
+    // Flags that tell if the group has steps, and steps that take time
+    int steps, time;
+};
+
+/* Compile a blink sequence.
+   The blink sequence must be formed by the characters 'o' (ON) and '_' (OFF)
+   each followed by a sequence of digits (the time in milliseconds). A part of
+   the sequence in parentheses followed by '*' and a number, as in
+   '(o100_100)*5', is repeated that number of times, and followed by '*'
+   alone, as in '(o50_950)*', forever.
+
+   Parameters:
+     * s: the compiled sequence, at output.
+     * text: the blink sequence.
+     * error: at output, a message that describes the error, if any.
+     * pos: at output, the position of the error (from 1), if any.
+
+   Return 0 if the sequence was compiled, 1 otherwise. In case of error
+   nothing is left allocated.
+*/
+int
+blinkseq_compile(struct blinkseq_t *s, const char *text, const char **error,
+    unsigned int *pos)
+{
+    // The group 0 is the whole sequence
+    struct group_t groups[BLINKSEQ_MAX_DEPTH + 1] = {{0, 0, 0}};
+    const char *ptr, *eptr;
+    unsigned int depth = 0, t;
+    size_t n = 0;
+
+    // Each instruction starts by one of these characters
+    for (ptr = text; *ptr != '\0'; ptr++) {
+        n += *ptr == 'o' || *ptr == '_' || *ptr == '(' || *ptr == ')';
+    }
+    s->code = (struct blinkseq_instr_t*)malloc(
+        sizeof(struct blinkseq_instr_t) * (n ? n : 1));
+    if (!s->code) {
+        *error = "out of memory";
+        *pos = 1;
+        return 1;
+    }
+    s->size = 0;
+    ptr = text;
+    while (*ptr != '\0') {
+        *pos = ptr - text + 1;
+        switch (*ptr) {
+            case 'o':
+            case '_':
+                // Check number that follows
+                if (parse_number(ptr + 1, &eptr, &t)) {
+                    *error = "wrong time";
+                    goto error;
+                }
+                // Check that indeed there's a number after the o or _ chars
+                if (eptr == ptr + 1) {
+                    *error = "time expected";
+                    goto error;
+                }
+                s->code[s->size].op = *ptr == 'o' ? BLINKSEQ_ON : BLINKSEQ_OFF;
+                s->code[s->size++].arg = t;
+                groups[depth].steps = 1;
+                groups[depth].time |= t > 0;
+                ptr = eptr;
+                break;
+            case '(':
+                if (depth == BLINKSEQ_MAX_DEPTH) {
+                    *error = "too many nested groups";
+                    goto error;
+                }
+                depth++;
+                groups[depth].start = s->size;
+                groups[depth].steps = 0;
+                groups[depth].time = 0;
+                s->code[s->size++].op = BLINKSEQ_REPEAT;
+                ptr++;
+                break;
+            case ')':
+                if (!depth) {
+                    *error = "')' without '('";
+                    goto error;
+                }
+                if (!groups[depth].steps) {
+                    *error = "empty group";
+                    goto error;
+                }
+                if (ptr[1] != '*') {
+                    *error = "'*' expected after group";
+                    goto error;
+                }
+                // The number of repetitions is optional, forever by default
+                t = 0;
+                if (parse_number(ptr + 2, &eptr, &t)
+                    || (eptr != ptr + 2 && !t))
+                {
+                    *error = "wrong count";
+                    goto error;
+                }
+                // A group repeated forever must take some time, or the LED
+                // would never stop switching
+                if (!t && !groups[depth].time) {
+                    *error = "infinite group without time";
+                    goto error;
+                }
+                s->code[groups[depth].start].arg = t;
+                s->code[s->size].op = BLINKSEQ_LOOP;
+                s->code[s->size++].arg = groups[depth].start + 1;
+                depth--;
+                groups[depth].steps = 1;
+                groups[depth].time |= groups[depth + 1].time;
+                ptr = eptr;
+                break;
+            default:
+                // Wrong character
+                *error = "wrong character in blink sequence";
+                goto error;
+        }
+    }
+    if (depth) {
+        *pos = ptr - text + 1;
+        *error = "')' expected";
+        goto error;
+    }
+    return 0;
+
+error:
+    blinkseq_free(s);
+    return 1;
+}
+
+/* Return an iterator to run a compiled sequence.
+
+   Parameters:
+     * s: the sequence.
+     * i: output parameter that contains the iterator pointing before the
+         first step.
+*/
+void
+blinkseq_iterator_begin(const struct blinkseq_t *s,
+    struct blinkseq_iterator_t *i)
+{
+    i->seq = s;
+    i->pc = 0;
+    i->depth = 0;
+}
+
+/* Return the next step of a compiled sequence.
+
+   Parameters:
+     * i: the iterator. At output, the iterator points to the next step.
+     * on: at output, 1 if the LED must be turned ON, 0 if OFF.
+     * ms: at output, the time of the step in milliseconds.
+
+   Return 1 if there's a step, 0 at the end of the sequence.
+*/
+int
+blinkseq_iterator_next(struct blinkseq_iterator_t *i, int *on,
+    unsigned int *ms)
+{
+    const struct blinkseq_instr_t *in;
+    uint32_t *count;
+
+    while (i->pc < i->seq->size) {
+        in = &(i->seq->code[i->pc++]);
+        switch (in->op) {
+            case BLINKSEQ_ON:
+            case BLINKSEQ_OFF:
+                *on = in->op == BLINKSEQ_ON;
+                *ms = in->arg;
+                return 1;
+            case BLINKSEQ_REPEAT:
+                i->counts[i->depth++] = in->arg;
+                break;
+            case BLINKSEQ_LOOP:
+                // A count of 0 is never decremented, the group runs forever
+                count = &(i->counts[i->depth - 1]);
+                if (!*count || --*count) {
+                    i->pc = in->arg;
+                } else {
+                    i->depth--;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return 0;
+}
+
+/* Free a compiled sequence.
+
+   Parameters:
+     * s: the sequence.
+*/
+void
+blinkseq_free(struct blinkseq_t *s)
+{
+    free(s->code);
+    s->code = NULL;
+    s->size = 0;
+}
+
@@ -0,0 +1,132 @@
+/* blinkseq.h
+   Blink sequences of a LED, compiled to a small array of instructions.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BLINKSEQ_H
+#define BLINKSEQ_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+// Maximum number of groups nested
+#define BLINKSEQ_MAX_DEPTH  8
+
+// Operations of the instructions of a compiled sequence
+enum blinkseq_op_t {
+    // Turn the LED ON or OFF for arg milliseconds
+    BLINKSEQ_ON,
+    BLINKSEQ_OFF,
+
+    // Start a group that is repeated arg times, 0 for forever
+    BLINKSEQ_REPEAT,
+
+    // End of a group, jump back to the instruction arg if it must be
+    // repeated
+    BLINKSEQ_LOOP
+};
+
+// An instruction of a compiled sequence
+struct blinkseq_instr_t {
+    // The operation
+    uint32_t op;
+
+    // Argument of the operation
+    uint32_t arg;
+};
+
+// A compiled sequence. It takes an instruction for each step and two for
+// each group, however long it runs.
+struct blinkseq_t {
+    // The instructions
+    struct blinkseq_instr_t *code;
+
+    // Number of instructions
+    size_t size;
+};
+
+// Type to run a compiled sequence, step by step
+struct blinkseq_iterator_t {
+    // The sequence
+    const struct blinkseq_t *seq;
+
+    // The next instruction
+    size_t pc;
+
+    // Number of groups being repeated, and times that each one must still be
+    // repeated (0 for forever)
+    unsigned int depth;
+    uint32_t counts[BLINKSEQ_MAX_DEPTH];
+};
+
+/* Compile a blink sequence.
+   The blink sequence must be formed by the characters 'o' (ON) and '_' (OFF)
+   each followed by a sequence of digits (the time in milliseconds). A part of
+   the sequence in parentheses followed by '*' and a number, as in
+   '(o100_100)*5', is repeated that number of times, and followed by '*'
+   alone, as in '(o50_950)*', forever.
+
+   Parameters:
+     * s: the compiled sequence, at output.
+     * text: the blink sequence.
+     * error: at output, a message that describes the error, if any.
+     * pos: at output, the position of the error (from 1), if any.
+
+   Return 0 if the sequence was compiled, 1 otherwise. In case of error
+   nothing is left allocated.
+*/
+int
+blinkseq_compile(struct blinkseq_t *s, const char *text, const char **error,
+    unsigned int *pos);
+
+/* Return an iterator to run a compiled sequence.
+
+   Parameters:
+     * s: the sequence.
+     * i: output parameter that contains the iterator pointing before the
+         first step.
+*/
+void
+blinkseq_iterator_begin(const struct blinkseq_t *s,
+    struct blinkseq_iterator_t *i);
+
+/* Return the next step of a compiled sequence.
+
+   Parameters:
+     * i: the iterator. At output, the iterator points to the next step.
+     * on: at output, 1 if the LED must be turned ON, 0 if OFF.
+     * ms: at output, the time of the step in milliseconds.
+
+   Return 1 if there's a step, 0 at the end of the sequence.
+*/
+int
+blinkseq_iterator_next(struct blinkseq_iterator_t *i, int *on,
+    unsigned int *ms);
+
+/* Free a compiled sequence.
+
+   Parameters:
+     * s: the sequence.
+*/
+void
+blinkseq_free(struct blinkseq_t *s);
+
+#endif
+
@@ -0,0 +1,246 @@
+/* blinktest.c
+   Test of the blink sequences run from the timing wheel, under the virtual
+   clock.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <err.h>        // errx
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // printf
+#include <stdlib.h>     // malloc
+#include <time.h>       // clock_gettime
+
+#include "blinkplay.h"
+#include "blinkseq.h"
+#include "clock.h"
+
+#define PROGNAME    "blinktest"
+
+#define NS_PER_MS   1000000
+
+// Virtual time when the test starts (ns), not aligned to a millisecond
+#define START       (5000ULL * NS_PER_MS + 123)
+
+// Time from the start of a wake up after which the process sleeps too long,
+// of the next wake up, that comes late, and how late (ms)
+#define LATE_AFTER  1950
+#define LATE_AT     2000
+#define LATE        3
+
+// Time that the sequence repeated forever is run (ms): an hour
+#define FOREVER_MS  3600000
+
+// Maximum number of LEDs
+#define MAX_LEDS    8
+
+// Fail the test if a condition doesn't hold
+#define CHECK(c)    do { \
+        if (!(c)) { \
+            errx(1, "%s:%d: check failed: %s", __FILE__, __LINE__, #c); \
+        } \
+    } while (0)
+
+// A toggle of a LED: time from the start and level
+struct toggle_t {
+    uint64_t ms;
+    int on;
+};
+
+// A LED of the test, run by the player of ledblink
+struct led_t {
+    // The LED in the player. It is the first member, so the LED is what the
+    // player passes to set_led.
+    struct blinkplay_led_t play;
+
+    // The sequence
+    struct blinkseq_t seq;
+
+    // The toggles expected, number of them and number done
+    struct toggle_t *toggles;
+    unsigned int ntoggles, done;
+};
+
+// The LEDs and number of them
+struct led_t leds[MAX_LEDS];
+unsigned int nleds = 0;
+
+// The player of the LEDs
+struct blinkplay_t player;
+
+// Time of the previous wake up (ns)
+uint64_t previous;
+
+// Number of wake ups
+unsigned int wakeups = 0;
+
+// Flag that tells if the current wake up is late
+int late = 0;
+
+// Flag that stops the player, once all the toggles expected are done
+volatile sig_atomic_t stopped = 0;
+
+// Sequences with groups, and their toggles, terminated by a toggle at
+// UINT64_MAX. The last toggle is the LED switched off at the end.
+const char *grouped[] = {"o100_200o300", "(o10_20)*3_5", "o1((_2o3)*2_4)*2"};
+const struct toggle_t grouped_toggles[][16] = {
+    {{0, 1}, {100, 0}, {300, 1}, {600, 0}, {UINT64_MAX, 0}},
+    {{0, 1}, {10, 0}, {30, 1}, {40, 0}, {60, 1}, {70, 0}, {90, 0}, {95, 0},
+        {UINT64_MAX, 0}},
+    {{0, 1}, {1, 0}, {3, 1}, {6, 0}, {8, 1}, {11, 0}, {15, 0}, {17, 1},
+        {20, 0}, {22, 1}, {25, 0}, {29, 0}, {UINT64_MAX, 0}}
+};
+
+/* Add a LED to the test.
+
+   Parameters:
+     * text: its blink sequence.
+     * ntoggles: number of toggles expected.
+
+   Return the LED.
+*/
+struct led_t*
+add_led(const char *text, unsigned int ntoggles)
+{
+    struct led_t *led = &(leds[nleds++]);
+    const char *error;
+    unsigned int pos;
+
+    if (blinkseq_compile(&(led->seq), text, &error, &pos)) {
+        errx(1, "'%s': %s at %u", text, error, pos);
+    }
+    led->toggles = (struct toggle_t*)malloc(sizeof(struct toggle_t)
+        * ntoggles);
+    if (!led->toggles) {
+        errx(1, "cannot allocate the toggles");
+    }
+    led->ntoggles = ntoggles;
+    led->done = 0;
+    return led;
+}
+
+/* Check a toggle of a LED against the one expected. Called by the player at
+   the start of each step.
+
+   Parameters:
+     * play: the LED in the player.
+     * on: 1 if the LED is turned ON, 0 if OFF.
+*/
+void
+set_led(struct blinkplay_led_t *play, int on)
+{
+    struct led_t *led = (struct led_t*)play;
+    struct toggle_t *expected;
+    uint64_t deadline;
+
+    CHECK(led->done < led->ntoggles);
+    expected = &(led->toggles[led->done++]);
+    CHECK(on == expected->on);
+    // The steps are scheduled from the previous deadline, not from the time
+    // of the wake up
+    deadline = player.start + expected->ms * NS_PER_MS;
+    CHECK(play->deadline == deadline);
+    // At the wake up of its time, and exactly at its time if the process
+    // wasn't late
+    CHECK(deadline > previous && deadline <= clock_now());
+    CHECK(late || deadline == clock_now());
+}
+
+/* Count a wake up of the player, make the next one late once and stop the
+   sequence repeated forever when all the toggles expected are done. Called by
+   the player at the end of each tick.
+
+   Parameters:
+     * p: the player.
+*/
+void
+end_tick(struct blinkplay_t *p)
+{
+    wakeups++;
+    previous = clock_now();
+    late = previous == p->start + LATE_AFTER * NS_PER_MS;
+    if (late) {
+        clock_advance((LATE_AT - LATE_AFTER + LATE) * NS_PER_MS);
+    }
+    stopped = 1;
+    for (unsigned int i = 0; i < nleds; i++) {
+        if (leds[i].done < leds[i].ntoggles) {
+            stopped = 0;
+        }
+    }
+}
+
+// Add the LEDs and the toggles expected from each one
+void
+add_leds()
+{
+    struct led_t *led;
+    unsigned int n;
+
+    for (unsigned int i = 0; i < sizeof(grouped) / sizeof(char*); i++) {
+        for (n = 0; grouped_toggles[i][n].ms != UINT64_MAX; n++);
+        led = add_led(grouped[i], n);
+        for (unsigned int j = 0; j < n; j++) {
+            led->toggles[j] = grouped_toggles[i][j];
+        }
+    }
+    // 17 seconds, switched off at the end
+    led = add_led("(o500_500)*17", 35);
+    for (unsigned int j = 0; j < 35; j++) {
+        led->toggles[j].ms = 500 * j;
+        led->toggles[j].on = j < 34 && !(j % 2);
+    }
+    // An hour of a sequence repeated forever
+    n = FOREVER_MS / 1000 * 2;
+    led = add_led("_950(o50_950)*", n);
+    for (unsigned int j = 0; j < n; j++) {
+        led->toggles[j].ms = 1000 * (j / 2) + (j % 2 ? 950 : 0);
+        led->toggles[j].on = j % 2;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    struct timespec t0, t1;
+
+    add_leds();
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    clock_set_virtual(START);
+    blinkplay_init(&player, set_led, end_tick);
+    previous = player.start - NS_PER_MS;
+    for (unsigned int i = 0; i < nleds; i++) {
+        blinkplay_add(&player, &(leds[i].play), &(leds[i].seq));
+    }
+    blinkplay_run(&player, NULL, &stopped);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    CHECK(stopped);
+    for (unsigned int i = 0; i < nleds; i++) {
+        CHECK(leds[i].done == leds[i].ntoggles);
+        blinkseq_free(&(leds[i].seq));
+        free(leds[i].toggles);
+    }
+    printf(PROGNAME ": %u s of sequences in %u wake ups, %.1f ms: ok\n",
+        FOREVER_MS / 1000, wakeups, (t1.tv_sec - t0.tv_sec) * 1e3
+        + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    return 0;
+}
+
@@ -0,0 +1,741 @@
+/* buttonsbench.c
+   Load generator and end to end benchmark of buttonsd.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "config.h"
+
+#include <dirent.h>     // opendir
+#include <err.h>        // err
+#include <errno.h>      // errno
+#include <fcntl.h>      // open
+#include <getopt.h>     // getopt_long
+#include <limits.h>     // PATH_MAX
+#include <linux/gpio.h> // struct gpio_v2_line_event
+#include <signal.h>     // kill
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // printf
+#include <stdlib.h>     // exit
+#include <string.h>     // memset
+#include <sys/resource.h>   // setrlimit
+#include <sys/stat.h>   // mkfifo
+#include <sys/wait.h>   // waitpid
+#include <time.h>       // clock_gettime
+#include <unistd.h>     // fork
+
+#include "parsenum.h"
+
+#define OPTSTRING   "hb:n:r:t:m:A:"
+#define PROGNAME    "buttonsbench"
+
+// Default path of buttonsd
+#define DEFAULT_BUTTONSD    "./buttonsd"
+
+// Default number of pins
+#define DEFAULT_PINS    100
+
+// Maximum number of pins
+#define MAX_PINS    10000
+
+// Default number of gestures per second, in all the pins
+#define DEFAULT_RATE    200
+
+// Default duration of the load (s)
+#define DEFAULT_DURATION    5
+
+// Default percentages of clicks, double clicks and long clicks
+#define DEFAULT_MIX "80,15,5"
+
+// Time that a button is pressed in a click (ms)
+#define PRESS_TIME  5
+
+// Time between the clicks of a double click (ms)
+#define CLICK_GAP   5
+
+// long_click_time and multi_click_time given to buttonsd (ms)
+#define LONG_CLICK_TIME     30
+#define MULTI_CLICK_TIME    30
+
+// Time that a button is held in a long click (ms)
+#define HOLD_TIME   (LONG_CLICK_TIME + 10)
+
+// Time that a pin is left alone after a gesture, so the gestures don't mix
+// (ms)
+#define QUIET_TIME  (MULTI_CLICK_TIME + 20)
+
+// Time waited for buttonsd to open the FIFOs and for the last actions (ms)
+#define START_TIMEOUT   5000
+#define DRAIN_TIMEOUT   3000
+
+// Nanoseconds in a millisecond
+#define NS_PER_MS   1000000ULL
+
+// Gestures generated
+enum gesture_kind_t {CLICK, DOUBLE_CLICK, LONG_CLICK, GESTURE_KINDS};
+
+// An edge scheduled to be written
+struct edge_t {
+    // Time when the edge must be written (ns of CLOCK_MONOTONIC)
+    uint64_t time;
+
+    // The pin
+    uint32_t pin;
+
+    // Level after the edge (1 pressed, 0 released)
+    uint32_t level;
+};
+
+// Path of buttonsd
+const char *buttonsd = DEFAULT_BUTTONSD;
+
+// Number of pins
+unsigned int npins = DEFAULT_PINS;
+
+// Gestures per second
+unsigned int rate = DEFAULT_RATE;
+
+// Duration of the load (s)
+unsigned int duration = DEFAULT_DURATION;
+
+// Percentages of each kind of gesture
+unsigned int mix[GESTURE_KINDS];
+
+// Directory of the simulation, with the FIFOs, the configuration and the
+// FIFO where the actions report
+char dir[] = "/tmp/" PROGNAME ".XXXXXX";
+
+// Descriptors of the FIFOs of the pins
+int *fifos;
+
+// Time when each pin is free for a new gesture (ns)
+uint64_t *free_at;
+
+// Edges scheduled, in a binary heap ordered by time
+struct edge_t *heap;
+size_t heap_len = 0, heap_size = 0;
+
+// Latencies reported by the actions (ns)
+uint64_t *latencies;
+size_t nlatencies = 0, latencies_size = 0;
+
+// Print help message and exits
+void
+print_help()
+{
+    printf("Usage: " PROGNAME " [options]\n"
+"Drive buttonsd with simulated buttons and print the throughput, the latency\n"
+"from an edge to the start of its action and the CPU used.\n"
+"Options:\n"
+"  -h, --help              Show this message and exit.\n"
+"  -b PATH, --buttonsd PATH\n"
+"                          Path of buttonsd (" DEFAULT_BUTTONSD " by default).\n"
+"  -n N, --pins N          Number of buttons (1 to 10000).\n"
+"  -r N, --rate N          Gestures per second, in all the buttons.\n"
+"  -t S, --time S          Duration of the load, in seconds.\n"
+"  -m C,D,L, --mix C,D,L   Percentages of clicks, double clicks and long\n"
+"                          clicks (" DEFAULT_MIX " by default).\n"
+    );
+    exit(0);
+}
+
+/* Parse a positive number given in the command line or exit.
+
+   Parameters:
+     * s: the string that contains the number.
+*/
+unsigned int
+parse_arg_number(const char *s)
+{
+    const char *eptr;
+    unsigned int n;
+
+    if (parse_number(s, &eptr, &n) || eptr == s || *eptr != '\0' || !n) {
+        errx(1, "invalid number '%s'", s);
+    }
+    return n;
+}
+
+/* Parse the mix of gestures or exit.
+
+   Parameters:
+     * s: the percentages of each kind of gesture, separated by commas.
+*/
+void
+parse_mix(const char *s)
+{
+    const char *eptr = s;
+    unsigned int total = 0;
+
+    for (int i = 0; i < GESTURE_KINDS; i++) {
+        if (parse_number(s, &eptr, &(mix[i])) || eptr == s
+            || *eptr != (i < GESTURE_KINDS - 1 ? ',' : '\0'))
+        {
+            errx(1, "invalid mix '%s'", s);
+        }
+        total += mix[i];
+        s = eptr + 1;
+    }
+    if (total != 100) {
+        errx(1, "the percentages of the mix must add 100");
+    }
+}
+
+/* Parse the command line arguments.
+
+   Parameters:
+     * argc: number of command line arguments.
+     * argv: command line string arguments.
+*/
+void
+parse_args(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {"buttonsd", required_argument, 0, 'b'},
+        {"pins", required_argument, 0, 'n'},
+        {"rate", required_argument, 0, 'r'},
+        {"time", required_argument, 0, 't'},
+        {"mix", required_argument, 0, 'm'},
+        {0, 0, 0, 0}
+    };
+    int o;
+
+    parse_mix(DEFAULT_MIX);
+    do {
+        o = getopt_long(argc, argv, OPTSTRING, long_opts, 0);
+        switch (o) {
+            case 'h':
+                print_help();
+            case 'b':
+                buttonsd = optarg;
+                break;
+            case 'n':
+                npins = parse_arg_number(optarg);
+                break;
+            case 'r':
+                rate = parse_arg_number(optarg);
+                break;
+            case 't':
+                duration = parse_arg_number(optarg);
+                break;
+            case 'm':
+                parse_mix(optarg);
+                break;
+            case '?':
+                exit(1);
+            default:
+                break;
+        }
+    } while (o != -1);
+    if (npins > MAX_PINS) {
+        errx(1, "the maximum number of pins is %d", MAX_PINS);
+    }
+}
+
+// Return the current time of CLOCK_MONOTONIC, in nanoseconds
+uint64_t
+now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Sleep until a given time.
+
+   Parameters:
+     * t: the time (ns of CLOCK_MONOTONIC).
+*/
+void
+sleep_until(uint64_t t)
+{
+    struct timespec ts;
+
+    ts.tv_sec = t / 1000000000;
+    ts.tv_nsec = t % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+        == EINTR);
+}
+
+/* Run as an action of buttonsd: report the time from the event to now to the
+   benchmark, and exit.
+
+   Parameters:
+     * report: path of the FIFO where the latency is written.
+*/
+void
+action_main(const char *report)
+{
+    const char *timestamp = getenv("BUTTONSD_TIMESTAMP");
+    uint64_t latency;
+    int fd;
+
+    if (!timestamp) {
+        errx(1, "BUTTONSD_TIMESTAMP not defined");
+    }
+    latency = now() - strtoull(timestamp, NULL, 10);
+    fd = open(report, O_WRONLY);
+    // A write of 8 bytes in a FIFO is atomic
+    if (fd < 0 || write(fd, &latency, sizeof(latency)) < 0) {
+        err(1, "cannot report to '%s'", report);
+    }
+    exit(0);
+}
+
+/* Add an edge to the heap of scheduled edges.
+
+   Parameters:
+     * time: time when the edge must be written (ns).
+     * pin: the pin.
+     * level: the level after the edge.
+*/
+void
+heap_push(uint64_t time, uint32_t pin, uint32_t level)
+{
+    struct edge_t e = {time, pin, level}, tmp;
+    size_t i, parent;
+
+    if (heap_len == heap_size) {
+        heap_size = heap_size ? heap_size * 2 : 1024;
+        heap = (struct edge_t*)realloc(heap,
+            sizeof(struct edge_t) * heap_size);
+        if (!heap) {
+            err(1, "cannot allocate the edges");
+        }
+    }
+    i = heap_len++;
+    heap[i] = e;
+    while (i && heap[parent = (i - 1) / 2].time > heap[i].time) {
+        tmp = heap[parent];
+        heap[parent] = heap[i];
+        heap[i] = tmp;
+        i = parent;
+    }
+}
+
+/* Remove the first edge of the heap of scheduled edges.
+
+   Parameters:
+     * e: at output, the edge.
+*/
+void
+heap_pop(struct edge_t *e)
+{
+    struct edge_t tmp;
+    size_t i = 0, child;
+
+    *e = heap[0];
+    heap[0] = heap[--heap_len];
+    while ((child = 2 * i + 1) < heap_len) {
+        if (child + 1 < heap_len && heap[child + 1].time < heap[child].time) {
+            child++;
+        }
+        if (heap[i].time <= heap[child].time) {
+            break;
+        }
+        tmp = heap[child];
+        heap[child] = heap[i];
+        heap[i] = tmp;
+        i = child;
+    }
+}
+
+/* Schedule the edges of a gesture in a pin.
+
+   Parameters:
+     * kind: the kind of gesture.
+     * pin: the pin.
+     * t: time of the first edge (ns).
+*/
+void
+schedule_gesture(enum gesture_kind_t kind, uint32_t pin, uint64_t t)
+{
+    heap_push(t, pin, 1);
+    switch (kind) {
+        case CLICK:
+            t += PRESS_TIME * NS_PER_MS;
+            break;
+        case DOUBLE_CLICK:
+            t += PRESS_TIME * NS_PER_MS;
+            heap_push(t, pin, 0);
+            t += CLICK_GAP * NS_PER_MS;
+            heap_push(t, pin, 1);
+            t += PRESS_TIME * NS_PER_MS;
+            break;
+        default:
+            t += HOLD_TIME * NS_PER_MS;
+            break;
+    }
+    heap_push(t, pin, 0);
+    free_at[pin] = t + QUIET_TIME * NS_PER_MS;
+}
+
+/* Create the directory of the simulation, with a FIFO for each pin, the FIFO
+   where the actions report and the configuration of buttonsd.
+
+   Parameters:
+     * self: path of this program, that is the action of all the events.
+*/
+void
+create_simulation(const char *self)
+{
+    char path[PATH_MAX];
+    FILE *f;
+
+    if (!mkdtemp(dir)) {
+        err(1, "cannot create a directory");
+    }
+    snprintf(path, sizeof(path), "%s/report", dir);
+    if (mkfifo(path, 0600)) {
+        err(1, "cannot create '%s'", path);
+    }
+    for (unsigned int i = 0; i < npins; i++) {
+        snprintf(path, sizeof(path), "%s/%u", dir, i);
+        if (mkfifo(path, 0600)) {
+            err(1, "cannot create '%s'", path);
+        }
+    }
+    snprintf(path, sizeof(path), "%s/buttonsd.conf", dir);
+    f = fopen(path, "w");
+    if (!f) {
+        err(1, "cannot create '%s'", path);
+    }
+    for (unsigned int i = 0; i < npins; i++) {
+        fprintf(f, "%u_click=%s -A %s/report\n"
+            "%u_double_click=%s -A %s/report\n"
+            "%u_long_click=%s -A %s/report\n"
+            "%u_long_click_time=%d\n%u_multi_click_time=%d\n",
+            i, self, dir, i, self, dir, i, self, dir,
+            i, LONG_CLICK_TIME, i, MULTI_CLICK_TIME);
+    }
+    fclose(f);
+}
+
+// Remove the directory of the simulation
+void
+remove_simulation()
+{
+    char path[PATH_MAX];
+
+    for (unsigned int i = 0; i < npins; i++) {
+        snprintf(path, sizeof(path), "%s/%u", dir, i);
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s/report", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/buttonsd.conf", dir);
+    unlink(path);
+    rmdir(dir);
+}
+
+/* Start buttonsd with the simulation and wait until it has opened all the
+   FIFOs.
+
+   Return the process id of buttonsd.
+*/
+pid_t
+start_buttonsd()
+{
+    char conf[PATH_MAX], path[PATH_MAX];
+    uint64_t deadline;
+    pid_t pid;
+
+    snprintf(conf, sizeof(conf), "%s/buttonsd.conf", dir);
+    pid = fork();
+    if (pid < 0) {
+        err(1, "cannot fork");
+    } else if (pid == 0) {
+        execl(buttonsd, buttonsd, "-c", conf, "-S", dir, (char*)NULL);
+        err(1, "cannot execute '%s'", buttonsd);
+    }
+    // Opening a FIFO for writing without blocking fails until there's a
+    // reader
+    deadline = now() + START_TIMEOUT * NS_PER_MS;
+    for (unsigned int i = 0; i < npins; i++) {
+        snprintf(path, sizeof(path), "%s/%u", dir, i);
+        while ((fifos[i] = open(path, O_WRONLY | O_NONBLOCK | O_CLOEXEC))
+            < 0)
+        {
+            if (errno != ENXIO || now() > deadline
+                || waitpid(pid, NULL, WNOHANG) == pid)
+            {
+                kill(pid, SIGTERM);
+                remove_simulation();
+                errx(1, "buttonsd didn't open '%s'", path);
+            }
+            usleep(10000);
+        }
+    }
+    // Let buttonsd start the capture thread
+    usleep(100000);
+    return pid;
+}
+
+/* Read the latencies reported by the actions.
+
+   Parameters:
+     * fd: the FIFO where the actions report.
+*/
+void
+read_reports(int fd)
+{
+    uint64_t buf[512];
+    ssize_t len;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (size_t i = 0; i < len / sizeof(uint64_t); i++) {
+            if (nlatencies == latencies_size) {
+                latencies_size = latencies_size ? latencies_size * 2 : 1024;
+                latencies = (uint64_t*)realloc(latencies,
+                    sizeof(uint64_t) * latencies_size);
+                if (!latencies) {
+                    err(1, "cannot allocate the latencies");
+                }
+            }
+            latencies[nlatencies++] = buf[i];
+        }
+    }
+}
+
+/* Return the CPU time used by all the threads of a process, in
+   microseconds, or 0 if it cannot be read. The time is read from schedstat,
+   that has a better resolution than the ticks of stat.
+
+   Parameters:
+     * pid: the process id.
+*/
+double
+cpu_time(pid_t pid)
+{
+    char path[PATH_MAX];
+    unsigned long long ns, total = 0;
+    struct dirent *d;
+    DIR *tasks;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    tasks = opendir(path);
+    if (!tasks) {
+        return 0;
+    }
+    while ((d = readdir(tasks))) {
+        if (d->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/proc/%d/task/%s/schedstat", (int)pid,
+            d->d_name);
+        f = fopen(path, "r");
+        if (f) {
+            if (fscanf(f, "%llu", &ns) == 1) {
+                total += ns;
+            }
+            fclose(f);
+        }
+    }
+    closedir(tasks);
+    return total / 1000.0;
+}
+
+/* Return the process id of the helper of buttonsd (its only child), or 0 if
+   it cannot be found.
+
+   Parameters:
+     * pid: the process id of buttonsd.
+*/
+pid_t
+helper_pid(pid_t pid)
+{
+    char path[64];
+    int child = 0;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/children", (int)pid,
+        (int)pid);
+    f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%d", &child) != 1) {
+            child = 0;
+        }
+        fclose(f);
+    }
+    return child;
+}
+
+// Compare two latencies, for qsort
+int
+compare_latencies(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Return a percentile of the latencies, already sorted, in microseconds.
+
+   Parameters:
+     * p: the percentile, between 0 and 100.
+*/
+double
+percentile(double p)
+{
+    size_t i = (size_t)(p / 100.0 * nlatencies);
+
+    if (!nlatencies) {
+        return 0;
+    }
+    return latencies[i < nlatencies ? i : nlatencies - 1] / 1000.0;
+}
+
+int
+main(int argc, char **argv)
+{
+    char self[PATH_MAX], path[PATH_MAX];
+    struct gpio_v2_line_event ev;
+    struct rlimit rl;
+    struct edge_t e;
+    uint64_t t0, end, next_gesture, next, deadline;
+    unsigned long edges = 0, dropped = 0, gestures = 0, skipped = 0;
+    double cpu0, cpu1, helper0, helper1;
+    unsigned int pin = 0, r, kind;
+    ssize_t len;
+    pid_t pid, helper;
+    int report, e_status;
+
+    // Run as an action of buttonsd
+    if (argc == 3 && !strcmp(argv[1], "-A")) {
+        action_main(argv[2]);
+    }
+    parse_args(argc, argv);
+    len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len < 0) {
+        err(1, "cannot find the path of " PROGNAME);
+    }
+    self[len] = '\0';
+    // A descriptor for each FIFO, here and in buttonsd
+    if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < npins + 64) {
+        rl.rlim_cur = rl.rlim_max;
+        if (rl.rlim_cur < npins + 64 || setrlimit(RLIMIT_NOFILE, &rl)) {
+            errx(1, "not enough file descriptors for %u pins", npins);
+        }
+    }
+    fifos = (int*)malloc(sizeof(int) * npins);
+    free_at = (uint64_t*)calloc(npins, sizeof(uint64_t));
+    if (!fifos || !free_at) {
+        err(1, "cannot allocate the pins");
+    }
+    create_simulation(self);
+    // The report FIFO is opened for writing too, so it never hangs up
+    snprintf(path, sizeof(path), "%s/report", dir);
+    report = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (report < 0) {
+        err(1, "cannot open '%s'", path);
+    }
+    pid = start_buttonsd();
+    helper = helper_pid(pid);
+    printf("%u pins, %u gestures/s during %u s, mix %u/%u/%u\n", npins, rate,
+        duration, mix[CLICK], mix[DOUBLE_CLICK], mix[LONG_CLICK]);
+    cpu0 = cpu_time(pid);
+    helper0 = helper ? cpu_time(helper) : 0;
+    // Generate the load: the gestures start at a constant rate, each one in
+    // the next pin that is free, and their edges are written on time
+    memset(&ev, 0, sizeof(ev));
+    srand(1);
+    t0 = now();
+    end = t0 + (uint64_t)duration * 1000000000;
+    next_gesture = t0;
+    while (next_gesture < end || heap_len) {
+        next = heap_len && heap[0].time < next_gesture ? heap[0].time
+            : next_gesture;
+        sleep_until(next);
+        if (next_gesture < end && next_gesture <= now()) {
+            for (r = 0; r < npins && free_at[pin] > next_gesture; r++) {
+                pin = (pin + 1) % npins;
+            }
+            if (r == npins) {
+                skipped++;
+            } else {
+                r = rand() % 100;
+                kind = r < mix[CLICK] ? CLICK
+                    : r < mix[CLICK] + mix[DOUBLE_CLICK] ? DOUBLE_CLICK
+                    : LONG_CLICK;
+                schedule_gesture(kind, pin, next_gesture);
+                pin = (pin + 1) % npins;
+                gestures++;
+            }
+            next_gesture += 1000000000 / rate;
+            if (next_gesture >= end && !heap_len) {
+                break;
+            }
+        }
+        while (heap_len && heap[0].time <= now()) {
+            heap_pop(&e);
+            // Timestamped as the kernel does, when the edge happens
+            ev.id = e.level ? GPIO_V2_LINE_EVENT_RISING_EDGE
+                : GPIO_V2_LINE_EVENT_FALLING_EDGE;
+            ev.timestamp_ns = now();
+            if (write(fifos[e.pin], &ev, sizeof(ev)) < 0) {
+                dropped++;
+            }
+            edges++;
+        }
+        read_reports(report);
+    }
+    // Wait for the last actions
+    deadline = now() + DRAIN_TIMEOUT * NS_PER_MS;
+    while (nlatencies < gestures && now() < deadline) {
+        usleep(10000);
+        read_reports(report);
+    }
+    cpu1 = cpu_time(pid);
+    helper1 = helper ? cpu_time(helper) : 0;
+    kill(pid, SIGTERM);
+    waitpid(pid, &e_status, 0);
+    for (unsigned int i = 0; i < npins; i++) {
+        close(fifos[i]);
+    }
+    close(report);
+    remove_simulation();
+    qsort(latencies, nlatencies, sizeof(uint64_t), compare_latencies);
+    printf("%-22s %lu (%lu dropped, %lu gestures skipped)\n", "edges written",
+        edges, dropped, skipped);
+    printf("%-22s %zu of %lu (%.1f/s)\n", "actions", nlatencies, gestures,
+        nlatencies * 1e9 / (now() - t0));
+    printf("%-22s p50 %.1f, p99 %.1f, p999 %.1f, max %.1f\n",
+        "edge to action (us)", percentile(50), percentile(99),
+        percentile(99.9), percentile(100));
+    printf("%-22s %.1f us per edge\n", "buttonsd CPU",
+        edges ? (cpu1 - cpu0) / edges : 0);
+    printf("%-22s %.1f us per action\n", "helper CPU",
+        nlatencies ? (helper1 - helper0) / nlatencies : 0);
+    // buttonsd exits with an error if its main loop failed, or if it
+    // allocated memory in a build that checks it
+    if (!WIFEXITED(e_status) || WEXITSTATUS(e_status)) {
+        printf("%-22s failed\n", "buttonsd");
+    }
+    free(fifos);
+    free(free_at);
+    free(heap);
+    free(latencies);
+    return nlatencies == gestures && WIFEXITED(e_status)
+        && !WEXITSTATUS(e_status) ? 0 : 1;
+}
+
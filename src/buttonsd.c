@@ -22,30 +22,79 @@
    <http://www.gnu.org/licenses/>.
 */
 
+// pthread_setaffinity_np and the CPU sets are GNU extensions
+#define _GNU_SOURCE
+
 #include "config.h"
 
 #include <err.h>        // err
+#include <errno.h>      // errno
+#include <fcntl.h>      // fcntl
 #include <getopt.h>     // getopt_long
-#include <signal.h>     // sigaction
+#include <libgen.h>     // dirname
+#include <limits.h>     // PATH_MAX
+#include <malloc.h>     // mallopt
+#include <pthread.h>    // pthread_create
+#include <sched.h>      // sched_setscheduler
+#include <signal.h>     // sigset_t
+#include <stdarg.h>     // va_list
+#include <stdatomic.h>  // atomic_int
+#include <stddef.h>     // offsetof
 #include <stdio.h>      // printf
 #include <stdlib.h>     // exit
 #include <string.h>     // strcmp
-#include <sys/wait.h>   // waitpid
-#include <time.h>       // clock_gettime
-#include <unistd.h>     // fork
+#include <sys/epoll.h>  // EPOLLPRI
+#include <sys/eventfd.h>    // eventfd
+#include <sys/inotify.h>    // inotify_init1
+#include <sys/mman.h>   // mlockall
+#include <sys/resource.h>   // getrusage
+#include <sys/socket.h> // socket
+#include <sys/un.h>     // struct sockaddr_un
+#include <sys/wait.h>   // WEXITSTATUS
+#include <syslog.h>     // syslog
+#include <unistd.h>     // setsid
 
 #include <rfsgpio.h>
 
+#include "action.h"
+#include "arena.h"
+#include "clock.h"
+#include "conffile.h"
 #include "daemon.h"
 #include "dictint.h"
+#include "gesture.h"
+#include "gpiocdev.h"
+#include "histogram.h"
 #include "list.h"
 #include "parsenum.h"
-#include "readline.h"
+#include "reactor.h"
+#include "ring.h"
+#include "spawner.h"
+#include "timerwheel.h"
+#include "trace.h"
+#include "vector.h"
+
+#ifdef ALLOCWATCH
+#include "allocwatch.h"
+#endif
 
 // Short options
 //   * h: help
 //   * v: version
-#define OPTSTRING   "hvc:dp:"
+//   * c: configuration file
+//   * d: daemonize
+//   * p: pidfile
+//   * g: GPIO character device
+//   * r: size of the ring of edges
+//   * l: lock the memory
+//   * t: real-time priority
+//   * a: CPU affinity
+//   * s: socket of the statistics
+//   * S: directory of the simulated GPIO lines
+//   * R: record the edges
+//   * P: replay the edges
+//   * w: reload the configuration file when it changes
+#define OPTSTRING   "hvc:dp:g:r:lt:a:s:S:R:P:w"
 
 // Name of the program, to use it in the version and help string
 #define PROGNAME    "buttonsd"
@@ -54,92 +103,739 @@
 // the clicks in the buttons.
 #define DEFAULT_CONFIGFILE  SYSCONFDIR "/buttonsd.conf"
 
-// Time that must be elapsed between pressing a button and releasing it to
-// consider it a long click (the time is in seconds).
-#define TIME_LONG_CLICK 2.0
+// Default time that a button must be held to fire a long click (ms)
+#define DEFAULT_LONG_CLICK_TIME 2000
+
+// Default interval between the hold repeats while a button is held (ms)
+#define DEFAULT_HOLD_REPEAT_INTERVAL    500
+
+// Default maximum time between the clicks of a double or triple click (ms)
+#define DEFAULT_MULTI_CLICK_TIME    400
+
+// Maximum number of buttons of a chord
+#define MAX_CHORD_BUTTONS   8
+
+// Nanoseconds in a millisecond
+#define NS_PER_MS   1000000ULL
+
+// Maximum number of edge events read from a GPIO line at once
+#define EDGE_BATCH  16
+
+// Default number of edges that the ring between the capture thread and the
+// main thread can keep
+#define DEFAULT_RING_SIZE   256
+
+// Maximum debounce period of a button (ms), the kernel limits it anyway
+#define MAX_DEBOUNCE    1000
+
+// Size of the stack prefaulted before locking the memory (bytes)
+#define PREFAULT_STACK  (256 * 1024)
+
+// Number of arenas of the configurations (see config_arenas)
+#define CONFIG_ARENAS   3
+
+// Backlog of the socket of the statistics
+#define STATS_BACKLOG   4
+
+// Limits of the buckets of the histograms served in the socket of the
+// statistics, powers of 2 of nanoseconds from 2^10 (1 us) to 2^36 (69 s).
+// The bound of each bucket is the limit minus 1 ns, the highest value of a
+// bucket of the histograms, so the counts are exact.
+#define STATS_FIRST_LIMIT   10
+#define STATS_LAST_LIMIT    36
+
+// Names of the event types in the configuration file (see gesture.h)
+const char *event_names[EVENT_TYPES] = {"click", "double_click",
+    "triple_click", "long_click", "hold_repeat", "chord"};
+
+// Stages of the way from an edge to the end of an action, each one with a
+// histogram of its latencies
+enum stage_t {
+    // From the edge, or the expiration of the timer, that completes an event
+    // to the recognition of the event. The wait for a long click or for more
+    // clicks is not included.
+    STAGE_CLASSIFY,
+
+    // From the recognition of the event to the launch of the action by the
+    // spawner
+    STAGE_SPAWN,
 
-// Transform an element of struct timespec to a double. Converting the struct
-// timespec to a double is useful to substract them and calculate time deltas.
-#define TS_TO_DOUBLE(ts)    ((double)ts.tv_sec \
-                            + (double)(ts.tv_nsec)/1000000000.0)
+    // From the launch of the action to its end
+    STAGE_EXIT
+};
+
+// Number of stages
+#define STAGES  3
 
-// Timeout to interrupt the poll system call (in ms). This is necessary to
-// avoid certain race conditions when the flag stop is set.
-#define POLL_TIMEOUT    5000
+// Id of an event whose action is not defined in the spawner yet
+#define EVENT_UNDEFINED UINT32_MAX
 
-// Enumeration of event types.
-// Event types are the different events that a button can generate. For now
-// only two are implemented:
-//   * Short click (or simply, click).
-//   * Long click.
-enum event_type_t {EVENT_CLICK, EVENT_LONG_CLICK};
+// Names of the stages in the statistics
+const char *stage_names[STAGES] = {"edge_to_classification",
+    "classification_to_spawn", "spawn_to_exit"};
 
 // Struct that contains an event type and an action that is executed upon that
-// event. The action is actually a string that contains a command to be
-// executed with the 'system' syscall.
+// event. The action is a command, tokenized when the configuration is read.
 struct event_t {
     // The event type
     enum event_type_t type;
 
-    // The action string, command to be executed with system
-    char *action;
+    // The command to execute
+    struct action_t action;
+
+    // Id of the action in the spawner, EVENT_UNDEFINED until it's defined
+    uint32_t id;
+
+    // Number of times that the action has been executed and finished
+    unsigned int runs;
+
+    // Number of executions that didn't finish with exit status 0
+    unsigned int failures;
+
+    // Exit status of the last execution, as returned by waitpid
+    int last_status;
+
+    // Time spent by the last execution and by all of them (in ns)
+    uint64_t last_time, total_time;
+
+    // Longest time spent by an execution (in ns)
+    uint64_t max_time;
 };
 
 // Struct that contains the list of events and actions related to a given
 // button. The button is identified by the GPIO pin number where it is
 // connected.
 struct button_t {
-    // The GPIO pin where the button is
+    // The reactor handler used to watch the GPIO's value file. It is the
+    // first member, so the button is what the reactor passes to the callback.
+    struct reactor_handler_t handler;
+
+    // The GPIO pin where the button is. When the GPIO character device is
+    // used, the pin is the offset of the line in the chip and the line is
+    // read through the handler's descriptor.
     struct gpio_t gpio;
 
-    // Timestamp of the last button down event. Used to calculate the time
-    // elapsed when the button is released.
-    struct timespec timestamp;
+    // Flag that tells if the GPIO is open (exported) through sysfs
+    int opened;
+
+    // Timestamp of the last button down event (ns of CLOCK_MONOTONIC). Used
+    // to calculate the time elapsed when the button is released.
+    uint64_t timestamp;
+
+    // Debounce period of the button (ms), 0 for no debounce
+    unsigned int debounce;
+
+    // Flag that tells if the debounce is done here instead of by the kernel
+    int soft_debounce;
+
+    // Timer of the software debounce, that expires when the line has been
+    // stable for the debounce period
+    struct timerwheel_timer_t settle;
+
+    // Last level read from the line (1 high, 0 low) and time of that edge
+    int raw;
+    uint64_t raw_timestamp;
+
+    // State of the button after the debounce (1 pressed, 0 released)
+    int pressed;
+
+    // Number of edges read from the line, and number of them discarded by
+    // the debounce
+    unsigned long edges, filtered;
 
-    // The list of events and actions. This list can contain several times the
-    // same event type.
-    struct list_t events;
+    // Recognizer of the gestures of the button, built when the configuration
+    // is read
+    struct gesture_t gesture;
+
+    // Timer of the gestures: it fires the long click and the hold repeats
+    // while the button is held, and the clicks when no more clicks follow
+    struct timerwheel_timer_t timer;
+
+    // Input of the recognizer when the timer expires
+    enum gesture_input_t timer_input;
+
+    // Time that the button must be held to fire a long click (ns)
+    uint64_t long_click_time;
+
+    // Interval between the hold repeats (ns)
+    uint64_t hold_repeat_interval;
+
+    // Maximum time between the clicks of a double or triple click (ns)
+    uint64_t multi_click_time;
+
+    // Bit mask of the event types that the button has, (1 << type)
+    unsigned int types;
+
+    // Number of events of each type recognized
+    unsigned long recognized[EVENT_TYPES];
+
+    // The events and actions of each type, in the order of the configuration
+    // file, so an event recognized only visits its own actions
+    struct vector_t events[EVENT_TYPES];
+
+    // The list of chords where the button is
+    struct list_t chords;
+};
+
+// Struct that contains a chord: several buttons that fire an action when
+// they are pressed together
+struct chord_t {
+    // The buttons of the chord
+    struct button_t **buttons;
+
+    // Number of buttons of the chord
+    unsigned int nbuttons;
+
+    // Number of buttons of the chord that are pressed
+    unsigned int pressed;
+
+    // Number of times that the chord was recognized
+    unsigned long recognized;
+
+    // The event of the chord, with its action
+    struct event_t *event;
 };
 
 // Dictionary that stores the buttons indexed by the GPIO pin number where they
 // are connected.
 struct dictint_t dict_buttons;
 
-// Dictionary that stores the buttons indexed by the file descriptor number
-// used to poll that button's GPIO.
-struct dictint_t dict_fds;
+// List of all the chords
+struct list_t chords;
 
-// List of poll descriptors, used to poll for changes in state in the GPIO
-// pins of all the buttons.
-struct pollfd *poll_descriptors = NULL;
+// The reactor that waits for the events in the buttons and for the signals
+struct reactor_t reactor = REACTOR_INIT;
+
+// Helper process that launches the actions
+struct spawner_t spawner = SPAWNER_INIT;
+
+// Signals received through the reactor: SIGINT and SIGTERM stop the process,
+// SIGUSR1 prints the counters of the buttons and SIGHUP reloads the
+// configuration file
+sigset_t signals;
 
 // Path to the configuration file
 const char *config = DEFAULT_CONFIGFILE;
 
+// Absolute path to the configuration file, to reload it after the daemon
+// changes its directory
+char *config_absolute = NULL;
+
+// Flag that tells if the configuration file is reloaded when it changes
+int watch_config = 0;
+
+// inotify descriptor that watches the directory of the configuration file
+struct reactor_handler_t config_watch = {-1, 0};
+
+// Name of the configuration file in its directory, as given by the events of
+// the inotify descriptor
+const char *config_name = NULL;
+
+// Arenas of the configurations. The buttons, the events and the chords of a
+// configuration, with their dictionary and lists, are allocated from an
+// arena and freed with it. A reload reads the new configuration in the next
+// arena, and the arena of the configuration replaced is freed by the next
+// reload, when the capture thread cannot use its buttons anymore.
+struct arena_t config_arenas[CONFIG_ARENAS];
+
+// The arena of the configuration in use
+struct arena_t *config_arena = config_arenas;
+
 // Flag that tells if this process must be daemonized
 int is_daemon = 0;
 
 const char *pidfile = 0;
 
-// Number of poll descriptors in the previous array
-size_t npoll_descriptors = 0;
+// Path to the GPIO character device, NULL to use the sysfs interface
+const char *gpiochip = 0;
+
+// Descriptor of the GPIO character device
+int chip_fd = -1;
+
+// Directory of the simulated GPIO lines, NULL to use real GPIOs
+const char *sim_dir = 0;
+
+// Path of the trace where the edges are recorded, NULL to not record them
+const char *record_path = 0;
+
+// Path of the trace to replay instead of watching the buttons, NULL to watch
+// them
+const char *replay_path = 0;
+
+// The trace being recorded or replayed
+struct trace_t trace;
+
+// Flag that tells if the edges are being recorded
+int recording = 0;
+
+// Reactor of the capture thread, that only waits for the edges of the buttons
+// and timestamps them
+struct reactor_t capture = REACTOR_INIT;
+
+// Ring where the capture thread pushes the edges for the main thread
+struct ring_t ring;
+
+// Number of edges of the ring
+unsigned int ring_size_arg = DEFAULT_RING_SIZE;
+
+// eventfd written by the capture thread after pushing edges, watched by the
+// main thread
+struct reactor_handler_t ring_handler = {-1, 0};
+
+// eventfd written by the main thread to stop the capture thread
+struct reactor_handler_t capture_stop = {-1, 0};
+
+// eventfd written by the main thread to pause the capture thread, while the
+// buttons are changed by a reload
+struct reactor_handler_t capture_pause = {-1, 0};
+
+// Barrier where the main thread and the capture thread meet when the capture
+// thread is paused and when it's resumed
+pthread_barrier_t capture_barrier;
+
+// The capture thread
+pthread_t capture_thread;
+
+// Flag that tells if the capture thread is running
+int capture_running = 0;
+
+// Flag set by the capture thread when it stops because of an error
+atomic_int capture_failed = 0;
+
+// Timing wheel that keeps the timers of all the buttons
+struct timerwheel_t wheel;
+
+// The timerfd that drives the timing wheel
+struct reactor_timer_t wheel_timer = {{-1, 0}, 0};
+
+// Time when wheel_timer is armed to expire (ns), 0 if it isn't armed
+uint64_t wheel_deadline = 0;
+
+// Histograms of the latencies of each stage (ns)
+struct histogram_t latencies[STAGES];
+
+// Path of the socket where the statistics are served, NULL for no socket
+const char *stats_path = 0;
+
+// The listening socket of the statistics
+struct reactor_handler_t stats_socket = {-1, 0};
+
+// Flag that tells if the memory must be prefaulted and locked
+int lock_memory = 0;
+
+// Priority of the threads under SCHED_FIFO, 0 to keep the normal scheduling
+unsigned int rt_priority = 0;
+
+// CPU where the threads are pinned, -1 to use all the CPUs
+int cpu = -1;
+
+/* Print a line of a report to the standard error, or to the syslog if the
+   process is a daemon.
+
+   Parameters:
+     * format: the format of the line, without the final new line.
+     * ...: the arguments of the format.
+*/
+void
+report(const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    if (is_daemon) {
+        vsyslog(LOG_INFO, format, ap);
+    } else {
+        fprintf(stderr, PROGNAME ": ");
+        vfprintf(stderr, format, ap);
+        fputc('\n', stderr);
+    }
+    va_end(ap);
+}
+
+/* Check the scheduling of a thread against the one asked in the command line
+   and print it to the standard error.
+
+   Parameters:
+     * name: name of the thread, for the report.
+     * t: the thread.
+
+   Return 0 if the thread has the scheduling asked, 1 otherwise.
+*/
+int
+check_thread(const char *name, pthread_t t)
+{
+    struct sched_param param;
+    int policy, ok, e = 0;
+    cpu_set_t cpus;
+
+    if (rt_priority) {
+        ok = !pthread_getschedparam(t, &policy, &param)
+            && policy == SCHED_FIFO
+            && param.sched_priority == (int)rt_priority;
+        report("%s thread: SCHED_FIFO priority %u %s", name, rt_priority,
+            ok ? "in effect" : "NOT in effect");
+        e |= !ok;
+    }
+    if (cpu >= 0) {
+        ok = !pthread_getaffinity_np(t, sizeof(cpus), &cpus)
+            && CPU_COUNT(&cpus) == 1 && CPU_ISSET(cpu, &cpus);
+        report("%s thread: pinned to CPU %d %s", name, cpu,
+            ok ? "in effect" : "NOT in effect");
+        e |= !ok;
+    }
+    return e;
+}
+
+/* Read a value, in kB, from /proc/self/status.
+
+   Parameters:
+     * key: the name of the value, with the colon (i.e. "VmLck:").
+
+   Return the value, or 0 if it cannot be read.
+*/
+unsigned long
+proc_status_kb(const char *key)
+{
+    char line[128];
+    unsigned long kb = 0;
+    size_t len = strlen(key);
+    FILE *f;
+
+    f = fopen("/proc/self/status", "r");
+    if (!f) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, key, len)) {
+            kb = strtoul(line + len, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+/* Check that the real-time settings asked in the command line are in effect
+   and report them: the scheduling of the main thread
+   and of the capture thread, the memory locked and the major page faults
+   since the start.
+
+   Return 0 if all the settings are in effect, 1 otherwise.
+*/
+int
+check_realtime()
+{
+    unsigned long locked, resident;
+    struct rusage usage;
+    int e;
+
+    e = check_thread("main", pthread_self());
+    if (capture_running) {
+        e |= check_thread("capture", capture_thread);
+    }
+    if (lock_memory) {
+        locked = proc_status_kb("VmLck:");
+        resident = proc_status_kb("VmRSS:");
+        report("memory: %lu kB locked, %lu kB resident %s", locked,
+            resident, locked ? "in effect" : "NOT in effect");
+        e |= !locked;
+    }
+    if (!getrusage(RUSAGE_SELF, &usage)) {
+        report("%ld major page faults", usage.ru_majflt);
+    }
+    return e;
+}
+
+// Report the counters of the buttons and of the ring of edges, and the
+// latencies of the stages.
+void
+report_buttons()
+{
+    struct dictint_iterator_t i;
+    int gpio;
+    struct button_t *b;
+    struct histogram_t *h;
+
+    if (ring.edges) {
+        report("ring of edges: size %zu, maximum used %zu, %lu edges dropped",
+            ring_size(&ring), atomic_load(&(ring.high_watermark)),
+            atomic_load(&(ring.overflows)));
+    }
+    report("configuration: %zu bytes in %u chunks", arena_used(config_arena),
+        arena_chunks(config_arena));
+    dictint_iterator_begin(&dict_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void**)&b)) {
+        report("GPIO %d: %lu edges, %lu filtered by the debounce (%s)", gpio,
+            b->edges, b->filtered,
+            !b->debounce ? "none" : b->soft_debounce ? "software" : "kernel");
+    }
+    for (int s = 0; s < STAGES; s++) {
+        h = &(latencies[s]);
+        report("%s: %llu samples, p50 %.1f us, p90 %.1f us, p99 %.1f us,"
+            " max %.1f us", stage_names[s], (unsigned long long)h->count,
+            histogram_percentile(h, 50) / 1000.0,
+            histogram_percentile(h, 90) / 1000.0,
+            histogram_percentile(h, 99) / 1000.0, h->max / 1000.0);
+    }
+    if (lock_memory || rt_priority || cpu >= 0) {
+        check_realtime();
+    }
+}
+
+/* Write the per-stage histogram of latencies in Prometheus text format.
+
+   Parameters:
+     * f: the stream where the statistics are written.
+*/
+void
+write_latencies(FILE *f)
+{
+    struct histogram_t *h;
+
+    fprintf(f, "# HELP buttonsd_latency_seconds Latency of each stage from"
+        " an edge to the end of an action.\n"
+        "# TYPE buttonsd_latency_seconds histogram\n");
+    for (int s = 0; s < STAGES; s++) {
+        h = &(latencies[s]);
+        for (int l = STATS_FIRST_LIMIT; l <= STATS_LAST_LIMIT; l++) {
+            fprintf(f, "buttonsd_latency_seconds_bucket{stage=\"%s\","
+                "le=\"%.9g\"} %llu\n", stage_names[s],
+                (double)(((uint64_t)1 << l) - 1) / 1e9,
+                (unsigned long long)histogram_count_at_most(h,
+                    ((uint64_t)1 << l) - 1));
+        }
+        fprintf(f, "buttonsd_latency_seconds_bucket{stage=\"%s\","
+            "le=\"+Inf\"} %llu\n", stage_names[s],
+            (unsigned long long)h->count);
+        fprintf(f, "buttonsd_latency_seconds_sum{stage=\"%s\"} %.9f\n",
+            stage_names[s], h->sum / 1e9);
+        fprintf(f, "buttonsd_latency_seconds_count{stage=\"%s\"} %llu\n",
+            stage_names[s], (unsigned long long)h->count);
+    }
+}
+
+/* Write the label of the pins of a chord: the pins joined by '+', as in the
+   configuration file.
+
+   Parameters:
+     * c: the chord.
+     * pins: the buffer where the label is written.
+     * size: the size of the buffer.
+*/
+void
+chord_pins(struct chord_t *c, char *pins, size_t size)
+{
+    size_t len = 0;
+
+    pins[0] = '\0';
+    for (unsigned int k = 0; k < c->nbuttons && len < size; k++) {
+        len += snprintf(pins + len, size - len, k ? "+%u" : "%u",
+            c->buttons[k]->gpio.pin);
+    }
+}
+
+/* Write a counter of the actions of the events of a button in Prometheus
+   text format, added by type of event.
+
+   Parameters:
+     * f: the stream where the statistics are written.
+     * name: the name of the counter.
+     * failures: 1 to write the failed executions, 0 to write them all.
+     * source: the pins of the events, for the label.
+     * events: the events of each type.
+*/
+void
+write_action_counter(FILE *f, const char *name, int failures,
+    const char *source, struct vector_t *events)
+{
+    struct event_t *e;
+    unsigned long n;
+
+    for (int t = 0; t < EVENT_TYPES; t++) {
+        if (!events[t].size) {
+            continue;
+        }
+        n = 0;
+        for (size_t k = 0; k < events[t].size; k++) {
+            e = (struct event_t*)events[t].elems[k];
+            n += failures ? e->failures : e->runs;
+        }
+        fprintf(f, "%s{pins=\"%s\",event=\"%s\"} %lu\n", name, source,
+            event_names[t], n);
+    }
+}
+
+/* Write a counter of the actions of all the buttons and chords in Prometheus
+   text format.
+
+   Parameters:
+     * f: the stream where the statistics are written.
+     * name: the name of the counter.
+     * failures: 1 to write the failed executions, 0 to write them all.
+*/
+void
+write_actions(FILE *f, const char *name, int failures)
+{
+    struct dictint_iterator_t i;
+    struct list_iterator_t j;
+    int gpio;
+    struct button_t *b;
+    struct chord_t *c;
+    char pins[MAX_CHORD_BUTTONS * 12];
+
+    fprintf(f, "# TYPE %s counter\n", name);
+    dictint_iterator_begin(&dict_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void**)&b)) {
+        snprintf(pins, sizeof(pins), "%d", gpio);
+        write_action_counter(f, name, failures, pins, b->events);
+    }
+    list_iterator_begin(&chords, &j);
+    while (list_iterator_next(&j, (void **)&c)) {
+        chord_pins(c, pins, sizeof(pins));
+        fprintf(f, "%s{pins=\"%s\",event=\"chord\"} %u\n", name, pins,
+            failures ? c->event->failures : c->event->runs);
+    }
+}
+
+/* Write all the statistics in Prometheus text format: the counters of the
+   ring, the counters of each pin and of each chord, and the latencies. The
+   lines of each metric are written together, as the format demands.
 
-// Flag that indicates that the process must stop. This flag is set by a
-// signal handler.
-int stop = 0;
+   Parameters:
+     * f: the stream where the statistics are written.
+*/
+void
+write_stats(FILE *f)
+{
+    struct dictint_iterator_t i;
+    struct list_iterator_t j;
+    int gpio;
+    struct button_t *b;
+    struct chord_t *c;
+    char pins[MAX_CHORD_BUTTONS * 12];
+
+    fprintf(f, "# TYPE buttonsd_ring_dropped_total counter\n"
+        "buttonsd_ring_dropped_total %lu\n"
+        "# TYPE buttonsd_ring_high_watermark gauge\n"
+        "buttonsd_ring_high_watermark %zu\n",
+        atomic_load(&(ring.overflows)), atomic_load(&(ring.high_watermark)));
+    fprintf(f, "# TYPE buttonsd_edges_total counter\n");
+    dictint_iterator_begin(&dict_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void**)&b)) {
+        fprintf(f, "buttonsd_edges_total{pins=\"%d\"} %lu\n", gpio,
+            b->edges);
+    }
+    fprintf(f, "# TYPE buttonsd_edges_filtered_total counter\n");
+    dictint_iterator_begin(&dict_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void**)&b)) {
+        fprintf(f, "buttonsd_edges_filtered_total{pins=\"%d\"} %lu\n", gpio,
+            b->filtered);
+    }
+    fprintf(f, "# TYPE buttonsd_events_total counter\n");
+    dictint_iterator_begin(&dict_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void**)&b)) {
+        for (int t = 0; t < EVENT_TYPES; t++) {
+            if (b->types & (1 << t)) {
+                fprintf(f, "buttonsd_events_total{pins=\"%d\","
+                    "event=\"%s\"} %lu\n", gpio, event_names[t],
+                    b->recognized[t]);
+            }
+        }
+    }
+    list_iterator_begin(&chords, &j);
+    while (list_iterator_next(&j, (void **)&c)) {
+        chord_pins(c, pins, sizeof(pins));
+        fprintf(f, "buttonsd_events_total{pins=\"%s\",event=\"chord\"}"
+            " %lu\n", pins, c->recognized);
+    }
+    write_actions(f, "buttonsd_actions_total", 0);
+    write_actions(f, "buttonsd_action_failures_total", 1);
+    write_latencies(f);
+}
 
-/* Signals handler.
-   This handler is executed upon reception of the signals SIGINT and SIGTERM.
-   The stop flag it is set, which indicates that the process must finish.
+/* Serve the statistics to the clients connected to the socket of the
+   statistics. Each client receives the statistics and the connection is
+   closed, no request is read. Called by the main reactor.
 
    Parameters:
-     * signum: the signal received (although it is not used).
+     * h: the handler of the listening socket.
+     * events: the epoll events (not used).
 */
 void
-signal_handler(int signum)
+stats_request(struct reactor_handler_t *h, uint32_t events)
+{
+    char *text;
+    size_t len;
+    FILE *f;
+    int fd;
+
+    while ((fd = accept4(h->fd, NULL, NULL, SOCK_CLOEXEC)) >= 0) {
+        f = open_memstream(&text, &len);
+        if (!f) {
+            warn("cannot write the statistics");
+            close(fd);
+            continue;
+        }
+        write_stats(f);
+        fclose(f);
+        // The client must be ready to read, the daemon never waits for it
+        if (send(fd, text, len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+            warn("cannot send the statistics");
+        }
+        free(text);
+        close(fd);
+    }
+}
+
+/* Create the socket of the statistics, if its path was given, and add it
+   to the main reactor. An old socket in the path is replaced.
+
+   Return 0 if the socket is being watched, 1 otherwise.
+*/
+int
+open_stats_socket()
+{
+    struct sockaddr_un addr;
+
+    if (!stats_path) {
+        return 0;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(stats_path) >= sizeof(addr.sun_path)) {
+        warnx("the path '%s' is too long for a socket", stats_path);
+        return 1;
+    }
+    strcpy(addr.sun_path, stats_path);
+    stats_socket.fd = socket(AF_UNIX,
+        SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (stats_socket.fd < 0) {
+        warn("cannot create the socket of the statistics");
+        return 1;
+    }
+    unlink(stats_path);
+    if (bind(stats_socket.fd, (struct sockaddr*)&addr, sizeof(addr))
+        || listen(stats_socket.fd, STATS_BACKLOG))
+    {
+        warn("cannot listen in '%s'", stats_path);
+        return 1;
+    }
+    stats_socket.callback = stats_request;
+    if (reactor_add(&reactor, &stats_socket, EPOLLIN)) {
+        warn("cannot watch the socket of the statistics");
+        return 1;
+    }
+    return 0;
+}
+
+// Close the socket of the statistics and remove it from the file system
+void
+close_stats_socket()
 {
-    // Set the done flag
-    stop = 1;
+    if (stats_socket.fd >= 0) {
+        close(stats_socket.fd);
+        unlink(stats_path);
+    }
 }
 
 // Print a help message and exit.
@@ -152,7 +848,30 @@ print_help()
 "  -v, --version               Show version information.\n"
 "  -c PATH, --config PATH      Give the configuration file.\n"
 "  -d, --daemonize             Daemonize this process.\n"
-"  -p PATH, --pidfile PATH     Create a pidfile.\n\n"
+"  -p PATH, --pidfile PATH     Create a pidfile.\n"
+"  -g CHIP, --gpiochip CHIP    Read the buttons from the GPIO character device\n"
+"                              CHIP (i.e. /dev/gpiochip0) instead of sysfs.\n"
+"                              The pins are the offsets of the lines in CHIP.\n"
+"  -r N, --ring-size N         Number of edges queued between the capture\n"
+"                              thread and the main thread (256 by default).\n"
+"  -l, --mlock                 Prefault and lock the memory of the process.\n"
+"  -t PRIO, --rt-priority PRIO Run the capture thread and the main thread\n"
+"                              under SCHED_FIFO with priority PRIO.\n"
+"  -a CPU, --affinity CPU      Pin the capture thread and the main thread to\n"
+"                              CPU. The actions run with the normal\n"
+"                              scheduling in all the CPUs.\n"
+"  -s PATH, --stats-socket PATH\n"
+"                              Serve the counters and the latencies in the\n"
+"                              Unix socket PATH, in Prometheus text format.\n"
+"  -S DIR, --sim DIR           Read the buttons from the FIFOs DIR/PIN instead\n"
+"                              of GPIOs, for benchmarks. The FIFOs receive\n"
+"                              edges as the GPIO character device.\n"
+"  -R PATH, --record PATH      Record all the edges in the trace PATH.\n"
+"  -P PATH, --replay PATH      Replay the trace PATH as fast as possible and\n"
+"                              print the events recognized instead of\n"
+"                              executing the actions, then exit.\n"
+"  -w, --watch-config          Reload the configuration file when it is\n"
+"                              written, as with SIGHUP.\n\n"
 
 "Report bugs to:\n"
 "Antonio Serrano Hernandez (" PACKAGE_BUGREPORT ")\n"
@@ -172,6 +891,23 @@ print_version()
     exit(0);
 }
 
+/* Parse a positive number given in the command line or exit.
+
+   Parameters:
+     * s: the string that contains the number.
+*/
+unsigned int
+parse_arg_number(const char *s)
+{
+    const char *eptr;
+    unsigned int n;
+
+    if (parse_number(s, &eptr, &n) || eptr == s || *eptr != '\0' || !n) {
+        errx(1, "invalid number '%s'", s);
+    }
+    return n;
+}
+
 /* Parse the command line arguments.
 
    Parameters:
@@ -187,8 +923,20 @@ parse_args(int argc, char **argv)
         {"config", required_argument, 0, 'c'},
         {"daemonize", no_argument, 0, 'd'},
         {"pidfile", required_argument, 0, 'p'},
+        {"gpiochip", required_argument, 0, 'g'},
+        {"ring-size", required_argument, 0, 'r'},
+        {"mlock", no_argument, 0, 'l'},
+        {"rt-priority", required_argument, 0, 't'},
+        {"affinity", required_argument, 0, 'a'},
+        {"stats-socket", required_argument, 0, 's'},
+        {"sim", required_argument, 0, 'S'},
+        {"record", required_argument, 0, 'R'},
+        {"replay", required_argument, 0, 'P'},
+        {"watch-config", no_argument, 0, 'w'},
         {0, 0, 0, 0}
     };
+    const char *eptr;
+    unsigned int n;
     int o;
 
     do {
@@ -207,6 +955,46 @@ parse_args(int argc, char **argv)
             case 'p':
                 pidfile = optarg;
                 break;
+            case 'g':
+                gpiochip = optarg;
+                break;
+            case 'r':
+                ring_size_arg = parse_arg_number(optarg);
+                break;
+            case 'l':
+                lock_memory = 1;
+                break;
+            case 't':
+                rt_priority = parse_arg_number(optarg);
+                if (rt_priority > sched_get_priority_max(SCHED_FIFO)) {
+                    errx(1, "the maximum real-time priority is %d",
+                        sched_get_priority_max(SCHED_FIFO));
+                }
+                break;
+            case 'a':
+                // The CPU 0 is valid, so parse_arg_number cannot be used
+                if (parse_number(optarg, &eptr, &n) || eptr == optarg
+                    || *eptr != '\0' || n >= CPU_SETSIZE)
+                {
+                    errx(1, "invalid CPU '%s'", optarg);
+                }
+                cpu = n;
+                break;
+            case 's':
+                stats_path = optarg;
+                break;
+            case 'S':
+                sim_dir = optarg;
+                break;
+            case 'R':
+                record_path = optarg;
+                break;
+            case 'P':
+                replay_path = optarg;
+                break;
+            case 'w':
+                watch_config = 1;
+                break;
             case '?':
                 exit(1);
             default:
@@ -215,400 +1003,2056 @@ parse_args(int argc, char **argv)
     } while (o != -1);
 }
 
-// Set the handler for the signals SIGINT and SIGTERM, to stop this process.
-void
-set_signals()
+/* Block the signals SIGINT, SIGTERM, SIGUSR1 and SIGHUP. They are received
+   later through the reactor's signalfd.
 
+   Return 0 if the signals were blocked, 1 otherwise.
+*/
+int
+set_signals()
+{
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGHUP);
+    if (reactor_block_signals(&signals)) {
+        warn("cannot block signals");
+        return 1;
+    }
+    return 0;
+}
+
+/* Record the latency of the launch of an action. This function is called
+   when the spawner reports that it has launched the action.
+
+   Parameters:
+     * data: the event whose action was launched.
+     * delay: time from the recognition of the event to the launch (ns).
+*/
+void
+action_started(void *data, uint64_t delay)
+{
+    histogram_record(&(latencies[STAGE_SPAWN]), delay);
+}
+
+/* Record the result of an execution of an action. This function is called
+   when the spawner reports that the process that executes the action has
+   finished.
+
+   Parameters:
+     * data: the event whose action was executed.
+     * status: exit status of the process, as returned by waitpid.
+     * duration: time that the action was running, in nanoseconds.
+*/
+void
+action_finished(void *data, int status, uint64_t duration)
+{
+    struct event_t *e = (struct event_t*)data;
+
+    histogram_record(&(latencies[STAGE_EXIT]), duration);
+    e->runs++;
+    e->last_status = status;
+    e->last_time = duration;
+    e->total_time += duration;
+    if (duration > e->max_time) {
+        e->max_time = duration;
+    }
+    if (WIFSIGNALED(status)) {
+        e->failures++;
+        warnx("action '%s' killed by signal %d", e->action.command,
+            WTERMSIG(status));
+    } else if (WEXITSTATUS(status)) {
+        e->failures++;
+        warnx("action '%s' finished with status %d", e->action.command,
+            WEXITSTATUS(status));
+    }
+}
+
+/* Report an action that the spawner couldn't launch.
+
+   Parameters:
+     * data: the event whose action couldn't be launched.
+     * error: the error number.
+*/
+void
+action_failed(void *data, int error)
+{
+    struct event_t *e = (struct event_t*)data;
+
+    warnx("cannot execute action '%s': %s", e->action.command,
+        strerror(error));
+}
+
+/* Initialize some data structures that the application must use. The
+   dictionary of the buttons and the list of chords are initialized when the
+   configuration file is read, in its arena.
+
+   Return 0 if the initialization was correct, 1 otherwise.
+*/
+int
+init_data_structures()
+{
+    // Initialize the histograms of the latencies
+    for (int i = 0; i < STAGES; i++) {
+        histogram_init(&(latencies[i]));
+    }
+    return 0;
+}
+
+/* Return 1 if the buttons are read through sysfs, 0 if they are read through
+   the GPIO character device, simulated or replayed.
+*/
+int
+use_sysfs()
+{
+    return !gpiochip && !sim_dir && !replay_path;
+}
+
+/* Return a button given the GPIO pin number where it is connected.
+
+   Parameters:
+     * gpio: the GPIO pin number where the button is.
+*/
+struct button_t*
+get_button_by_pin(gpio_pin_t gpio)
+{
+    return dictint_get(&dict_buttons, gpio);
+}
+
+/* Add a new button to the dictionary dict_buttons. Then, return the new
+   button.
+
+   Parameters:
+     * gpio: the GPIO pin number where the button is connected.
+
+   Return the button created, or NULL if error.
+*/
+struct button_t*
+add_button(gpio_pin_t gpio)
+{
+    struct button_t *g;
+
+    g = (struct button_t*)arena_alloc(config_arena, sizeof(struct button_t));
+    if (!g) {
+        warn("allocating button");
+        return NULL;
+    }
+
+    // Initialize the instance g
+    g->handler.fd = -1;
+    g->gpio.pin = gpio;
+    g->gpio.flags = 0;
+    g->opened = 0;
+    g->timestamp = 0;
+    g->debounce = 0;
+    g->soft_debounce = 0;
+    timerwheel_timer_init(&(g->settle), NULL);
+    g->raw = 0;
+    g->raw_timestamp = 0;
+    g->pressed = 0;
+    g->edges = 0;
+    g->filtered = 0;
+    memset(g->recognized, 0, sizeof(g->recognized));
+    timerwheel_timer_init(&(g->timer), NULL);
+    g->timer_input = GESTURE_HOLD;
+    g->long_click_time = DEFAULT_LONG_CLICK_TIME * NS_PER_MS;
+    g->hold_repeat_interval = DEFAULT_HOLD_REPEAT_INTERVAL * NS_PER_MS;
+    g->multi_click_time = DEFAULT_MULTI_CLICK_TIME * NS_PER_MS;
+    g->types = 0;
+    // The GPIO is opened when the button is watched, so a configuration can
+    // be read without touching the GPIOs
+    // Initialize the events and the list of chords
+    for (int t = 0; t < EVENT_TYPES; t++) {
+        vector_init(&(g->events[t]), config_arena);
+    }
+    if (list_init(&(g->chords), config_arena)) {
+        warn("error initializing list of chords");
+        return NULL;
+    }
+    // Add the element to the dictionary
+    if (dictint_add(&dict_buttons, gpio, g)) {
+        warn("adding new button to dictionary");
+        return NULL;
+    }
+    return g;
+}
+
+/* Add an event/action couple to a given GPIO button.
+
+   Parameters:
+     * button: the button where the event must be added.
+     * event: the event to add.
+
+   Return 0 if the event was correctly added to the button, 1 otherwise.
+*/
+int
+add_event(struct button_t *button, struct event_t *event)
+{
+    if (vector_add(&(button->events[event->type]), event)) {
+        warn("adding event");
+        return 1;
+    }
+    button->types |= 1 << event->type;
+    return 0;
+}
+
+/* Add a chord, with its event/action couple, to a set of buttons.
+
+   Parameters:
+     * buttons: the buttons of the chord.
+     * nbuttons: the number of buttons.
+     * event: the event of the chord.
+
+   Return 0 if the chord was correctly added, 1 otherwise.
+*/
+int
+add_chord(struct button_t **buttons, unsigned int nbuttons,
+    struct event_t *event)
+{
+    struct chord_t *c;
+
+    c = (struct chord_t*)arena_alloc(config_arena, sizeof(struct chord_t));
+    if (!c) {
+        warn("allocating chord");
+        return 1;
+    }
+    c->buttons = (struct button_t**)arena_alloc(config_arena,
+        sizeof(struct button_t*) * nbuttons);
+    if (!c->buttons) {
+        warn("allocating chord");
+        return 1;
+    }
+    memcpy(c->buttons, buttons, sizeof(struct button_t*) * nbuttons);
+    c->nbuttons = nbuttons;
+    c->pressed = 0;
+    c->recognized = 0;
+    c->event = event;
+    if (list_add(&chords, c)) {
+        warn("adding chord");
+        return 1;
+    }
+    for (unsigned int i = 0; i < nbuttons; i++) {
+        if (list_add(&(buttons[i]->chords), c)) {
+            warn("adding chord");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Return the type of an event given its name, or -1 if there's no event with
+   that name.
+
+   Parameters:
+     * name: the name of the event.
+*/
+int
+get_event_type(const char *name)
+{
+    for (int i = 0; i < EVENT_TYPES; i++) {
+        if (strcmp(name, event_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Parse the event and the action of a line of the configuration file. The
+   action is sent to the spawner later, by define_events.
+
+   Parameters:
+     * type: the type of the event.
+     * command: the action to execute (see action_init).
+     * linenum: line number in the file (for error reporting purposes).
+
+   Return the parsed event in case of success, NULL otherwise.
+*/
+struct event_t*
+parse_button_action(enum event_type_t type, const char *command, int linenum)
+{
+    struct event_t *event;
+    const char *error;
+
+    // Allocate the event, the action is allocated by action_init
+    event = (struct event_t*)arena_alloc(config_arena,
+        sizeof(struct event_t));
+    if (!event) {
+        warn("allocating event");
+        return NULL;
+    }
+    event->type = type;
+    // Parse the action
+    if (action_init(&(event->action), command, config_arena, &error)) {
+        warnx("%s: at line %d: %s", config, linenum, error);
+        action_free(&(event->action));
+        return NULL;
+    }
+    event->id = EVENT_UNDEFINED;
+    event->runs = 0;
+    event->failures = 0;
+    event->last_status = 0;
+    event->last_time = 0;
+    event->total_time = 0;
+    event->max_time = 0;
+    return event;
+}
+
+/* Parse a setting of a button.
+
+   Parameters:
+     * button: the button whose setting is parsed.
+     * name: the name of the setting (debounce, long_click_time,
+         hold_repeat_interval or multi_click_time).
+     * value: the value of the setting.
+     * linenum: line number in the file (for error reporting purposes).
+
+   Return 0 if the setting was parsed, 1 if it is not valid.
+*/
+int
+parse_button_setting(struct button_t *button, const char *name,
+    const char *value, int linenum)
+{
+    const char *eptr;
+    unsigned int n;
+    uint64_t *time = NULL;
+
+    if (parse_number(value, &eptr, &n) || eptr == value || *eptr != '\0') {
+        warnx("%s: at line %d: invalid number '%s'", config, linenum, value);
+        return 1;
+    }
+    if (strcmp(name, "debounce") == 0) {
+        if (n > MAX_DEBOUNCE) {
+            warnx("%s: at line %d: debounce greater than %d ms", config,
+                linenum, MAX_DEBOUNCE);
+            return 1;
+        }
+        button->debounce = n;
+    } else if (strcmp(name, "long_click_time") == 0) {
+        time = &(button->long_click_time);
+    } else if (strcmp(name, "hold_repeat_interval") == 0) {
+        time = &(button->hold_repeat_interval);
+    } else if (strcmp(name, "multi_click_time") == 0) {
+        time = &(button->multi_click_time);
+    } else {
+        warnx("%s: at line %d: unknown event or setting '%s'", config,
+            linenum, name);
+        return 1;
+    }
+    // The times must be greater than 0
+    if (time) {
+        if (!n) {
+            warnx("%s: at line %d: %s must be greater than 0", config,
+                linenum, name);
+            return 1;
+        }
+        *time = n * NS_PER_MS;
+    }
+    return 0;
+}
+
+/* Parse a single line of the configuration file:
+
+   <gpio_pin_number>[+<gpio_pin_number>...]_<key>=<value>
+
+   Where:
+     * gpio_pin_number: the GPIO pin number where the button is connected.
+         Several pins joined by '+' are a chord.
+     * key: an event (click, double_click, triple_click, long_click,
+         hold_repeat or, for several pins, chord), then the value is the
+         action to execute (see action_init), or a setting of the button
+         (debounce, long_click_time, hold_repeat_interval or
+         multi_click_time).
+
+   Parameters:
+     * line: the part of the line before the '=', ended by a null character.
+         It is modified.
+     * value: the part of the line after the '=', without the new line, or
+         NULL if the line has no '='.
+     * linenum: line number in the file (for error reporting purposes).
+
+   Return 0 if the line was parsed, 1 otherwise.
+*/
+int
+parse_line(char *line, const char *value, int linenum)
+{
+    char *eptr, *key;
+    unsigned int pins[MAX_CHORD_BUTTONS], npins = 0;
+    struct button_t *buttons[MAX_CHORD_BUTTONS];
+    int type;
+    struct event_t *event;
+
+    // The tokenizer has split the line at the '=' sign
+    if (!value) {
+        warnx("%s: at line %d: expected '='", config, linenum);
+        return 1;
+    }
+    // Parse the pin numbers
+    // A new pin variable is used to recover the pin number because we are not
+    // sure if gpio_pin_t and unsigned int have the same size.
+    eptr = line;
+    do {
+        key = npins ? eptr + 1 : eptr;
+        if (npins == MAX_CHORD_BUTTONS) {
+            warnx("%s: at line %d: more than %d buttons in a chord", config,
+                linenum, MAX_CHORD_BUTTONS);
+            return 1;
+        }
+        if (parse_number(key, (const char **)&eptr, &(pins[npins]))) {
+            warnx("%s: at line %d: GPIO pin out of range", config, linenum);
+            return 1;
+        }
+        if (eptr == key) {
+            break;
+        }
+        for (unsigned int i = 0; i < npins; i++) {
+            if (pins[i] == pins[npins]) {
+                warnx("%s: at line %d: repeated button in chord", config,
+                    linenum);
+                return 1;
+            }
+        }
+        npins++;
+    } while (*eptr == '+');
+    if (eptr == key || *eptr != '_') {
+        warnx("%s: at line %d: expected <pin>_<key>", config, linenum);
+        return 1;
+    }
+    // The key follows the '_', the pins are the source of the event
+    *eptr = '\0';
+    key = eptr + 1;
+    // Check if the buttons are already in the dictionary, or create them
+    for (unsigned int i = 0; i < npins; i++) {
+        buttons[i] = get_button_by_pin(pins[i]);
+        if (!buttons[i] && !(buttons[i] = add_button(pins[i]))) {
+            return 1;
+        }
+    }
+    // The key is an event or else a setting
+    type = get_event_type(key);
+    if (npins > 1 && type != EVENT_CHORD) {
+        warnx("%s: at line %d: only a chord can have several buttons", config,
+            linenum);
+        return 1;
+    }
+    if (npins == 1 && type == EVENT_CHORD) {
+        warnx("%s: at line %d: a chord needs two or more buttons", config,
+            linenum);
+        return 1;
+    }
+    if (type < 0) {
+        return parse_button_setting(buttons[0], key, value, linenum);
+    }
+    event = parse_button_action(type, value, linenum);
+    if (!event) {
+        return 1;
+    }
+    if (type == EVENT_CHORD) {
+        return add_chord(buttons, npins, event);
+    }
+    return add_event(buttons[0], event);
+}
+
+/* Free the action of an event, removing it from the spawner if it was
+   defined. The event itself is freed with the arena of its configuration.
+
+   Parameters:
+     * e: the event.
+*/
+void
+free_event(struct event_t *e)
+{
+    if (e->id != EVENT_UNDEFINED && spawner_undefine(&spawner, e->id)) {
+        warn("cannot remove action '%s' from the spawner", e->action.command);
+    }
+    action_free(&(e->action));
+}
+
+/* Free the events of a button, but not the ones taken by another
+   configuration (NULL in the arrays).
+
+   Parameters:
+     * events: the events of each type.
+*/
+void
+free_events(struct vector_t *events)
+{
+    for (int t = 0; t < EVENT_TYPES; t++) {
+        for (size_t k = 0; k < events[t].size; k++) {
+            if (events[t].elems[k]) {
+                free_event((struct event_t*)events[t].elems[k]);
+            }
+        }
+    }
+}
+
+/* Free a configuration that was read but is not used: the actions of its
+   events and its arena. Its GPIOs were never opened.
+*/
+void
+free_configuration()
+{
+    struct dictint_iterator_t i;
+    struct list_iterator_t j;
+    struct button_t *b;
+    struct chord_t *c;
+    int gpio;
+
+    dictint_iterator_begin(&dict_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void **)&b)) {
+        free_events(b->events);
+    }
+    list_iterator_begin(&chords, &j);
+    while (list_iterator_next(&j, (void **)&c)) {
+        free_event(c->event);
+    }
+    dictint_free(&dict_buttons);
+    list_free(&chords);
+    arena_free(config_arena);
+}
+
+/* Return an upper bound of the bytes of config_arena taken by a
+   configuration file. The file is counted before it is tokenized, in a pass
+   that takes each line that is not blank or a comment as an entry, with a
+   button per pin of its key and an action as long as the whole line.
+
+   Parameters:
+     * f: the configuration file, not read yet.
+     * pins: at output, an upper bound of the number of buttons.
+*/
+size_t
+configuration_size(const struct conffile_t *f, size_t *pins)
+{
+    const char *line = f->data, *end = f->data + f->size, *next;
+    size_t size = 0, len, n;
+
+    *pins = 0;
+    while (line < end) {
+        next = memchr(line, '\n', end - line);
+        len = (next ? next : end) - line;
+        if (len && line[0] != '#') {
+            // The pins of the key, each one a button with its list of chords
+            n = 1;
+            for (const char *p = line; p < line + len && *p != '='; p++) {
+                n += *p == '+';
+            }
+            if (n > MAX_CHORD_BUTTONS) {
+                n = MAX_CHORD_BUTTONS;
+            }
+            *pins += n;
+            size += n * (ARENA_SIZE(sizeof(struct button_t))
+                + ARENA_SIZE(sizeof(struct list_node_t)));
+            // The event and its action
+            size += ARENA_SIZE(sizeof(struct event_t))
+                + action_arena_size(line, len);
+            // Its place in a vector of events, that leaves its smaller
+            // arrays behind when it grows: 4 pointers per element at most,
+            // and an alignment per array
+            size += 4 * sizeof(void*) + ARENA_ALIGN;
+            // Or the chord, with its buttons and its nodes
+            size += ARENA_SIZE(sizeof(struct chord_t))
+                + ARENA_SIZE(sizeof(struct button_t*) * n)
+                + (n + 1) * ARENA_SIZE(sizeof(struct list_node_t));
+        }
+        line = next ? next + 1 : end;
+    }
+    // The dictionary of the buttons, reserved for all the pins, and the
+    // sentinel of the list of chords
+    return size + dictint_arena_size(*pins)
+        + ARENA_SIZE(sizeof(struct list_node_t));
+}
+
+/* Read the configuration file.
+   The configuration file has variables that describe the actions to take
+   upon click on any of the buttons.
+   Empty lines and lines that start by '#' are ignored.
+   The rest of the lines must be of the form:
+
+   <number>_<click_type>=<action>
+
+   Where:
+     * number: is the GPIO pin where the button is connected.
+     * click_type: must be 'click', 'double_click', 'triple_click',
+         'long_click' or 'hold_repeat'. Identifies the type of click to be
+         performed to the button. A click is executed when the user releases
+         the button, immediately if the button has no double or triple
+         clicks, or else when no other click follows in the multi click
+         time. A long click is executed as soon as the button has been held
+         for the long click time (2 seconds by default). The hold repeats are
+         executed periodically while the button is still held after the long
+         click.
+     * action: action to be executed. It is a command line that is split in
+         arguments and executed directly, without a shell. If it starts by
+         '!' the rest of the line is executed by /bin/sh instead.
+
+   Or of the form:
+
+   <number>+<number>[+...]_chord=<action>
+
+   That executes the action when all the buttons are pressed together. Or of
+   the form:
+
+   <number>_<setting>=<ms>
+
+   That sets the debounce period of the button ('debounce', done by the
+   kernel if it can and here otherwise), the long click time
+   ('long_click_time'), the interval of the hold repeats
+   ('hold_repeat_interval') or the maximum time between the clicks of a
+   double or triple click ('multi_click_time'), in milliseconds.
+
+   The file is mapped in memory and tokenized in a single pass, without
+   copying the lines. A line with errors doesn't stop the parsing, so all the
+   errors of the file are reported at once.
+
+   The whole configuration, the actions included, is allocated from
+   config_arena. Its first chunk is sized by configuration_size before the
+   file is tokenized, so the buttons, the events, their actions and the
+   nodes of their lists are all in contiguous memory.
+
+   Return 0 if the configuration file was correctly read, 1 otherwise. In
+   case of error nothing is left allocated.
+*/
+int
+read_configuration_file(void)
+{
+    struct conffile_t f;
+    struct conffile_entry_t e;
+    unsigned int errors = 0;
+    size_t pins;
+    int r;
+
+    // Open the configuration file
+    if (conffile_open(&f, config)) {
+        warn("cannot open '%s'", config);
+        return 1;
+    }
+    arena_init(config_arena, configuration_size(&f, &pins));
+    if (dictint_init(&dict_buttons, config_arena)
+        || dictint_reserve(&dict_buttons, pins)
+        || list_init(&chords, config_arena))
+    {
+        warn("cannot allocate the configuration");
+        conffile_close(&f);
+        free_configuration();
+        return 1;
+    }
+    // Iterate over the entries of the configuration file to load the actions
+    while ((r = conffile_next(&f, &e)) > 0) {
+        if (parse_line(e.key, e.value, e.linenum)) {
+            // Error parsing the line with the button/event/action
+            errors++;
+        }
+    }
+    conffile_close(&f);
+    if (r < 0) {
+        warn("error reading configuration file");
+        free_configuration();
+        return 1;
+    }
+    if (errors) {
+        warnx("%s: errors in %u lines", config, errors);
+        free_configuration();
+        return 1;
+    }
+    return 0;
+}
+
+/* Send the action of an event to the spawner, if it's not defined yet.
+
+   Parameters:
+     * e: the event.
+     * source: the pins of the event (a single pin or the pins of a chord).
+
+   Return 0 if the action is defined, 1 otherwise.
+*/
+int
+define_event(struct event_t *e, const char *source)
+{
+    if (e->id != EVENT_UNDEFINED) {
+        return 0;
+    }
+    if (spawner_define(&spawner, &(e->action), source, event_names[e->type],
+        e, &(e->id)))
+    {
+        warn("cannot send action to the spawner");
+        return 1;
+    }
+    return 0;
+}
+
+/* Send to the spawner the actions of the configuration that are not defined
+   yet: all of them after the configuration file is read, and only the new
+   ones after a reload.
+
+   Return 0 if the actions are defined, 1 otherwise.
+*/
+int
+define_events()
+{
+    struct dictint_iterator_t i;
+    struct list_iterator_t j;
+    struct button_t *b;
+    struct chord_t *c;
+    char source[MAX_CHORD_BUTTONS * 12];
+    int gpio;
+
+    dictint_iterator_begin(&dict_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void **)&b)) {
+        snprintf(source, sizeof(source), "%d", gpio);
+        for (int t = 0; t < EVENT_TYPES; t++) {
+            for (size_t k = 0; k < b->events[t].size; k++) {
+                if (define_event(b->events[t].elems[k], source)) {
+                    return 1;
+                }
+            }
+        }
+    }
+    list_iterator_begin(&chords, &j);
+    while (list_iterator_next(&j, (void **)&c)) {
+        chord_pins(c, source, sizeof(source));
+        if (define_event(c->event, source)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Return 1 if two events have the same type and the same action, 0
+   otherwise.
+
+   Parameters:
+     * a: an event.
+     * b: the other event.
+*/
+int
+same_event(const struct event_t *a, const struct event_t *b)
+{
+    return a->type == b->type
+        && strcmp(a->action.command, b->action.command) == 0;
+}
+
+/* Record the latency of the recognition of an event. Called in the main
+   thread, it doesn't allocate memory.
+
+   Parameters:
+     * timestamp: time of the edge, or of the expiration of the timer, that
+         completed the event (ns of CLOCK_MONOTONIC).
+*/
+void
+record_recognition(uint64_t timestamp)
+{
+    uint64_t now;
+
+    // The time of a replay is the time of the trace, not of the clock
+    if (replay_path) {
+        return;
+    }
+    now = clock_now();
+    histogram_record(&(latencies[STAGE_CLASSIFY]),
+        now > timestamp ? now - timestamp : 0);
+}
+
+/* Launch the action of an event through the spawner. In a replay the action
+   is not launched, only counted.
+
+   Parameters:
+     * e: the event.
+     * timestamp: time when the event happened (ns of CLOCK_MONOTONIC).
+
+   Return 0 if the action was launched, 1 otherwise.
+*/
+int
+run_action(struct event_t *e, uint64_t timestamp)
+{
+    if (replay_path) {
+        e->runs++;
+        return 0;
+    }
+    return spawner_run(&spawner, e->id, timestamp);
+}
+
+/* Execute the actions described by a type of event and a button. The actions
+   are launched by the spawner, so this function never forks.
+
+   Parameters:
+     * button: the button clicked.
+     * event: the type of event.
+     * timestamp: time when the event happened (ns of CLOCK_MONOTONIC).
+*/
+void
+execute_actions(struct button_t *button, enum event_type_t event,
+    uint64_t timestamp)
+{
+    struct vector_t *v = &(button->events[event]);
+    struct event_t *e;
+
+    record_recognition(timestamp);
+    button->recognized[event]++;
+    if (replay_path) {
+        printf("%llu %d %s\n", (unsigned long long)timestamp,
+            button->gpio.pin, event_names[event]);
+    }
+    for (size_t k = 0; k < v->size; k++) {
+        e = (struct event_t*)v->elems[k];
+        if (run_action(e, timestamp)) {
+            warn("cannot execute action '%s'", e->action.command);
+        }
+    }
+}
+
+/* Rearm the timerfd that drives the timing wheel, if the first deadline of
+   the wheel is before the time when it was armed. When the first timer is
+   cancelled the timerfd is left armed: it just advances the wheel and rearms
+   itself. So most of the edges don't need any system call for the timers.
+*/
+void
+update_wheel_timer()
+{
+    uint64_t next = timerwheel_next(&wheel);
+
+    // In a replay the wheel is advanced by the edges of the trace
+    if (replay_path) {
+        return;
+    }
+    if (next && (!wheel_deadline || next < wheel_deadline)) {
+        wheel_deadline = next;
+        if (reactor_timer_arm(&wheel_timer, next)) {
+            warn("cannot arm the timer");
+            reactor_stop(&reactor, 1);
+        }
+    }
+}
+
+/* Process the expiration of the timerfd that drives the timing wheel:
+   advance the wheel, that fires the timers expired, and rearm the timerfd
+   for the next deadline.
+
+   Parameters:
+     * t: the timerfd (not used).
+*/
+void
+wheel_expired(struct reactor_timer_t *t)
+{
+    wheel_deadline = 0;
+    timerwheel_advance(&wheel, clock_now());
+    update_wheel_timer();
+}
+
+/* Feed an input to the gesture recognizer of a button, and do what the
+   transition says: execute the actions of the event and arm or cancel the
+   timer of the button.
+
+   Parameters:
+     * button: the button.
+     * input: the input.
+     * timestamp: time of the input (ns of CLOCK_MONOTONIC).
+*/
+void
+button_step(struct button_t *button, enum gesture_input_t input,
+    uint64_t timestamp)
+{
+    const struct gesture_transition_t *t;
+
+    t = gesture_step(&(button->gesture), input);
+    switch (t->timer) {
+        case GESTURE_TIMER_HOLD:
+            button->timer_input = GESTURE_HOLD;
+            timerwheel_arm(&wheel, &(button->timer),
+                timestamp + button->long_click_time);
+            update_wheel_timer();
+            break;
+        case GESTURE_TIMER_GAP:
+            button->timer_input = GESTURE_GAP;
+            timerwheel_arm(&wheel, &(button->timer),
+                timestamp + button->multi_click_time);
+            update_wheel_timer();
+            break;
+        case GESTURE_TIMER_REPEAT:
+            // The repeats are computed from the previous deadline, so they
+            // don't drift
+            button->timer_input = GESTURE_HOLD;
+            timerwheel_arm(&wheel, &(button->timer),
+                timestamp + button->hold_repeat_interval);
+            update_wheel_timer();
+            break;
+        case GESTURE_TIMER_CANCEL:
+            timerwheel_cancel(&wheel, &(button->timer));
+            break;
+        default:
+            break;
+    }
+    if (t->event != GESTURE_NO_EVENT) {
+        execute_actions(button, t->event, timestamp);
+    }
+}
+
+/* Process the expiration of the timer of a button.
+
+   Parameters:
+     * t: the timer of the button.
+*/
+void
+button_timer(struct timerwheel_timer_t *t)
+{
+    struct button_t *button =
+        (struct button_t*)((char*)t - offsetof(struct button_t, timer));
+
+    button_step(button, button->timer_input, t->deadline);
+}
+
+/* Update the chords of a button that was pressed or released. When all the
+   buttons of a chord are pressed its action is executed, and the buttons
+   don't fire other events until they are released.
+
+   Parameters:
+     * button: the button.
+     * pressed: 1 if the button was pressed, 0 if it was released.
+     * timestamp: time of the edge (ns of CLOCK_MONOTONIC).
+*/
+void
+button_chords(struct button_t *button, int pressed, uint64_t timestamp)
+{
+    struct list_iterator_t i;
+    struct chord_t *c;
+    char pins[MAX_CHORD_BUTTONS * 12];
+
+    list_iterator_begin(&(button->chords), &i);
+    while (list_iterator_next(&i, (void **)&c)) {
+        if (!pressed) {
+            c->pressed--;
+        } else if (++c->pressed == c->nbuttons) {
+            for (unsigned int j = 0; j < c->nbuttons; j++) {
+                timerwheel_cancel(&wheel, &(c->buttons[j]->timer));
+                gesture_consume(&(c->buttons[j]->gesture));
+            }
+            record_recognition(timestamp);
+            c->recognized++;
+            if (replay_path) {
+                chord_pins(c, pins, sizeof(pins));
+                printf("%llu %s chord\n", (unsigned long long)timestamp,
+                    pins);
+            }
+            if (run_action(c->event, timestamp)) {
+                warn("cannot execute action '%s'", c->event->action.command);
+            }
+        }
+    }
+}
+
+/* Process an edge in a button: feed it to its gesture recognizer and update
+   its chords.
+
+   Parameters:
+     * button: the button.
+     * pressed: 1 if the button was pressed, 0 if it was released.
+     * timestamp: time of the edge (ns of CLOCK_MONOTONIC).
+*/
+void
+button_edge(struct button_t *button, int pressed, uint64_t timestamp)
+{
+    if (pressed) {
+        // The button is pressed, timestamp the event
+        button->timestamp = timestamp;
+        button_step(button, GESTURE_PRESS, timestamp);
+    } else {
+        // If the timer didn't expire yet, but the edge says that it was a
+        // long click, fire it before the release
+        if (gesture_is_down(&(button->gesture))
+            && timestamp - button->timestamp >= button->long_click_time)
+        {
+            button_step(button, GESTURE_HOLD,
+                button->timestamp + button->long_click_time);
+        }
+        button_step(button, GESTURE_RELEASE, timestamp);
+    }
+    button_chords(button, pressed, timestamp);
+}
+
+/* Process the expiration of the software debounce timer of a button: the
+   line has been stable for the debounce period, so its level is the new
+   state of the button, unless the edges cancelled each other.
+
+   Parameters:
+     * t: the debounce timer of the button.
+*/
+void
+button_settled(struct timerwheel_timer_t *t)
+{
+    struct button_t *button =
+        (struct button_t*)((char*)t - offsetof(struct button_t, settle));
+
+    if (button->raw == button->pressed) {
+        button->filtered++;
+        return;
+    }
+    button->pressed = button->raw;
+    button_edge(button, button->pressed, button->raw_timestamp);
+}
+
+/* Process a level read from the line of a button. Without software debounce
+   the changes of level are edges of the button. With it, each edge restarts
+   the debounce timer and is discarded if another edge comes before the line
+   settles.
+
+   Parameters:
+     * button: the button.
+     * level: level of the line (1 high, 0 low).
+     * timestamp: time of the edge (ns of CLOCK_MONOTONIC).
+*/
+void
+button_input(struct button_t *button, int level, uint64_t timestamp)
+{
+    button->edges++;
+    if (!button->soft_debounce) {
+        if (level == button->pressed) {
+            // Repeated level, the line bounced faster than it was read
+            button->filtered++;
+            return;
+        }
+        button->pressed = level;
+        button_edge(button, level, timestamp);
+        return;
+    }
+    if (timerwheel_armed(&(button->settle))) {
+        // The previous edge didn't settle
+        button->filtered++;
+    }
+    button->raw = level;
+    button->raw_timestamp = timestamp;
+    timerwheel_arm(&wheel, &(button->settle),
+        timestamp + button->debounce * NS_PER_MS);
+    update_wheel_timer();
+}
+
+/* Push an edge of a button to the ring, from the capture thread. If the ring
+   is full the edge is dropped, and counted as an overflow of the ring.
+
+   Parameters:
+     * button: the button.
+     * level: level of the line (1 high, 0 low).
+     * timestamp: time of the edge (ns of CLOCK_MONOTONIC).
+*/
+void
+capture_edge(struct button_t *button, int level, uint64_t timestamp)
+{
+    struct ring_edge_t e;
+
+    e.source = button;
+    e.pin = button->gpio.pin;
+    e.level = level;
+    e.timestamp = timestamp;
+    ring_push(&ring, &e);
+}
+
+/* Wake up the main thread after pushing edges to the ring, from the capture
+   thread.
+*/
+void
+capture_notify()
+{
+    uint64_t one = 1;
+
+    if (write(ring_handler.fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        warn("cannot notify the main thread");
+        reactor_stop(&capture, 1);
+    }
+}
+
+/* Process a change of state in a button read through sysfs. This function is
+   called by the reactor of the capture thread only for the buttons whose
+   value file has a pending event.
+
+   Parameters:
+     * h: the reactor handler of the button (the button itself).
+     * events: the epoll events (not used).
+*/
+void
+button_sysfs_event(struct reactor_handler_t *h, uint32_t events)
+{
+    struct button_t *button = (struct button_t*)h;
+    enum gpio_value_t state;
+    struct pollfd pfd;
+
+    // The button was removed by a reload while its event was pending
+    if (button->handler.fd < 0) {
+        return;
+    }
+    // Check the state (low or high) of the button
+    state = rfs_gpio_get_value(&(button->gpio));
+    if (state < 0) {
+        warn("cannot obtain GPIO state");
+        reactor_stop(&capture, 1);
+        return;
+    }
+    capture_edge(button, state == RFS_GPIO_HIGH, clock_now());
+    capture_notify();
+    // Get again the poll descriptor, this clears the event in the value file
+    if (rfs_gpio_get_poll_descriptors(&(button->gpio), &pfd)) {
+        warn("error getting descriptor from GPIO %d", button->gpio.pin);
+        reactor_stop(&capture, 1);
+        return;
+    }
+    // If the descriptor has changed, watch the new one (the old one is
+    // removed from the epoll set when it is closed)
+    if (pfd.fd != button->handler.fd) {
+        button->handler.fd = pfd.fd;
+        fcntl(pfd.fd, F_SETFD, FD_CLOEXEC);
+        if (reactor_add(&capture, &(button->handler), EPOLLPRI)) {
+            warn("cannot watch GPIO %d", button->gpio.pin);
+            reactor_stop(&capture, 1);
+        }
+    }
+}
+
+/* Process the edges of a button read through the GPIO character device. The
+   kernel queues the edges with their direction and timestamp, so they are
+   all read here, in batches, without reading the value of the line. Called
+   by the reactor of the capture thread.
+
+   Parameters:
+     * h: the reactor handler of the button (the button itself).
+     * events: the epoll events (not used).
+*/
+void
+button_cdev_event(struct reactor_handler_t *h, uint32_t events)
 {
-    struct sigaction sa;
-    sigset_t mask;
+    struct button_t *button = (struct button_t*)h;
+    struct gpio_v2_line_event edges[EDGE_BATCH];
+    ssize_t n;
 
-    sigemptyset(&mask);
-    sa.sa_handler = signal_handler;
-    sa.sa_mask = mask;
-    sa.sa_flags = 0;
-    sigaction(SIGINT, &sa, NULL);
-    sigaction(SIGTERM, &sa, NULL);
+    // The button was removed by a reload while its event was pending
+    if (button->handler.fd < 0) {
+        return;
+    }
+    do {
+        n = gpiocdev_read_events(button->handler.fd, edges, EDGE_BATCH);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                warn("cannot read events of GPIO %d", button->gpio.pin);
+                reactor_stop(&capture, 1);
+            }
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            capture_edge(button,
+                edges[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE,
+                edges[i].timestamp_ns);
+        }
+    } while (n == EDGE_BATCH);
+    // A single wake up for the whole batch
+    capture_notify();
+}
+
+/* Process the edges pushed to the ring by the capture thread. Called by the
+   main reactor when the capture thread notifies it.
+
+   Parameters:
+     * h: the handler of the eventfd (not used).
+     * events: the epoll events (not used).
+*/
+void
+ring_ready(struct reactor_handler_t *h, uint32_t events)
+{
+    struct ring_edge_t e;
+    uint64_t count;
+
+    // Reset the eventfd before emptying the ring, so no edge is left behind
+    if (read(ring_handler.fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        warn("cannot read from the capture thread");
+        reactor_stop(&reactor, 1);
+        return;
+    }
+    while (!ring_pop(&ring, &e)) {
+        if (recording && trace_write(&trace, e.pin, e.level, e.timestamp)) {
+            warn("cannot record in '%s'", record_path);
+            recording = 0;
+        }
+        button_input((struct button_t*)e.source, e.level, e.timestamp);
+    }
+    if (atomic_load(&capture_failed)) {
+        reactor_stop(&reactor, 1);
+    }
+}
+
+/* Stop the capture thread, called by its reactor when the main thread
+   writes the eventfd capture_stop.
+
+   Parameters:
+     * h: the handler of the eventfd (not used).
+     * events: the epoll events (not used).
+*/
+void
+capture_stopped(struct reactor_handler_t *h, uint32_t events)
+{
+    reactor_stop(&capture, 0);
+}
+
+/* Pause the capture thread, called by its reactor when the main thread
+   writes the eventfd capture_pause. The thread waits until the main thread
+   has changed the buttons.
+
+   Parameters:
+     * h: the handler of the eventfd (not used).
+     * events: the epoll events (not used).
+*/
+void
+capture_paused(struct reactor_handler_t *h, uint32_t events)
+{
+    uint64_t count;
+
+    if (read(capture_pause.fd, &count, sizeof(count)) < 0) {
+        return;
+    }
+    // Tell the main thread that the capture is paused, and wait for it to
+    // resume the capture
+    pthread_barrier_wait(&capture_barrier);
+    pthread_barrier_wait(&capture_barrier);
+}
+
+/* Main function of the capture thread: it waits for the edges of the
+   buttons, timestamps them and pushes them to the ring, so the main thread
+   can be busy without delaying the timestamps.
+
+   Parameters:
+     * arg: not used.
+*/
+void*
+capture_main(void *arg)
+{
+    if (reactor_run(&capture)) {
+        // Wake up the main thread to stop it too
+        atomic_store(&capture_failed, 1);
+        capture_notify();
+    }
+    return NULL;
+}
+
+/* Start the capture thread, after the buttons are watched.
+
+   Return 0 if the thread was started, 1 otherwise.
+*/
+int
+start_capture()
+{
+    ring_handler.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    capture_stop.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    capture_pause.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ring_handler.fd < 0 || capture_stop.fd < 0 || capture_pause.fd < 0) {
+        warn("cannot create eventfd");
+        return 1;
+    }
+    ring_handler.callback = ring_ready;
+    capture_stop.callback = capture_stopped;
+    capture_pause.callback = capture_paused;
+    if (reactor_add(&reactor, &ring_handler, EPOLLIN)
+        || reactor_add(&capture, &capture_stop, EPOLLIN)
+        || reactor_add(&capture, &capture_pause, EPOLLIN))
+    {
+        warn("cannot watch eventfd");
+        return 1;
+    }
+    errno = pthread_barrier_init(&capture_barrier, NULL, 2);
+    if (errno) {
+        warn("cannot create the barrier of the capture thread");
+        return 1;
+    }
+    // The signals are blocked in the main thread, so they are blocked in the
+    // capture thread too and only received through the main reactor
+    errno = pthread_create(&capture_thread, NULL, capture_main, NULL);
+    if (errno) {
+        warn("cannot create the capture thread");
+        return 1;
+    }
+    capture_running = 1;
+    return 0;
+}
+
+/* Prefault a region of the stack, so the stack doesn't grow with page faults
+   once the memory is locked.
+*/
+void
+prefault_stack()
+{
+    volatile char stack[PREFAULT_STACK];
+
+    for (size_t i = 0; i < PREFAULT_STACK; i += 4096) {
+        stack[i] = 0;
+    }
+    // Read it back, or the compiler may drop the writes
+    (void)stack[0];
+}
+
+/* Apply the real-time settings asked in the command line to the process,
+   before the capture thread is started, so it inherits them. The settings
+   that cannot be applied are reported, but they don't stop the daemon: the
+   buttons still work, only with more latency.
+*/
+void
+set_realtime()
+{
+    struct sched_param param;
+    cpu_set_t cpus;
+
+    if (lock_memory) {
+        // Don't give back the memory freed to the system, or it would be
+        // faulted again when allocated
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+        // MCL_FUTURE also locks the stack of the capture thread
+        if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+            warn("cannot lock the memory");
+        } else {
+            prefault_stack();
+        }
+    }
+    if (rt_priority) {
+        // The main thread classifies the edges and launches the actions, so
+        // it runs under SCHED_FIFO too
+        param.sched_priority = rt_priority;
+        if (sched_setscheduler(0, SCHED_FIFO, &param)) {
+            warn("cannot set the real-time priority %u", rt_priority);
+        }
+    }
+    if (cpu >= 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+            warn("cannot pin the process to the CPU %d", cpu);
+        }
+    }
+}
+
+/* Stop the capture thread and wait for it to finish. */
+void
+stop_capture()
+{
+    uint64_t one = 1;
+
+    if (capture_running) {
+        if (write(capture_stop.fd, &one, sizeof(one)) < 0) {
+            warn("cannot stop the capture thread");
+        } else {
+            pthread_join(capture_thread, NULL);
+        }
+        capture_running = 0;
+        pthread_barrier_destroy(&capture_barrier);
+    }
+    if (ring_handler.fd >= 0) {
+        close(ring_handler.fd);
+    }
+    if (capture_stop.fd >= 0) {
+        close(capture_stop.fd);
+    }
+    if (capture_pause.fd >= 0) {
+        close(capture_pause.fd);
+    }
+}
+
+/* Pause the capture thread, so the main thread can change the buttons that
+   it watches. The function returns when the capture thread is waiting.
+
+   Return 0 if the capture thread is paused, 1 otherwise.
+*/
+int
+pause_capture()
+{
+    uint64_t one = 1;
+
+    // A thread that stopped would never meet the main thread at the barrier
+    if (!capture_running || atomic_load(&capture_failed)) {
+        return 1;
+    }
+    if (write(capture_pause.fd, &one, sizeof(one)) < 0) {
+        warn("cannot pause the capture thread");
+        return 1;
+    }
+    pthread_barrier_wait(&capture_barrier);
+    return 0;
+}
+
+/* Resume the capture thread paused by pause_capture. */
+void
+resume_capture()
+{
+    pthread_barrier_wait(&capture_barrier);
+}
+
+/* Start watching a button through sysfs. That means setting the edge that it
+   listens (both raising and falling edges, so pressing and releasing the
+   button) and adding its descriptor to the reactor.
+
+   Parameters:
+     * b: the button.
+
+   Return 0 if the button is being watched, 1 in case of error.
+*/
+int
+watch_button_sysfs(struct button_t *b)
+{
+    struct pollfd pfd;
+
+    // Export the GPIO as an input
+    if (rfs_gpio_open(&(b->gpio), RFS_GPIO_IN)) {
+        warn("cannot open GPIO #%d", b->gpio.pin);
+        return 1;
+    }
+    b->opened = 1;
+    // sysfs cannot debounce the line, it's done here
+    b->soft_debounce = b->debounce != 0;
+    // First, configure the edge to listen of the button's GPIO
+    // listen both, raising and falling
+    if (rfs_gpio_set_edge(&(b->gpio), RFS_GPIO_BOTH)) {
+        warn("error setting edge in GPIO %d", b->gpio.pin);
+        return 1;
+    }
+    // Then get the poll descriptor
+    if (rfs_gpio_get_poll_descriptors(&(b->gpio), &pfd)) {
+        warn("error getting descriptor from GPIO %d", b->gpio.pin);
+        return 1;
+    }
+    // The descriptor must not be inherited by the actions
+    fcntl(pfd.fd, F_SETFD, FD_CLOEXEC);
+    // Add the button to the reactor. The reactor keeps a pointer to the
+    // button, so no lookup is needed when its descriptor is ready.
+    b->handler.fd = pfd.fd;
+    b->handler.callback = button_sysfs_event;
+    if (reactor_add(&capture, &(b->handler), EPOLLPRI)) {
+        warn("cannot watch GPIO %d", b->gpio.pin);
+        return 1;
+    }
+    return 0;
+}
+
+/* Start watching a button through the GPIO character device. The line is
+   requested as an input that reports both edges, debounced by the kernel if
+   the button has a debounce period, and added to the reactor.
+
+   Parameters:
+     * b: the button.
+
+   Return 0 if the button is being watched, 1 in case of error.
+*/
+int
+watch_button_cdev(struct button_t *b)
+{
+    int debounced;
+
+    b->handler.fd = gpiocdev_request_input(chip_fd, b->gpio.pin, PROGNAME,
+        b->debounce * 1000, &debounced);
+    if (b->handler.fd < 0) {
+        warn("cannot request line %d of '%s'", b->gpio.pin, gpiochip);
+        return 1;
+    }
+    // If the kernel cannot debounce the line, it's done here
+    b->soft_debounce = b->debounce && !debounced;
+    b->handler.callback = button_cdev_event;
+    if (reactor_add(&capture, &(b->handler), EPOLLIN)) {
+        warn("cannot watch GPIO %d", b->gpio.pin);
+        return 1;
+    }
+    return 0;
 }
 
-/* Initialize some data structures that the application must use
+/* Start watching a simulated button: a FIFO named as the pin in the
+   directory of the simulation, where a load generator writes the edges with
+   the format of the GPIO character device (struct gpio_v2_line_event). The
+   edges follow the same path than the edges of a real line.
 
-   Return 0 if the initialization was correct, 1 otherwise.
+   Parameters:
+     * b: the button.
+
+   Return 0 if the button is being watched, 1 in case of error.
 */
 int
-init_data_structures()
+watch_button_sim(struct button_t *b)
 {
-    // Initialize the buttons dictionary
-    if (dictint_init(&dict_buttons)) {
-        warn("error creating buttons dictionary");
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%d", sim_dir, b->gpio.pin);
+    // Opened for writing too, so the FIFO never hangs up when the generator
+    // closes it
+    b->handler.fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (b->handler.fd < 0) {
+        warn("cannot open '%s'", path);
         return 1;
     }
-    // Initialize the file descriptor's dictionary
-    if (dictint_init(&dict_fds)) {
-        warn("error creating descriptors dictionary");
+    b->soft_debounce = b->debounce != 0;
+    b->handler.callback = button_cdev_event;
+    if (reactor_add(&capture, &(b->handler), EPOLLIN)) {
+        warn("cannot watch GPIO %d", b->gpio.pin);
         return 1;
     }
     return 0;
 }
 
-/* Return a button given the GPIO pin number where it is connected.
+/* Prepare the timers and the gesture recognizer of a button, once the
+   configuration is read.
 
    Parameters:
-     * gpio: the GPIO pin number where the button is.
+     * b: the button.
 */
-struct button_t*
-get_button_by_pin(gpio_pin_t gpio)
+void
+prepare_button(struct button_t *b)
 {
-    return dictint_get(&dict_buttons, gpio);
+    timerwheel_timer_init(&(b->timer), button_timer);
+    gesture_compile(&(b->gesture), b->types);
+    timerwheel_timer_init(&(b->settle), button_settled);
 }
 
-/* Return a button given the file descriptor of its opened value file.
-   The button's (GPIO) value file is opened when it is being polled.
+/* Start watching a button, through sysfs, through the GPIO character device
+   or through the FIFO of a simulation.
 
    Parameters:
-     * fd: the file descriptor used to poll that button's GPIO.
+     * b: the button.
+
+   Return 0 if the button is being watched, 1 in case of error.
 */
-struct button_t*
-get_button_by_fd(int fd)
+int
+watch_button(struct button_t *b)
 {
-    return dictint_get(&dict_fds, fd);
+    if (sim_dir) {
+        return watch_button_sim(b);
+    }
+    return gpiochip ? watch_button_cdev(b) : watch_button_sysfs(b);
 }
 
-/* Add a new button to the dictionary dict_buttons. Then, return the new
-   button.
+/* Close (unexport or release) the GPIO of a button. Its descriptor is
+   removed from the reactor of the capture thread when it is closed.
 
    Parameters:
-     * gpio: the GPIO pin number where the button is connected.
+     * b: the button.
+*/
+void
+close_button(struct button_t *b)
+{
+    if (b->opened) {
+        rfs_gpio_close(&(b->gpio));
+        b->opened = 0;
+    } else if (b->handler.fd >= 0) {
+        // Releasing the line request closes the line
+        close(b->handler.fd);
+    }
+    b->handler.fd = -1;
+}
 
-   Return the button created, or NULL if error.
+/* Set all the buttons in a listening state, through sysfs, through the GPIO
+   character device or through the FIFOs of a simulation. The buttons are
+   watched by the reactor of the capture thread. The timers of all the
+   buttons are kept in a timing wheel driven by a single timerfd of the main
+   reactor.
+
+   Return 0 if all the buttons are being watched, 1 in case of error.
 */
-struct button_t*
-add_button(gpio_pin_t gpio)
+int
+watch_buttons()
 {
-    struct button_t *g;
+    int gpio;
+    struct button_t *b;
+    struct dictint_iterator_t i;
 
-    if (!(g = (struct button_t*)malloc(sizeof(struct button_t)))) {
-        return NULL;
+    // The capture thread doesn't receive any signal
+    if (reactor_init(&capture, NULL, NULL)) {
+        warn("cannot create the reactor of the capture thread");
+        return 1;
     }
-
-    // Initialize the instance g
-    g->gpio.pin = gpio;
-    g->gpio.flags = 0;
-    if (rfs_gpio_open(&(g->gpio), RFS_GPIO_IN)) {
-        warn("cannot open GPIO #%d", gpio);
-        return NULL;
+    if (ring_init(&ring, ring_size_arg)) {
+        warn("cannot create the ring of edges");
+        return 1;
     }
-    // Add the element to the dictionary
-    if (dictint_add(&dict_buttons, gpio, g)) {
-        warn("adding new button to dictionary");
-        rfs_gpio_close(&(g->gpio));
-        return NULL;
+    timerwheel_init(&wheel, NS_PER_MS, clock_now());
+    if (reactor_timer_init(&reactor, &wheel_timer, wheel_expired)) {
+        warn("cannot create the timer");
+        return 1;
     }
-    // Initialize the list of events
-    if (list_init(&(g->events))) {
-        warn("error initializing list of events");
-        return NULL;
+    // The chip is opened here because daemonize closes all the descriptors
+    if (gpiochip) {
+        chip_fd = gpiocdev_open_chip(gpiochip);
+        if (chip_fd < 0) {
+            warn("cannot open '%s'", gpiochip);
+            return 1;
+        }
     }
-    return g;
+    dictint_iterator_begin(&dict_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void **)&b)) {
+        if (watch_button(b)) {
+            return 1;
+        }
+        prepare_button(b);
+    }
+    // Record the edges, if demanded
+    if (record_path) {
+        if (trace_create(&trace, record_path)) {
+            warn("cannot create '%s'", record_path);
+            return 1;
+        }
+        recording = 1;
+    }
+    return 0;
 }
 
-/* Add an event/action couple to a given GPIO button.
-
-   Parameters:
-     * button: the button where the event must be added.
-     * event: the event to add.
+/* Replay a trace of edges: feed its edges to the buttons as fast as
+   possible, with the timers of the buttons driven by the time of the trace,
+   and print the events recognized to the standard output. The actions are
+   not executed. The statistics of the replay are printed to the standard
+   error.
 
-   Return 0 if the event was correctly added to the button, 1 otherwise.
+   Return 0 if the trace was replayed, 1 in case of error.
 */
 int
-add_event(struct button_t *button, struct event_t *event)
+replay_trace()
 {
-    if (list_add(&(button->events), event)) {
-        warn("adding event");
+    struct dictint_iterator_t i;
+    int gpio, level, e;
+    struct button_t *b;
+    uint64_t timestamp, flush = 0, start, elapsed;
+    unsigned long edges = 0, unknown = 0;
+    uint32_t pin;
+
+    if (trace_open(&trace, replay_path)) {
+        warn("cannot open the trace '%s'", replay_path);
+        return 1;
+    }
+    dictint_iterator_begin(&dict_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void **)&b)) {
+        // The edges are recorded before the debounce
+        b->soft_debounce = b->debounce != 0;
+        prepare_button(b);
+        // Time needed to finish the pending clicks and debounces at the end
+        if (b->multi_click_time > flush) {
+            flush = b->multi_click_time;
+        }
+        if (b->debounce * NS_PER_MS > flush) {
+            flush = b->debounce * NS_PER_MS;
+        }
+    }
+    start = clock_now();
+    while (!(e = trace_read(&trace, &pin, &level, &timestamp))) {
+        if (!edges++) {
+            timerwheel_init(&wheel, NS_PER_MS, timestamp);
+        }
+        b = get_button_by_pin(pin);
+        if (!b) {
+            unknown++;
+            continue;
+        }
+        // Fire the timers that expire before the edge
+        timerwheel_advance(&wheel, timestamp);
+        button_input(b, level, timestamp);
+    }
+    // Finish the pending clicks, but a button still held is not held long
+    // enough to fire more events
+    if (edges) {
+        timerwheel_advance(&wheel, trace.last + flush + NS_PER_MS);
+    }
+    elapsed = clock_now() - start;
+    trace_close(&trace);
+    if (e < 0) {
+        warn("cannot read the trace '%s'", replay_path);
         return 1;
     }
+    fflush(stdout);
+    fprintf(stderr, PROGNAME ": replayed %lu edges (%lu of unknown pins) in"
+        " %.3f ms, %.0f edges/s\n", edges, unknown, elapsed / 1e6,
+        elapsed ? edges * 1e9 / elapsed : 0);
     return 0;
 }
 
-/* Parse a single line that contains the information about an event/action for
-   a button:
+/* Remove a button that is not in the configuration anymore, after a reload:
+   stop watching it, close its GPIO and release its actions. The button is
+   freed with the arena of its configuration, at the next reload, because the
+   capture thread may still have an event of it.
 
-   <gpio_pin_number>_<event>=<action>
+   Parameters:
+     * b: the button.
+*/
+void
+remove_button(struct button_t *b)
+{
+    if (b->handler.fd >= 0) {
+        reactor_del(&capture, &(b->handler));
+    }
+    close_button(b);
+    timerwheel_cancel(&wheel, &(b->timer));
+    timerwheel_cancel(&wheel, &(b->settle));
+    free_events(b->events);
+}
 
-   Where:
-     * gpio_pin_number: the GPIO pin number where the button is connected.
-     * event: click or long_click.
-     * action: command to execute with the 'system' syscall.
+/* Change the debounce period of a button that is being watched. The line of
+   the GPIO character device is configured again, without requesting it. An
+   edge that waits to settle is taken at the next tick if the new period
+   doesn't need it.
 
    Parameters:
-     * line: line in the configuration file that contains the pin/event and
-         the action (contains a string ended by a null character).
-     * linenum: line number in the file (for error reporting purposes).
-     * gpio_pin: output number of the GPIO pin for that event/action.
-
-   Return the parsed event in case of success, NULL otherwise.
+     * b: the button.
+     * debounce: the new debounce period (ms).
 */
-struct event_t*
-parse_button_action(char *line, int linenum, gpio_pin_t *gpio_pin)
+void
+update_debounce(struct button_t *b, unsigned int debounce)
 {
-    char *ptr, *eptr;
-    struct event_t *event;
-    unsigned int pin;
+    int debounced = 0;
 
-    // Allocate the event
-    event = (struct event_t*)malloc(sizeof(struct event_t));
-    if (!event) {
-        warnx("allocating event");
-        return NULL;
-    }
-    // Parse the event/action
-    // Search the '=' sign
-    ptr = line;
-    while (*ptr != '=' && *ptr != '\0') ptr++;
-    if (*ptr == '\0') {
-        warnx("%s: at line %d: expected '='", config, linenum);
-        return NULL;
-    }
-    // Parse the pin number
-    // A new pin variable is used to recover the pin number because we are not
-    // sure if gpio_pin_t and unsigned int have the same size.
-    if (parse_number(line, (const char **)&eptr, &pin)) {
-        warnx("%s: at line %d: GPIO pin out of range", config, linenum);
-        return NULL;
-    }
-    *gpio_pin = pin;
-    // Parse the event
-    *ptr = '\0';
-    if (strcmp(eptr, "_click") == 0) {
-        // Simple click event
-        event->type = EVENT_CLICK;
-    } else if (strcmp(eptr, "_long_click") == 0) {
-        // Long click event
-        event->type = EVENT_LONG_CLICK;
-    } else {
-        warnx("%s: at line %d: unknown event", config, linenum);
-        return NULL;
+    b->debounce = debounce;
+    if (gpiochip && !sim_dir && b->handler.fd >= 0
+        && gpiocdev_set_debounce(b->handler.fd, debounce * 1000, &debounced))
+    {
+        warn("cannot change the debounce of line %d", b->gpio.pin);
     }
-    event->action = strdup(ptr + 1);
-    if (!event->action) {
-        warn("error in strdup");
-        return NULL;
+    b->soft_debounce = debounce && !debounced;
+    if (!b->soft_debounce && timerwheel_armed(&(b->settle))) {
+        timerwheel_arm(&wheel, &(b->settle), b->raw_timestamp);
     }
-    return event;
 }
 
-/* Read the configuration file.
-   The configuration file has variables that describe the actions to take
-   upon click on any of the buttons.
-   Empty lines and lines that start by '#' are ignored.
-   The rest of the lines must be of the form:
+/* Give the action and the counters of an event of the configuration in use
+   to the same event read by a reload, that replaces it. The action is not
+   sent again to the spawner.
 
-   <number>_<click_type>=<action>
+   Parameters:
+     * e: the event read by the reload.
+     * old: the event in use, whose action is freed.
+*/
+void
+adopt_event(struct event_t *e, struct event_t *old)
+{
+    struct action_t action = e->action;
 
-   Where:
-     * number: is the GPIO pin where the button is connected.
-     * click_type: must be 'click' or 'long_click'. Identifies the type of
-         click to be performed to the button. A click is executed immediately
-         when the user releases the button. For a long click to take effect
-         the user must hold the button at least 2 seconds.
-     * action: action to be executed. It must be a command line that will be
-         executed with the 'system' syscall.
+    *e = *old;
+    e->action = action;
+    spawner_set_data(&spawner, e->id, e);
+    action_free(&(old->action));
+}
+
+/* Give the state of a button being watched to the same button read by a
+   reload, that replaces it: its GPIO, whether it's pressed, the timestamp of
+   the press, the series of clicks in progress, its timers and its counters.
+   The events with the same type and action keep their actions and counters,
+   the rest are released. The old button is left without GPIO, so the
+   capture thread ignores an event of it still pending.
 
-   Return 0 if the configuration file was correctly read, 1 otherwise.
+   Parameters:
+     * n: the button read by the reload, already prepared.
+     * b: the button being watched.
+
+   Return 0 if the button was replaced, 1 otherwise.
 */
 int
-read_configuration_file()
+adopt_button(struct button_t *n, struct button_t *b)
 {
-    FILE *f;
-    struct line_t l = LINE_INIT;
-    int linenum = 1;
-    gpio_pin_t gpio_pin;
-    struct button_t *button;
-    struct event_t *event;
-    int r;
-
-    // Open the configuration file
-    f = fopen(config, "r");
-    if (!f) {
-        warn("cannot open '%s'", config);
-        return 1;
+    struct event_t *e, *old;
+    unsigned int debounce = n->debounce;
+    int r = 0;
+
+    n->handler = b->handler;
+    n->gpio = b->gpio;
+    n->opened = b->opened;
+    n->timestamp = b->timestamp;
+    n->debounce = b->debounce;
+    n->soft_debounce = b->soft_debounce;
+    n->raw = b->raw;
+    n->raw_timestamp = b->raw_timestamp;
+    n->pressed = b->pressed;
+    n->edges = b->edges;
+    n->filtered = b->filtered;
+    memcpy(n->recognized, b->recognized, sizeof(n->recognized));
+    n->timer_input = b->timer_input;
+    n->gesture.state = b->gesture.state;
+    gesture_recompile(&(n->gesture), n->types);
+    // The timers are moved to the new button
+    if (timerwheel_armed(&(b->timer))) {
+        timerwheel_arm(&wheel, &(n->timer), b->timer.deadline);
+        timerwheel_cancel(&wheel, &(b->timer));
     }
-    // Iterate over the lines of the configuration file to load the actions
-    while ((r = readline(&l, f)) > 0) {
-        // Jump blank lines and comment lines
-        if (l.line[0] != '\n' && l.line[0] != '#') {
-            event = parse_button_action(l.line, linenum, &gpio_pin);
-            if (!event) {
-                // Error parsing the line with the button/event/action
-                return 1;
-            } else {
-                // Add the button GPIO/event info
-                // Check if the button is already in the dictionary
-                button = get_button_by_pin(gpio_pin);
-                if (!button) {
-                    // The button is not in the dictionary, create it
-                    button = add_button(gpio_pin);
-                }
-                if (button) {
-                    // The button was in the dictionary or was correctly added
-                    // Add the event
-                    if (add_event(button, event)) {
-                        // Error adding event
-                        return 1;
-                    }
-                } else {
-                    // Error adding the button
-                    return 1;
+    if (timerwheel_armed(&(b->settle))) {
+        timerwheel_arm(&wheel, &(n->settle), b->settle.deadline);
+        timerwheel_cancel(&wheel, &(b->settle));
+    }
+    // The capture thread receives the new button from now on
+    if (n->handler.fd >= 0 && reactor_mod(&capture, &(n->handler),
+        n->opened ? EPOLLPRI : EPOLLIN))
+    {
+        warn("cannot watch GPIO %d", n->gpio.pin);
+        r = 1;
+    }
+    b->handler.fd = -1;
+    b->opened = 0;
+    if (debounce != n->debounce) {
+        update_debounce(n, debounce);
+    }
+    // Reuse the old events that didn't change, only the ones of the same
+    // type are compared
+    for (int t = 0; t < EVENT_TYPES; t++) {
+        for (size_t k = 0; k < n->events[t].size; k++) {
+            e = (struct event_t*)n->events[t].elems[k];
+            for (size_t l = 0; l < b->events[t].size; l++) {
+                old = (struct event_t*)b->events[t].elems[l];
+                if (old && same_event(old, e)) {
+                    adopt_event(e, old);
+                    b->events[t].elems[l] = NULL;
+                    break;
                 }
             }
         }
-        linenum++;
     }
-    fclose(f);
-    if (r < 0) {
-        warn("error reading configuration file");
-        return 1;
+    free_events(b->events);
+    return r;
+}
+
+/* Return 1 if two chords have the same buttons, in the same order, and the
+   same action, 0 otherwise.
+
+   Parameters:
+     * a: a chord.
+     * b: the other chord.
+*/
+int
+same_chord(const struct chord_t *a, const struct chord_t *b)
+{
+    if (a->nbuttons != b->nbuttons || !same_event(a->event, b->event)) {
+        return 0;
     }
-    readline_free(&l);
-    return 0;
+    for (unsigned int k = 0; k < a->nbuttons; k++) {
+        if (a->buttons[k]->gpio.pin != b->buttons[k]->gpio.pin) {
+            return 0;
+        }
+    }
+    return 1;
 }
 
-/* Set all the buttons in a listening state. That means setting the edge
-   that they listen (listen for both raising and falling edges, so pressing
-   and releasing the buttons) and obtaining the fd for polling.
+/* Give the chords read by a reload the state of the chords in use. The
+   chords that didn't change keep their actions and counters, the actions of
+   the rest are released. The buttons of a chord that are already pressed
+   count, but the chord is not fired until one of them is pressed again.
+
+   Parameters:
+     * old: the list of the chords in use.
+*/
+void
+update_chords(struct list_t *old)
+{
+    struct list_iterator_t i, j;
+    struct chord_t *c, *o;
+
+    list_iterator_begin(&chords, &i);
+    while (list_iterator_next(&i, (void **)&c)) {
+        c->pressed = 0;
+        for (unsigned int k = 0; k < c->nbuttons; k++) {
+            c->pressed += c->buttons[k]->pressed;
+        }
+        list_iterator_begin(old, &j);
+        while (list_iterator_next(&j, (void **)&o)) {
+            if (o->event && same_chord(o, c)) {
+                adopt_event(c->event, o->event);
+                c->recognized = o->recognized;
+                o->event = NULL;
+                break;
+            }
+        }
+    }
+    list_iterator_begin(old, &j);
+    while (list_iterator_next(&j, (void **)&o)) {
+        if (o->event) {
+            free_event(o->event);
+        }
+    }
+}
 
-   Return 0 if all the descriptors are get, 1 in case of error.
-*/ 
+/* Reload the configuration file, changing only what changed. The new
+   configuration is read apart, in the next arena, so if it has errors the
+   old one is kept. Then the capture thread is paused and the new
+   configuration is compared with the one in use: only the GPIOs of the
+   buttons added are opened and only the ones of the buttons removed are
+   closed, and only the actions that changed are sent to the spawner. The
+   buttons kept give their state to the new ones, so a press in progress
+   keeps its timestamp. The configuration file is still parsed completely,
+   but the system calls and the messages to the spawner depend only on the
+   size of the change.
+
+   Return 0 if the configuration was reloaded, 1 in case of error.
+*/
 int
-get_poll_descriptors()
+reload_configuration()
 {
-    int gpio;
-    struct button_t *b;
+    struct dictint_t old_buttons = dict_buttons;
+    struct list_t old_chords = chords;
+    struct arena_t *old_arena = config_arena;
+    unsigned int index = old_arena - config_arenas;
     struct dictint_iterator_t i;
-    int nfd = 0;
-
-    // Allocate the descriptors array
-    npoll_descriptors = dictint_size(&dict_buttons);
-    poll_descriptors = (struct pollfd*)malloc(
-        sizeof(struct pollfd) * npoll_descriptors);
-    if (!poll_descriptors) {
-        warn("error alloc");
+    struct button_t *b, *n;
+    unsigned int added = 0, removed = 0;
+    uint64_t start = clock_now();
+    int gpio, e = 0;
+
+    // Read the new configuration apart from the one in use. The next arena
+    // was freed by the previous reload.
+    config_arena = &(config_arenas[(index + 1) % CONFIG_ARENAS]);
+    if (read_configuration_file()) {
+        e = 1;
+    } else if (pause_capture()) {
+        free_configuration();
+        e = 1;
+    }
+    if (e) {
+        dict_buttons = old_buttons;
+        chords = old_chords;
+        config_arena = old_arena;
+        report("%s: not reloaded, the configuration in use is kept", config);
         return 1;
     }
-    // Fill the array of poll descriptors
+    // The edges already captured belong to the old configuration
+    ring_ready(&ring_handler, 0);
+    // The capture thread cannot use the configuration replaced by the
+    // previous reload anymore
+    arena_free(&(config_arenas[(index + 2) % CONFIG_ARENAS]));
+    // Watch the buttons added, and give the state of the buttons kept to
+    // the new ones
     dictint_iterator_begin(&dict_buttons, &i);
-    while (dictint_iterator_next(&i, &gpio, (void **)&b)) {
-        // First, configure the edge to listen of the button's GPIO
-        // listen both, raising and falling
-        if (rfs_gpio_set_edge(&(b->gpio), RFS_GPIO_BOTH)) {
-            warn("error setting edge in GPIO %d", b->gpio.pin);
-            return 1;
-        }
-        // Then get the poll descriptors
-        if (rfs_gpio_get_poll_descriptors(
-            &(b->gpio), &(poll_descriptors[nfd])))
-        {
-            warn("error getting descriptor from GPIO %d", b->gpio.pin);
-            return 1;
+    while (dictint_iterator_next(&i, &gpio, (void **)&n)) {
+        prepare_button(n);
+        b = dictint_get(&old_buttons, gpio);
+        if (b) {
+            if (adopt_button(n, b)) {
+                e = 1;
+            }
+        } else {
+            // A button that cannot be watched stays in the configuration,
+            // but it never has edges
+            if (watch_button(n)) {
+                e = 1;
+            }
+            added++;
         }
-        // Add the button to the dictionary indexed by fd
-        if (dictint_add(&dict_fds, b->gpio.fd, b)) {
-            warn("adding new button to dictionary by fd");
-            return 1;
+    }
+    update_chords(&old_chords);
+    // The buttons that are not in the new configuration are removed
+    dictint_iterator_begin(&old_buttons, &i);
+    while (dictint_iterator_next(&i, &gpio, (void **)&b)) {
+        if (!dictint_get(&dict_buttons, gpio)) {
+            remove_button(b);
+            removed++;
         }
-        nfd++;
     }
-    return 0;
+    if (define_events()) {
+        e = 1;
+    }
+    update_wheel_timer();
+    resume_capture();
+    report("%s: reloaded in %.3f ms, %u buttons added, %u removed", config,
+        (clock_now() - start) / 1e6, added, removed);
+    return e;
 }
 
-/* Execute the actions described by a type of event and a button.
+/* Process the changes in the directory of the configuration file, and reload
+   it when it's written or replaced. Called by the main reactor.
 
    Parameters:
-     * button: the button clicked.
-     * event: the type of event.
+     * h: the handler of the inotify descriptor (not used).
+     * events: the epoll events (not used).
 */
 void
-execute_actions(struct button_t *button, enum event_type_t event)
+config_changed(struct reactor_handler_t *h, uint32_t events)
 {
-    struct list_iterator_t i;
-    struct event_t *e;
-    pid_t pid;
-
-    list_iterator_begin(&(button->events), &i);
-    while (list_iterator_next(&i, (void **)&e)) {
-        if (e->type == event) {
-            pid = fork();
-            if (pid < 0) {
-                warn("cannot fork");
-            } else if (pid == 0) {
-                exit(WEXITSTATUS(system(e->action)));
+    char buf[sizeof(struct inotify_event) + NAME_MAX + 1]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    ssize_t len;
+    int changed = 0;
+
+    while ((len = read(config_watch.fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+            ev = (const struct inotify_event*)p;
+            if (ev->len && strcmp(ev->name, config_name) == 0) {
+                changed = 1;
             }
         }
     }
+    // Several changes read at once need a single reload
+    if (changed) {
+        reload_configuration();
+    }
+}
+
+/* Watch the directory of the configuration file, to reload it when it's
+   written or replaced (as the editors and the package managers do). The
+   directory is watched because the file may be replaced by a new one.
+
+   Return 0 if the configuration file is watched, 1 otherwise.
+*/
+int
+watch_configuration()
+{
+    char *dir;
+
+    if (!watch_config) {
+        return 0;
+    }
+    config_watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (config_watch.fd < 0) {
+        warn("cannot create the inotify descriptor");
+        return 1;
+    }
+    dir = strdup(config);
+    if (!dir) {
+        warn("cannot watch '%s'", config);
+        return 1;
+    }
+    if (inotify_add_watch(config_watch.fd, dirname(dir),
+        IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        warn("cannot watch '%s'", config);
+        free(dir);
+        return 1;
+    }
+    free(dir);
+    // The path is relative to the current directory if realpath failed
+    config_name = strrchr(config, '/');
+    config_name = config_name ? config_name + 1 : config;
+    config_watch.callback = config_changed;
+    if (reactor_add(&reactor, &config_watch, EPOLLIN)) {
+        warn("cannot watch '%s'", config);
+        return 1;
+    }
+    return 0;
+}
+
+/* Process a signal received through the reactor.
+   SIGINT and SIGTERM stop the main loop, SIGUSR1 prints the counters of the
+   buttons and SIGHUP reloads the configuration file.
+
+   Parameters:
+     * signum: the signal received.
+*/
+void
+on_signal(int signum)
+{
+    switch (signum) {
+        case SIGINT:
+        case SIGTERM:
+            reactor_stop(&reactor, 0);
+            break;
+        case SIGUSR1:
+            report_buttons();
+            break;
+        case SIGHUP:
+            reload_configuration();
+            break;
+        default:
+            break;
+    }
 }
 
 /* Main loop that waits for events in the buttons and executes the attached
-   actions.
+   actions. The loop sleeps until the capture thread pushes edges, a timer
+   expires or a signal is received, there are no periodic wakeups.
 
    Return 0 if the loop is stoped without errors, 1 otherwise.
 */
 int
 run()
 {
-    struct button_t *button;
-    enum gpio_value_t state;
-    struct timespec current_ts;
-    double t0, t1;
-
-    while (!stop) {
-        // Block until any button changes its state
-        if (poll(poll_descriptors, npoll_descriptors, POLL_TIMEOUT) > 0) {
-            // Search among the poll descriptors which ones have input events
-            for (int i = 0; i < npoll_descriptors; i++) {
-                if (poll_descriptors[i].revents & POLLPRI) {
-                    // Obtain the button related to that fd
-                    button = get_button_by_fd(poll_descriptors[i].fd);
-                    // Check the state (low or high) of the button
-                    state = rfs_gpio_get_value(&(button->gpio));
-                    if (state < 0) {
-                        warn("cannot obtain GPIO state");
-                        return 1;
-                    }
-                    if (state == RFS_GPIO_HIGH) {
-                        // The button is pressed, timestamp the event
-                        clock_gettime(CLOCK_MONOTONIC, &(button->timestamp));
-                    } else {
-                        // The button was released, determine if it was a short
-                        // click or a long click and execute the action
-                        clock_gettime(CLOCK_MONOTONIC, &current_ts);
-                        t0 = TS_TO_DOUBLE(button->timestamp);
-                        t1 = TS_TO_DOUBLE(current_ts);
-                        if (t1 - t0 < TIME_LONG_CLICK) {
-                            // It was a short click
-                            execute_actions(button, EVENT_CLICK);
-                        } else {
-                            // It was a long click
-                            execute_actions(button, EVENT_LONG_CLICK);
-                        }
-                    }
-                    // Get again the poll descriptors
-                    if (rfs_gpio_get_poll_descriptors(
-                        &(button->gpio), &(poll_descriptors[i])))
-                    {
-                        warn("error getting descriptor from GPIO %d",
-                            button->gpio.pin);
-                        return 1;
-                    }
-                }
-            }
-        }
-        // Cleanup zombies
-        waitpid(-1, NULL, WNOHANG);
-    }
-    return 0;
+    return reactor_run(&reactor);
 }
 
-// Close (unexport) the GPIOs used by the buttons.
+// Close (unexport or release) the GPIOs used by the buttons.
 void
 close_gpios()
 {
@@ -618,8 +3062,14 @@ close_gpios()
 
     dictint_iterator_begin(&dict_buttons, &i);
     while (dictint_iterator_next(&i, &gpio, (void**)&b)) {
-        rfs_gpio_close(&(b->gpio));
+        close_button(b);
     }
+    if (chip_fd >= 0) {
+        close(chip_fd);
+    }
+    reactor_timer_close(&wheel_timer);
+    reactor_close(&capture);
+    ring_free(&ring);
 }
 
 /* Main entry point.
@@ -632,40 +3082,126 @@ int
 main(int argc, char **argv)
 {
     int e = 0;
+#ifdef ALLOCWATCH
+    unsigned long allocations;
+#endif
 
     // Parse the command line arguments
     parse_args(argc, argv);
-    // Set a handler for the signals SIGINT and SIGTERM to have a mechanism
-    // to stop this process.
-    set_signals();
+    // Block the signals SIGINT, SIGTERM, SIGUSR1 and SIGHUP, they are
+    // processed later by the reactor.
+    if (set_signals()) {
+        return 1;
+    }
+    // Start the helper process that launches the actions. It is started
+    // before the GPIOs are opened and the dictionaries are built, so it is a
+    // copy of a small process and the main loop never has to fork.
+    if (spawner_start(&spawner)) {
+        warn("cannot start the spawner");
+        return 1;
+    }
     // Init some global data structures
     if (init_data_structures()) {
-        return 1;
+        e = 1;
+        goto end;
     }
     // Read the configuration file that contains the actions to execute upon
     // the events on the buttons 
-    if (read_configuration_file()) {
+    if (read_configuration_file() || define_events()) {
         e = 1;
         goto end;
     }
+    // The daemon changes its directory, the configuration file is reloaded
+    // through its absolute path
+    config_absolute = realpath(config, NULL);
+    if (config_absolute) {
+        config = config_absolute;
+    }
+    // Replay a trace instead of watching the buttons, if demanded
+    if (replay_path) {
+        e = replay_trace();
+        goto end;
+    }
     // Daemonize, if demanded
     if (is_daemon) {
-        if (daemonize(pidfile)) {
+        if (daemonize(pidfile, spawner.handler.fd)) {
             return 1;
         }
+        // The reports go to the syslog
+        openlog(PROGNAME, LOG_PID, LOG_DAEMON);
+        if (spawner_detach(&spawner)) {
+            warn("cannot detach the spawner");
+            e = 1;
+            goto end;
+        }
+    }
+    // daemonize ignores SIGHUP, and an ignored signal is discarded even if
+    // it's blocked, so it wouldn't reach the reactor
+    signal(SIGHUP, SIG_DFL);
+    // Create the reactor. This is done after daemonizing because daemonize
+    // closes all the descriptors.
+    if (reactor_init(&reactor, &signals, on_signal)) {
+        warn("cannot create the reactor");
+        e = 1;
+        goto end;
+    }
+    // Receive the results of the actions from the spawner
+    if (spawner_watch(&spawner, &reactor, action_started, action_finished,
+        action_failed))
+    {
+        warn("cannot watch the spawner");
+        e = 1;
+        goto end;
+    }
+    // Serve the statistics and watch the configuration file, if demanded
+    if (open_stats_socket() || watch_configuration()) {
+        e = 1;
+        goto end;
     }
-    // Compile a list of poll descriptors, used to poll all the buttons for
-    // changes of state
-    if (get_poll_descriptors()) {
+    // Watch all the buttons for changes of state, from the capture thread,
+    // with the real-time settings, if any
+    if (watch_buttons()) {
         e = 1;
         goto end;
     }
-    // Execute the main loop
+    set_realtime();
+    if (start_capture()) {
+        e = 1;
+        goto end;
+    }
+    // Self-check of the real-time settings
+    if ((lock_memory || rt_priority || cpu >= 0) && check_realtime()) {
+        warnx("the real-time settings are not completely in effect");
+    }
+    // Execute the main loop. A build for the benchmarks checks that the
+    // edges, the timers and the actions don't allocate memory.
+#ifdef ALLOCWATCH
+    allocwatch_start();
+#endif
     if (run()) {
         e = 1;
     }
+#ifdef ALLOCWATCH
+    allocations = allocwatch_stop();
+    report("%lu heap allocations in the main loop", allocations);
+    if (allocations) {
+        e = 1;
+    }
+#endif
 end:
+    stop_capture();
     close_gpios();
+    close_stats_socket();
+    if (config_watch.fd >= 0) {
+        close(config_watch.fd);
+    }
+    free(config_absolute);
+    // The trace is open even if an error stopped the recording
+    if (record_path && trace.f && trace_close(&trace)) {
+        warn("cannot record in '%s'", record_path);
+    }
+    spawner_stop(&spawner);
+    reactor_close(&reactor);
     return e;
 }
 
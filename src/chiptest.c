@@ -0,0 +1,187 @@
+/* chiptest.c
+   Test of the LEDs set through the GPIO character device, against a fake
+   chip: the lines toggled in a tick must be set with a single call for each
+   request of lines.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <err.h>        // errx
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // printf
+
+#include "blinkplay.h"
+#include "blinkseq.h"
+#include "clock.h"
+#include "fakechip.h"
+#include "ledlines.h"
+
+#define PROGNAME    "chiptest"
+
+#define NS_PER_MS   1000000ULL
+
+// Virtual time when the test starts (ns)
+#define START       (7000ULL * NS_PER_MS + 456)
+
+// Number of LEDs, more than a request of lines
+#define NLEDS       70
+
+// Fail the test if a condition doesn't hold
+#define CHECK(c)    do { \
+        if (!(c)) { \
+            errx(1, "%s:%d: check failed: %s", __FILE__, __LINE__, #c); \
+        } \
+    } while (0)
+
+// A LED of the test, run by the player and the lines of ledblink
+struct led_t {
+    // The LED in the player. It is the first member, so the LED is what the
+    // player passes to set_led.
+    struct blinkplay_led_t play;
+
+    // The LED in the lines
+    struct ledlines_led_t line;
+
+    // The sequence
+    struct blinkseq_t seq;
+
+    // Level expected of the line
+    int on;
+};
+
+// The LEDs
+struct led_t leds[NLEDS];
+
+// The player and the lines of the LEDs
+struct blinkplay_t player;
+struct ledlines_t lines;
+
+// Requests of lines with a LED toggled in the current tick, the bit i for
+// the i-th request
+uint64_t touched = 0;
+
+// Number of ticks with toggles
+unsigned int ticks = 0;
+
+/* Turn a LED ON or OFF through the lines, and in the model. Called by the
+   player at the start of each step.
+
+   Parameters:
+     * play: the LED in the player.
+     * on: 1 to turn it ON, 0 to turn it OFF.
+*/
+void
+set_led(struct blinkplay_led_t *play, int on)
+{
+    struct led_t *led = (struct led_t*)play;
+
+    ledlines_set(&(led->line), on);
+    led->on = on;
+    touched |= 1ULL << (led->line.request - lines.requests);
+}
+
+/* Set the lines of the tick and check that each request touched was set
+   once, and the values of all the lines. Called by the player at the end of
+   each tick.
+
+   Parameters:
+     * p: the player.
+*/
+void
+end_tick(struct blinkplay_t *p)
+{
+    struct ledlines_request_t *r;
+    unsigned int writes, expected = 0;
+    uint64_t bits;
+    int repeated;
+
+    CHECK(!ledlines_flush(&lines));
+    writes = fakechip_end_tick(&repeated);
+    CHECK(!repeated);
+    for (unsigned int i = 0; i < lines.nrequests; i++) {
+        expected += (touched >> i) & 1;
+    }
+    CHECK(writes == expected);
+    for (unsigned int i = 0; i < lines.nrequests; i++) {
+        r = &(lines.requests[i]);
+        bits = 0;
+        for (unsigned int j = 0; j < NLEDS; j++) {
+            if (leds[j].line.request == r && leds[j].on) {
+                bits |= leds[j].line.bit;
+            }
+        }
+        CHECK(fakechip_values(r->fd) == bits);
+    }
+    ticks += touched != 0;
+    touched = 0;
+}
+
+/* Compile the sequence of a LED.
+
+   Parameters:
+     * led: the LED.
+     * text: the blink sequence.
+*/
+void
+compile(struct led_t *led, const char *text)
+{
+    const char *error;
+    unsigned int pos;
+
+    if (blinkseq_compile(&(led->seq), text, &error, &pos)) {
+        errx(1, "'%s': %s at %u", text, error, pos);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    CHECK(!ledlines_init(&lines, NLEDS));
+    // Most LEDs toggle together, two of them on their own and the last ones,
+    // in the second request of lines, at other times
+    for (unsigned int i = 0; i < NLEDS; i++) {
+        compile(&(leds[i]), i < 40 ? "(o10_20)*20" : i == 40
+            ? "_5(o10_10)*20" : i == 41 ? "(o1_2)*100" : i < 64
+            ? "(o10_20)*20" : "(o7_13)*30");
+        leds[i].on = 0;
+        ledlines_add(&lines, &(leds[i].line), i);
+    }
+    CHECK(lines.nrequests == 2);
+    CHECK(!ledlines_request(&lines, "/dev/null", PROGNAME));
+    clock_set_virtual(START);
+    blinkplay_init(&player, set_led, end_tick);
+    for (unsigned int i = 0; i < NLEDS; i++) {
+        blinkplay_add(&player, &(leds[i].play), &(leds[i].seq));
+    }
+    blinkplay_run(&player, NULL, NULL);
+    CHECK(ticks > 0);
+    // The LEDs are switched off at the end
+    for (unsigned int i = 0; i < lines.nrequests; i++) {
+        CHECK(!fakechip_values(lines.requests[i].fd));
+    }
+    ledlines_close(&lines);
+    for (unsigned int i = 0; i < NLEDS; i++) {
+        blinkseq_free(&(leds[i].seq));
+    }
+    printf(PROGNAME ": %u ticks with toggles: ok\n", ticks);
+    return 0;
+}
+
@@ -0,0 +1,140 @@
+/* clock.c
+   Clock of the programs, real or virtual.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "clock.h"
+
+#include <errno.h>          // EINTR
+#include <poll.h>           // ppoll
+#include <sys/timerfd.h>    // timerfd_create
+#include <time.h>           // clock_gettime
+
+// Flag that tells if the virtual clock is being used
+static int virtual_clock = 0;
+
+// The virtual time (ns)
+static uint64_t virtual_now = 0;
+
+// The timerfd the sleeps wait for, created by the first one
+static int timer_fd = -1;
+
+/* Return the current time, in nanoseconds: the time of CLOCK_MONOTONIC or the
+   virtual time.
+*/
+uint64_t
+clock_now()
+{
+    struct timespec ts;
+
+    if (virtual_clock) {
+        return virtual_now;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Sleep until a given time of CLOCK_MONOTONIC. The deadline is absolute,
+   so the time spent before the call doesn't delay the wake up. A signal
+   handled by the process ends the sleep early, so the caller can act on it
+   at once and sleep again until the same deadline. The mask of signals is
+   set only during the sleep, atomically, so a caller that keeps its signals
+   blocked and checks their flags before the call can't lose one that comes
+   in between. With the virtual clock, the time just jumps to it.
+
+   Parameters:
+     * deadline: the time (ns).
+     * sigmask: the signals blocked during the sleep, NULL to keep the
+         current ones.
+
+   Return 0 if the deadline was reached, 1 if a signal interrupted the sleep.
+*/
+int
+clock_sleep_until(uint64_t deadline, const sigset_t *sigmask)
+{
+    struct itimerspec its;
+    struct timespec timeout, *ptimeout = NULL;
+    struct pollfd pfd;
+    uint64_t now;
+
+    if (virtual_clock) {
+        if (deadline > virtual_now) {
+            virtual_now = deadline;
+        }
+        return 0;
+    }
+    // The timerfd wakes up at the absolute deadline. If it can't be used,
+    // ppoll waits for the time left, ignoring the negative descriptor
+    if (timer_fd < 0) {
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    }
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = 0;
+    its.it_value.tv_sec = deadline / 1000000000;
+    its.it_value.tv_nsec = deadline % 1000000000;
+    // A zero time would disarm the timerfd, any past time expires at once
+    if (!deadline) {
+        its.it_value.tv_nsec = 1;
+    }
+    pfd.fd = timer_fd;
+    pfd.events = POLLIN;
+    if (timer_fd < 0
+        || timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL))
+    {
+        pfd.fd = -1;
+        now = clock_now();
+        now = deadline > now ? deadline - now : 0;
+        timeout.tv_sec = now / 1000000000;
+        timeout.tv_nsec = now % 1000000000;
+        ptimeout = &timeout;
+    }
+    // The expiration is not read: arming the timerfd again resets it
+    return ppoll(&pfd, 1, ptimeout, sigmask) < 0 && errno == EINTR;
+}
+
+/* Switch to the virtual clock.
+
+   Parameters:
+     * start: the initial virtual time (ns).
+*/
+void
+clock_set_virtual(uint64_t start)
+{
+    virtual_clock = 1;
+    virtual_now = start;
+}
+
+/* Move the virtual time forward, as if some time had passed outside of the
+   sleeps. Nothing is done with the real clock.
+
+   Parameters:
+     * ns: the time to move forward, in nanoseconds.
+*/
+void
+clock_advance(uint64_t ns)
+{
+    if (virtual_clock) {
+        virtual_now += ns;
+    }
+}
+
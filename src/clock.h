@@ -0,0 +1,78 @@
+/* clock.h
+   Clock of the programs, real or virtual.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <signal.h>     // sigset_t
+#include <stdint.h>     // uint64_t
+
+// The timing logic of the programs reads the time and sleeps through these
+// functions. By default they use CLOCK_MONOTONIC. A test can switch to a
+// virtual clock, where sleeping just moves the time forward, so long clicks
+// and blink sequences of seconds are checked in microseconds. The virtual
+// clock must be used from a single thread.
+
+/* Return the current time, in nanoseconds: the time of CLOCK_MONOTONIC or the
+   virtual time.
+*/
+uint64_t
+clock_now();
+
+/* Sleep until a given time of CLOCK_MONOTONIC. The deadline is absolute,
+   so the time spent before the call doesn't delay the wake up. A signal
+   handled by the process ends the sleep early, so the caller can act on it
+   at once and sleep again until the same deadline. The mask of signals is
+   set only during the sleep, atomically, so a caller that keeps its signals
+   blocked and checks their flags before the call can't lose one that comes
+   in between. With the virtual clock, the time just jumps to it.
+
+   Parameters:
+     * deadline: the time (ns).
+     * sigmask: the signals blocked during the sleep, NULL to keep the
+         current ones.
+
+   Return 0 if the deadline was reached, 1 if a signal interrupted the sleep.
+*/
+int
+clock_sleep_until(uint64_t deadline, const sigset_t *sigmask);
+
+/* Switch to the virtual clock.
+
+   Parameters:
+     * start: the initial virtual time (ns).
+*/
+void
+clock_set_virtual(uint64_t start);
+
+/* Move the virtual time forward, as if some time had passed outside of the
+   sleeps. Nothing is done with the real clock.
+
+   Parameters:
+     * ns: the time to move forward, in nanoseconds.
+*/
+void
+clock_advance(uint64_t ns);
+
+#endif
+
@@ -0,0 +1,307 @@
+/* confbench.c
+   Benchmark of the ways of reading the configuration file of buttonsd.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "config.h"
+
+#include <err.h>        // err
+#include <getopt.h>     // getopt_long
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // printf
+#include <stdlib.h>     // exit
+#include <string.h>     // strchr
+#include <unistd.h>     // unlink
+
+#include "clock.h"
+#include "conffile.h"
+#include "parsenum.h"
+#include "readline.h"
+
+#define OPTSTRING   "hn:r:"
+#define PROGNAME    "confbench"
+
+// Default number of lines of the configuration file generated
+#define DEFAULT_LINES   10000
+
+// Default number of times that the file is read by each method
+#define DEFAULT_ROUNDS  50
+
+// Number of lines of the configuration file
+unsigned int lines = DEFAULT_LINES;
+
+// Number of times that the file is read by each method
+unsigned int rounds = DEFAULT_ROUNDS;
+
+// Path of the configuration file generated
+char path[] = "/tmp/confbenchXXXXXX";
+
+// Print help message and exits
+void
+print_help()
+{
+    printf("Usage: " PROGNAME " [options]\n"
+"Generate a configuration file of buttonsd and read it many times, with\n"
+"readline (as buttonsd used to do) and with the mmap tokenizer, and print\n"
+"the time spent.\n"
+"Options:\n"
+"  -h, --help              Show this message and exit.\n"
+"  -n N, --lines N         Number of lines of the file.\n"
+"  -r N, --rounds N        Number of reads per method.\n"
+    );
+    exit(0);
+}
+
+/* Parse a positive number given in the command line or exit.
+
+   Parameters:
+     * s: the string that contains the number.
+*/
+unsigned int
+parse_arg_number(const char *s)
+{
+    const char *eptr;
+    unsigned int n;
+
+    if (parse_number(s, &eptr, &n) || eptr == s || *eptr != '\0' || !n) {
+        errx(1, "invalid number '%s'", s);
+    }
+    return n;
+}
+
+/* Parse the command line arguments.
+
+   Parameters:
+     * argc: number of command line arguments.
+     * argv: command line string arguments.
+*/
+void
+parse_args(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {"lines", required_argument, 0, 'n'},
+        {"rounds", required_argument, 0, 'r'},
+        {0, 0, 0, 0}
+    };
+    int o;
+
+    do {
+        o = getopt_long(argc, argv, OPTSTRING, long_opts, 0);
+        switch (o) {
+            case 'h':
+                print_help();
+            case 'n':
+                lines = parse_arg_number(optarg);
+                break;
+            case 'r':
+                rounds = parse_arg_number(optarg);
+                break;
+            case '?':
+                exit(1);
+            default:
+                break;
+        }
+    } while (o != -1);
+}
+
+/* Generate a configuration file like the ones of a large rack: comments,
+   actions with and without the shell, settings and chords.
+*/
+void
+generate_file()
+{
+    FILE *f;
+    int fd;
+
+    fd = mkstemp(path);
+    if (fd < 0 || !(f = fdopen(fd, "w"))) {
+        err(1, "cannot create '%s'", path);
+    }
+    for (unsigned int i = 0; i < lines; i++) {
+        switch (i % 8) {
+            case 0:
+                fprintf(f, "# Rack %u, slot %u\n", i / 512, i / 8 % 64);
+                break;
+            case 1:
+                fprintf(f, "%u_click=/usr/local/bin/rackctl --slot %u "
+                    "power-cycle\n", i / 8, i / 8 % 64);
+                break;
+            case 2:
+                fprintf(f, "%u_long_click=!logger -t rack \"slot %u held\" "
+                    "&& /usr/local/bin/rackctl --slot %u off\n", i / 8,
+                    i / 8 % 64, i / 8 % 64);
+                break;
+            case 3:
+                fprintf(f, "%u_debounce=20\n", i / 8);
+                break;
+            case 4:
+                fprintf(f, "%u_double_click=/usr/local/bin/rackctl --slot %u "
+                    "identify\n", i / 8, i / 8 % 64);
+                break;
+            case 5:
+                fprintf(f, "\n");
+                break;
+            case 6:
+                fprintf(f, "%u_long_click_time=1500\n", i / 8);
+                break;
+            default:
+                fprintf(f, "%u+%u_chord=/usr/local/bin/rackctl --rack %u "
+                    "reset\n", i / 8, i / 8 + 1, i / 512);
+                break;
+        }
+    }
+    if (fclose(f)) {
+        err(1, "cannot write '%s'", path);
+    }
+}
+
+/* Parse the pins of the key of a line, the work done by buttonsd before it
+   looks at the event or the setting.
+
+   Parameters:
+     * key: the key.
+
+   Return the sum of the pins, so the work is not optimized away.
+*/
+unsigned long
+parse_pins(const char *key)
+{
+    const char *eptr = key;
+    unsigned long sum = 0;
+    unsigned int pin;
+
+    do {
+        key = eptr + (*eptr == '+');
+        if (parse_number(key, &eptr, &pin) || eptr == key) {
+            break;
+        }
+        sum += pin;
+    } while (*eptr == '+');
+    return sum;
+}
+
+/* Read the file with readline, as buttonsd used to do: each line is copied
+   to a buffer, then '=' and the new line are searched byte by byte.
+
+   Return the sum of the pins and the lengths of the values.
+*/
+unsigned long
+read_readline()
+{
+    struct line_t l = LINE_INIT;
+    unsigned long sum = 0;
+    char *ptr, *eptr;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (!f) {
+        err(1, "cannot open '%s'", path);
+    }
+    while (readline(&l, f) > 0) {
+        if (l.line[0] == '\n' || l.line[0] == '#') {
+            continue;
+        }
+        ptr = l.line;
+        while (*ptr != '=' && *ptr != '\0') ptr++;
+        if (*ptr == '\0') {
+            continue;
+        }
+        *ptr++ = '\0';
+        eptr = strchr(ptr, '\n');
+        if (eptr) {
+            *eptr = '\0';
+        }
+        sum += parse_pins(l.line) + strlen(ptr);
+    }
+    fclose(f);
+    readline_free(&l);
+    return sum;
+}
+
+/* Read the file with the mmap tokenizer of buttonsd.
+
+   Return the sum of the pins and the lengths of the values.
+*/
+unsigned long
+read_conffile()
+{
+    struct conffile_t c;
+    struct conffile_entry_t e;
+    unsigned long sum = 0;
+
+    if (conffile_open(&c, path)) {
+        err(1, "cannot open '%s'", path);
+    }
+    while (conffile_next(&c, &e) > 0) {
+        if (e.value) {
+            sum += parse_pins(e.key) + strlen(e.value);
+        }
+    }
+    conffile_close(&c);
+    return sum;
+}
+
+/* Run the benchmark of a method and print the results. The first read is
+   not measured, so the file is in the page cache.
+
+   Parameters:
+     * name: the name of the method.
+     * method: the function that reads the file.
+
+   Return the result of the method, to compare it with the other one.
+*/
+unsigned long
+bench(const char *name, unsigned long (*method)())
+{
+    uint64_t t0, total;
+    unsigned long sum;
+
+    sum = method();
+    t0 = clock_now();
+    for (unsigned int i = 0; i < rounds; i++) {
+        method();
+    }
+    total = clock_now() - t0;
+    printf("%-16s %14.1f %14.1f\n", name, (double)total / rounds / 1000.0,
+        (double)total / rounds / lines);
+    return sum;
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned long r1, r2;
+
+    parse_args(argc, argv);
+    generate_file();
+    printf("%u reads of a file of %u lines\n", rounds, lines);
+    printf("%-16s %14s %14s\n", "method", "file (us)", "line (ns)");
+    r1 = bench("readline", read_readline);
+    r2 = bench("mmap", read_conffile);
+    unlink(path);
+    if (r1 != r2) {
+        errx(1, "the methods read different entries");
+    }
+    return 0;
+}
+
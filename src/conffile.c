@@ -0,0 +1,214 @@
+/* conffile.c
+   Tokenizer of the configuration files, that reads them through mmap.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "conffile.h"
+
+#include <fcntl.h>      // open
+#include <stdint.h>     // uint64_t
+#include <stdlib.h>     // malloc
+#include <string.h>     // memchr
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close
+
+// A byte repeated in all the bytes of a word
+#define CONFFILE_BYTES(c)   (0x0101010101010101ULL * (unsigned char)(c))
+
+// Nonzero if any byte of a word is zero
+#define CONFFILE_HAS_ZERO(w) \
+    (((w) - CONFFILE_BYTES(1)) & ~(w) & CONFFILE_BYTES(0x80))
+
+/* Find the first '=' or new line of a line, eight bytes at a time.
+
+   Parameters:
+     * p: the line.
+     * n: number of bytes until the end of the file.
+
+   Return the position of the first '=' or new line, or n if there's none.
+*/
+static size_t
+conffile_scan(const char *p, size_t n)
+{
+    size_t i = 0;
+    uint64_t w;
+
+    // Skip the words without any of both characters
+    for (; i + sizeof(w) <= n; i += sizeof(w)) {
+        memcpy(&w, p + i, sizeof(w));
+        if (CONFFILE_HAS_ZERO(w ^ CONFFILE_BYTES('='))
+            || CONFFILE_HAS_ZERO(w ^ CONFFILE_BYTES('\n')))
+        {
+            break;
+        }
+    }
+    for (; i < n; i++) {
+        if (p[i] == '=' || p[i] == '\n') {
+            break;
+        }
+    }
+    return i;
+}
+
+/* Open a configuration file and map it in memory.
+
+   Parameters:
+     * c: the configuration file.
+     * path: the path of the file.
+
+   Return 0 if the file was opened, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+conffile_open(struct conffile_t *c, const char *path)
+{
+    struct stat st;
+    int fd;
+
+    c->data = NULL;
+    c->size = 0;
+    c->pos = 0;
+    c->linenum = 1;
+    c->tail = NULL;
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 1;
+    }
+    if (fstat(fd, &st)) {
+        close(fd);
+        return 1;
+    }
+    // An empty file cannot be mapped, it has no entries anyway
+    if (st.st_size) {
+        // The pages are populated as private copies at once, so the file can
+        // be truncated or rewritten while it's being parsed
+        c->data = (char*)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (c->data == MAP_FAILED) {
+            c->data = NULL;
+            close(fd);
+            return 1;
+        }
+        c->size = st.st_size;
+    }
+    close(fd);
+    return 0;
+}
+
+/* Return the next entry of a configuration file. The empty lines and the
+   lines that start by '#' are skipped, and the CR of the lines ended by
+   CR LF is dropped. Each line is scanned once, a word at a time, to find its
+   '=' and its end.
+
+   Parameters:
+     * c: the configuration file.
+     * e: at output, the entry. The strings are valid until the file is
+         closed.
+
+   Return 1 if an entry was read, 0 at the end of the file, -1 if there's no
+   memory for the last line.
+*/
+int
+conffile_next(struct conffile_t *c, struct conffile_entry_t *e)
+{
+    char *line, *eq, *end;
+    size_t n, i;
+
+    while (c->pos < c->size) {
+        line = c->data + c->pos;
+        n = c->size - c->pos;
+        e->linenum = c->linenum++;
+        // Jump blank lines and comment lines
+        if (line[0] == '\n') {
+            c->pos++;
+            continue;
+        }
+        if (line[0] == '\r' && (n == 1 || line[1] == '\n')) {
+            c->pos += n == 1 ? 1 : 2;
+            continue;
+        }
+        if (line[0] == '#') {
+            end = memchr(line, '\n', n);
+            c->pos = end ? (size_t)(end - c->data) + 1 : c->size;
+            continue;
+        }
+        // Find the '=', then the end of the line
+        i = conffile_scan(line, n);
+        eq = NULL;
+        if (i < n && line[i] == '=') {
+            eq = line + i;
+            end = memchr(eq, '\n', n - i);
+        } else {
+            end = i < n ? line + i : NULL;
+        }
+        if (end) {
+            *end = '\0';
+            c->pos = end - c->data + 1;
+            // The CR of a line ended by CR LF is dropped
+            if (end > line && end[-1] == '\r') {
+                end[-1] = '\0';
+            }
+        } else {
+            // The last line has no new line, and there may be no room for
+            // the null character after it
+            if (line[n - 1] == '\r') {
+                n--;
+            }
+            c->tail = (char*)malloc(n + 1);
+            if (!c->tail) {
+                return -1;
+            }
+            memcpy(c->tail, line, n);
+            c->tail[n] = '\0';
+            if (eq) {
+                eq = c->tail + (eq - line);
+            }
+            line = c->tail;
+            c->pos = c->size;
+        }
+        if (eq) {
+            *eq = '\0';
+        }
+        e->key = line;
+        e->value = eq ? eq + 1 : NULL;
+        return 1;
+    }
+    return 0;
+}
+
+/* Close a configuration file and unmap it.
+
+   Parameters:
+     * c: the configuration file.
+*/
+void
+conffile_close(struct conffile_t *c)
+{
+    if (c->data) {
+        munmap(c->data, c->size);
+        c->data = NULL;
+    }
+    free(c->tail);
+    c->tail = NULL;
+}
+
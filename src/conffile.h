@@ -0,0 +1,98 @@
+/* conffile.h
+   Tokenizer of the configuration files, that reads them through mmap.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONFFILE_H
+#define CONFFILE_H
+
+#include <sys/types.h>  // size_t
+
+// A configuration file mapped in memory. The file is mapped private and
+// writable, so the entries are split in place and they point into the
+// mapping, nothing is copied.
+struct conffile_t {
+    // The mapping, NULL if the file is empty
+    char *data;
+
+    // Size of the file
+    size_t size;
+
+    // Position of the next line
+    size_t pos;
+
+    // Number of the next line
+    unsigned int linenum;
+
+    // Copy of the last line if it doesn't end by a new line, because there
+    // may be no room in the mapping for its terminator
+    char *tail;
+};
+
+// An entry of a configuration file: a line of the form <key>=<value>
+struct conffile_entry_t {
+    // The key, ended by a null character
+    char *key;
+
+    // The value, ended by a null character, or NULL if the line has no '='
+    char *value;
+
+    // Number of the line in the file
+    unsigned int linenum;
+};
+
+/* Open a configuration file and map it in memory.
+
+   Parameters:
+     * c: the configuration file.
+     * path: the path of the file.
+
+   Return 0 if the file was opened, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+conffile_open(struct conffile_t *c, const char *path);
+
+/* Return the next entry of a configuration file. The empty lines and the
+   lines that start by '#' are skipped, and the CR of the lines ended by
+   CR LF is dropped. Each line is scanned once, a word at a time, to find its
+   '=' and its end.
+
+   Parameters:
+     * c: the configuration file.
+     * e: at output, the entry. The strings are valid until the file is
+         closed.
+
+   Return 1 if an entry was read, 0 at the end of the file, -1 if there's no
+   memory for the last line.
+*/
+int
+conffile_next(struct conffile_t *c, struct conffile_entry_t *e);
+
+/* Close a configuration file and unmap it.
+
+   Parameters:
+     * c: the configuration file.
+*/
+void
+conffile_close(struct conffile_t *c);
+
+#endif
+
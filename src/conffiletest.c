@@ -0,0 +1,138 @@
+/* conffiletest.c
+   Test of the tokenizer of the configuration files at the edges of its
+   lines and of the words it scans.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <err.h>        // err
+#include <stdio.h>      // printf
+#include <stdlib.h>     // mkstemp
+#include <string.h>     // strcmp
+#include <unistd.h>     // write
+
+#include "conffile.h"
+
+#define PROGNAME    "conffiletest"
+
+// Maximum length of the keys built around the size of a word
+#define MAX_KEY     20
+
+// Fail the test if a condition doesn't hold
+#define CHECK(c)    do { \
+        if (!(c)) { \
+            errx(1, "%s:%d: check failed: %s", __FILE__, __LINE__, #c); \
+        } \
+    } while (0)
+
+// An entry expected: key, value (NULL if none) and number of line. A NULL
+// key ends the entries.
+struct expected_t {
+    const char *key, *value;
+    unsigned int linenum;
+};
+
+/* Write a configuration file and check its entries.
+
+   Parameters:
+     * text: the contents of the file.
+     * size: size of the contents.
+     * expected: the entries expected.
+*/
+void
+check_file(const char *text, size_t size, const struct expected_t *expected)
+{
+    char path[] = "/tmp/" PROGNAME ".XXXXXX";
+    struct conffile_t c;
+    struct conffile_entry_t e;
+    int fd;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        err(1, "cannot create a temporary file");
+    }
+    if (write(fd, text, size) != (ssize_t)size) {
+        err(1, "cannot write '%s'", path);
+    }
+    close(fd);
+    CHECK(!conffile_open(&c, path));
+    unlink(path);
+    for (; expected->key; expected++) {
+        CHECK(conffile_next(&c, &e) == 1);
+        CHECK(!strcmp(e.key, expected->key));
+        CHECK(expected->value ? e.value && !strcmp(e.value, expected->value)
+            : !e.value);
+        CHECK(e.linenum == expected->linenum);
+    }
+    CHECK(conffile_next(&c, &e) == 0);
+    conffile_close(&c);
+}
+
+// Check a file given as a string literal
+#define CHECK_FILE(text, ...)   do { \
+        const struct expected_t expected[] = {__VA_ARGS__, {NULL, NULL, 0}}; \
+        check_file(text, sizeof(text) - 1, expected); \
+    } while (0)
+
+int
+main(int argc, char **argv)
+{
+    char text[3 * MAX_KEY + 8], key[MAX_KEY + 1], value[MAX_KEY + 2];
+    struct expected_t expected[3] = {
+        {key, value, 1}, {key, NULL, 2}, {NULL, NULL, 0}};
+    size_t n;
+
+    // Empty file, and only blank and comment lines
+    check_file("", 0, expected + 2);
+    check_file("\n\n# a=b\n\n#", 10, expected + 2);
+    // Comment lines, and '=' inside the values
+    CHECK_FILE("a=1\n# 2=3\n\nb=c=d\n#\nlong_click_time=x==y=\n",
+        {"a", "1", 1}, {"b", "c=d", 4}, {"long_click_time", "x==y=", 6});
+    // A last line without new line, with and without '=', and a last
+    // comment line
+    CHECK_FILE("a=1\nb=2", {"a", "1", 1}, {"b", "2", 2});
+    CHECK_FILE("a=1\nb", {"a", "1", 1}, {"b", NULL, 2});
+    CHECK_FILE("a=\n=b", {"a", "", 1}, {"", "b", 2});
+    CHECK_FILE("a=1\n# b=2", {"a", "1", 1});
+    // Lines ended by CR LF, also blank and comment lines and the last one
+    CHECK_FILE("a=1\r\n#c\r\n\r\nb=\r\nc\r\nd=e=f\r",
+        {"a", "1", 1}, {"b", "", 4}, {"c", NULL, 5}, {"d", "e=f", 6});
+    CHECK_FILE("a=1\r", {"a", "1", 1});
+    CHECK_FILE("a=1\n\r", {"a", "1", 1});
+    // The '=' and the new line at every position of the words scanned, with
+    // and without a new line at the end
+    for (unsigned int k = 0; k <= MAX_KEY; k++) {
+        memset(key, 'k', k);
+        key[k] = '\0';
+        // Without key, the second line is blank
+        expected[1].key = k ? key : NULL;
+        for (unsigned int v = 0; v <= MAX_KEY; v++) {
+            memset(value, 'v', v);
+            strcpy(value + v, "=");
+            n = snprintf(text, sizeof(text), "%s=%s\n%s\n", key, value, key);
+            check_file(text, n, expected);
+            check_file(text, n - 1, expected);
+        }
+    }
+    printf(PROGNAME ": ok\n");
+    return 0;
+}
+
@@ -33,11 +33,12 @@
    Paremters:
      * pidfile: the path to the pidfile to be created, or NULL if no pidfile
          has to be created.
+     * keepfd: a file descriptor that must stay open, or -1.
 
    Return 0 if the process is correctly daemonized, 1 in case of error.
 */
 int
-daemonize(const char *pidfile)
+daemonize(const char *pidfile, int keepfd)
 {
     int i, fd0, fd1, fd2, pidfd;
     pid_t pid;
@@ -111,7 +112,9 @@ daemonize(const char *pidfile)
         rl.rlim_max = 1024;
     }
     for (i = 0; i < rl.rlim_max; i++) {
-        close(i);
+        if (i != keepfd) {
+            close(i);
+        }
     }
 
     // Attach file descriptors 0, 1, and 2 to /dev/null.
@@ -0,0 +1,338 @@
+/* dictbench.c
+   Benchmark of the dictionary of int keys against the chained one that it
+   replaced.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <err.h>        // err
+#include <getopt.h>     // getopt_long
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // printf
+#include <stdlib.h>     // exit
+
+#include "clock.h"
+#include "dictchain.h"
+#include "dictint.h"
+#include "parsenum.h"
+
+#define OPTSTRING   "hk:l:"
+#define PROGNAME    "dictbench"
+
+// Default number of lookups measured for each number of keys
+#define DEFAULT_LOOKUPS 1000000
+
+// Number of keys of each run, by default
+const unsigned int default_sizes[] = {10, 1000, 100000};
+
+// Number of keys of the run given in the command line, 0 to do the default
+// runs
+unsigned int size_arg = 0;
+
+// Number of lookups measured for each number of keys
+unsigned int lookups = DEFAULT_LOOKUPS;
+
+// Kinds of keys
+enum keys_t {
+    // Consecutive keys from 0, as the GPIO pins of buttonsd
+    KEYS_PINS,
+
+    // Random keys, as the process ids of the supervisor
+    KEYS_RANDOM
+};
+
+// Time of each operation (ns)
+struct result_t {
+    double add, hit, miss, remove;
+};
+
+// Print help message and exits
+void
+print_help()
+{
+    printf("Usage: " PROGNAME " [options]\n"
+"Add, look up and remove keys in the dictionary of int keys, with open\n"
+"addressing, and in the chained dictionary that it replaced, with 10, 1000\n"
+"and 100000 keys, and print the time of each operation.\n"
+"Options:\n"
+"  -h, --help              Show this message and exit.\n"
+"  -k N, --keys N          Run only with N keys.\n"
+"  -l N, --lookups N       Number of lookups measured.\n"
+    );
+    exit(0);
+}
+
+/* Parse a positive number given in the command line or exit.
+
+   Parameters:
+     * s: the string that contains the number.
+*/
+unsigned int
+parse_arg_number(const char *s)
+{
+    const char *eptr;
+    unsigned int n;
+
+    if (parse_number(s, &eptr, &n) || eptr == s || *eptr != '\0' || !n) {
+        errx(1, "invalid number '%s'", s);
+    }
+    return n;
+}
+
+/* Parse the command line arguments.
+
+   Parameters:
+     * argc: number of command line arguments.
+     * argv: command line string arguments.
+*/
+void
+parse_args(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {"keys", required_argument, 0, 'k'},
+        {"lookups", required_argument, 0, 'l'},
+        {0, 0, 0, 0}
+    };
+    int o;
+
+    do {
+        o = getopt_long(argc, argv, OPTSTRING, long_opts, 0);
+        switch (o) {
+            case 'h':
+                print_help();
+            case 'k':
+                size_arg = parse_arg_number(optarg);
+                break;
+            case 'l':
+                lookups = parse_arg_number(optarg);
+                break;
+            case '?':
+                exit(1);
+            default:
+                break;
+        }
+    } while (o != -1);
+}
+
+/* Generate the keys of a run, the keys that are not in the dictionary and
+   the order of the lookups.
+
+   Parameters:
+     * kind: the kind of keys.
+     * keys: the keys, at output.
+     * misses: keys that are not in keys, at output.
+     * order: a random permutation of the indexes of the keys, at output.
+     * n: the number of keys.
+*/
+void
+generate_keys(enum keys_t kind, int *keys, int *misses, unsigned int *order,
+    unsigned int n)
+{
+    unsigned int j, t;
+
+    for (unsigned int i = 0; i < n; i++) {
+        if (kind == KEYS_PINS) {
+            keys[i] = i;
+            misses[i] = n + i;
+        } else {
+            // The keys are even and the misses odd, so they never match
+            keys[i] = (int)((random() << 1) & 0x7ffffffe);
+            misses[i] = keys[i] | 1;
+        }
+        order[i] = i;
+    }
+    for (unsigned int i = n - 1; i > 0; i--) {
+        j = random() % (i + 1);
+        t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+/* Measure the dictionary of int keys.
+
+   Parameters:
+     * keys: the keys.
+     * misses: keys that are not in the dictionary.
+     * order: the order of the lookups.
+     * n: the number of keys.
+     * r: the times of the operations, at output.
+
+   Return the sum of the values found, to compare it with the other
+   dictionary.
+*/
+uintptr_t
+bench_dictint(const int *keys, const int *misses, const unsigned int *order,
+    unsigned int n, struct result_t *r)
+{
+    struct dictint_t d;
+    uintptr_t sum = 0;
+    uint64_t t0;
+
+    if (dictint_init(&d, NULL)) {
+        err(1, "cannot create the dictionary");
+    }
+    t0 = clock_now();
+    for (unsigned int i = 0; i < n; i++) {
+        if (dictint_add(&d, keys[i], (void*)(uintptr_t)(i + 1))) {
+            err(1, "cannot add to the dictionary");
+        }
+    }
+    r->add = (double)(clock_now() - t0) / n;
+    t0 = clock_now();
+    for (unsigned int i = 0; i < lookups; i++) {
+        sum += (uintptr_t)dictint_get(&d, keys[order[i % n]]);
+    }
+    r->hit = (double)(clock_now() - t0) / lookups;
+    t0 = clock_now();
+    for (unsigned int i = 0; i < lookups; i++) {
+        sum += (uintptr_t)dictint_get(&d, misses[order[i % n]]);
+    }
+    r->miss = (double)(clock_now() - t0) / lookups;
+    t0 = clock_now();
+    for (unsigned int i = 0; i < n; i++) {
+        sum += (uintptr_t)dictint_remove(&d, keys[order[i]]);
+    }
+    r->remove = (double)(clock_now() - t0) / n;
+    dictint_free(&d);
+    return sum;
+}
+
+/* Measure the chained dictionary, as bench_dictint.
+
+   Parameters:
+     * keys: the keys.
+     * misses: keys that are not in the dictionary.
+     * order: the order of the lookups.
+     * n: the number of keys.
+     * r: the times of the operations, at output.
+
+   Return the sum of the values found, to compare it with the other
+   dictionary.
+*/
+uintptr_t
+bench_dictchain(const int *keys, const int *misses,
+    const unsigned int *order, unsigned int n, struct result_t *r)
+{
+    struct dictchain_t d;
+    uintptr_t sum = 0;
+    uint64_t t0;
+
+    if (dictchain_init(&d, NULL)) {
+        err(1, "cannot create the dictionary");
+    }
+    t0 = clock_now();
+    for (unsigned int i = 0; i < n; i++) {
+        if (dictchain_add(&d, keys[i], (void*)(uintptr_t)(i + 1))) {
+            err(1, "cannot add to the dictionary");
+        }
+    }
+    r->add = (double)(clock_now() - t0) / n;
+    t0 = clock_now();
+    for (unsigned int i = 0; i < lookups; i++) {
+        sum += (uintptr_t)dictchain_get(&d, keys[order[i % n]]);
+    }
+    r->hit = (double)(clock_now() - t0) / lookups;
+    t0 = clock_now();
+    for (unsigned int i = 0; i < lookups; i++) {
+        sum += (uintptr_t)dictchain_get(&d, misses[order[i % n]]);
+    }
+    r->miss = (double)(clock_now() - t0) / lookups;
+    t0 = clock_now();
+    for (unsigned int i = 0; i < n; i++) {
+        sum += (uintptr_t)dictchain_remove(&d, keys[order[i]]);
+    }
+    r->remove = (double)(clock_now() - t0) / n;
+    dictchain_free(&d);
+    return sum;
+}
+
+/* Print the times of a dictionary.
+
+   Parameters:
+     * n: the number of keys.
+     * kind: the name of the kind of keys.
+     * name: the name of the dictionary.
+     * r: the times of the operations.
+*/
+void
+print_result(unsigned int n, const char *kind, const char *name,
+    const struct result_t *r)
+{
+    printf("%8u %-8s %-10s %10.1f %10.1f %10.1f %10.1f\n", n, kind, name,
+        r->add, r->hit, r->miss, r->remove);
+}
+
+/* Run the benchmark of both dictionaries with a number of keys.
+
+   Parameters:
+     * n: the number of keys.
+     * kind: the kind of keys.
+*/
+void
+bench(unsigned int n, enum keys_t kind)
+{
+    const char *name = kind == KEYS_PINS ? "pins" : "random";
+    struct result_t flat, chain;
+    unsigned int *order;
+    int *keys, *misses;
+    uintptr_t s1, s2;
+
+    keys = (int*)malloc(sizeof(int) * n);
+    misses = (int*)malloc(sizeof(int) * n);
+    order = (unsigned int*)malloc(sizeof(unsigned int) * n);
+    if (!keys || !misses || !order) {
+        err(1, "cannot allocate %u keys", n);
+    }
+    generate_keys(kind, keys, misses, order, n);
+    // Both dictionaries must find the same values
+    s1 = bench_dictchain(keys, misses, order, n, &chain);
+    s2 = bench_dictint(keys, misses, order, n, &flat);
+    if (s1 != s2) {
+        errx(1, "the dictionaries found different values");
+    }
+    print_result(n, name, "chained", &chain);
+    print_result(n, name, "open", &flat);
+    free(keys);
+    free(misses);
+    free(order);
+}
+
+int
+main(int argc, char **argv)
+{
+    parse_args(argc, argv);
+    srandom(1);
+    printf("%u lookups of keys in the dictionary and of keys not in it\n",
+        lookups);
+    printf("%8s %-8s %-10s %10s %10s %10s %10s\n", "keys", "kind",
+        "dictionary", "add (ns)", "hit (ns)", "miss (ns)", "remove (ns)");
+    for (unsigned int i = 0; i < 3; i++) {
+        if (size_arg && i) {
+            break;
+        }
+        bench(size_arg ? size_arg : default_sizes[i], KEYS_PINS);
+        bench(size_arg ? size_arg : default_sizes[i], KEYS_RANDOM);
+    }
+    return 0;
+}
+
@@ -0,0 +1,408 @@
+/* dictchain.c
+   Dictionary of int keys as an array of linked lists, the implementation
+   that dictint replaced. Only used by dictbench to compare them.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "dictchain.h"
+
+#include <stdlib.h> // malloc
+
+// Initial size of the dictionary table. This must be ALLWAYS power of 2.
+#define DICTCHAIN_INIT_SIZE   8
+
+// Load factor to trigger a rehash
+#define MAX_LOAD_FACTOR     (2.0/3.0)
+
+/* Allocate memory for the dictionary, from its arena if it has one.
+
+   Parameters:
+     * d: the dictionary.
+     * size: number of bytes to allocate.
+
+   Return the memory allocated, or NULL in case of error.
+*/
+static void*
+dictchain_alloc(struct dictchain_t *d, size_t size)
+{
+    if (d->arena) {
+        return arena_alloc(d->arena, size);
+    }
+    return malloc(size);
+}
+
+/* Initialize the dictionary's table.
+   The buckets are initialized. Each bucket has a sentinel node.
+
+   Parameters:
+     * d: the dictionary.
+     * table: the dictionary's table to be initialized.
+     * size: size of the table.
+
+   Return 0 if the table is correctly initialized, 1 otherwise.
+*/
+static int
+dictchain_init_table(struct dictchain_t *d, struct dictchain_bucket_t *table, size_t size)
+{
+    struct dictchain_node_t *sentinel;
+
+    for (int i = 0; i < size; i++) {
+        sentinel = (struct dictchain_node_t*)dictchain_alloc(d,
+            sizeof(struct dictchain_node_t));
+        if (!sentinel) {
+            return 1;
+        }
+        sentinel->next = NULL;
+        table[i].first = sentinel;
+        table[i].last = sentinel;
+    }
+    return 0;
+}
+
+/* Free the nodes of a dictionary's table, sentinels included.
+
+   Parameters:
+     * table: the table whose nodes must be freed.
+     * size: size of the table.
+*/
+static void
+dictchain_free_table(struct dictchain_bucket_t *table, size_t size)
+{
+    struct dictchain_node_t *n, *next;
+
+    for (int i = 0; i < size; i++) {
+        n = table[i].first;
+        while (n) {
+            next = n->next;
+            free(n);
+            n = next;
+        }
+    }
+}
+
+/* Initialize the dictionary.
+
+   Parameters:
+     * d: the dictionary to initialize.
+     * a: the arena where the table and the nodes are allocated, or NULL to
+         allocate them with malloc.
+
+   Return 0 if the initialization was correct, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+dictchain_init(struct dictchain_t *d, struct arena_t *a)
+{
+    // Allocate the dictionary's table
+    d->arena = a;
+    d->table_size = DICTCHAIN_INIT_SIZE;
+    d->table = (struct dictchain_bucket_t*)dictchain_alloc(d,
+        sizeof(struct dictchain_bucket_t) * d->table_size);
+    if (!d->table) {
+        return 1;
+    }
+    // Initialize the dictionary's table
+    // The bucketsare initialized with a sentinel
+    d->numelems = 0;
+    if (dictchain_init_table(d, d->table, DICTCHAIN_INIT_SIZE)) {
+        return 1;
+    }
+    return 0;
+}
+
+/* Creates a new node with a given pair key/val and inserts it into the given
+   bucket of the given table.
+
+   Parameters:
+     * d: the dictionary.
+     * table: the table where to add the new node.
+     * bucket: the index of the bucket where to add the new node.
+     * key: new element's key.
+     * val: new element's value.
+
+   Return 0 if the new element is correctly added, 1 otherwise.
+*/
+static int
+dictchain_add_node(struct dictchain_t *d, struct dictchain_bucket_t *table, int bucket,
+    int key, void *val)
+{
+    struct dictchain_node_t *n;
+
+    // Allocate a new node
+    n = (struct dictchain_node_t*)dictchain_alloc(d,
+        sizeof(struct dictchain_node_t));
+    if (!n) {
+        return 1;
+    }
+    // Initialize the node
+    n->next = NULL;
+    n->key = key;
+    n->value = val;
+    // Insert the node in the corresponding bucket
+    table[bucket].last->next = n;
+    table[bucket].last = n;
+    return 0;
+}
+
+/* Resize the table (multiply its size by 2) and rehash its elements.
+
+   Parameters:
+     * d: the dictionary.
+
+   Return 0 if the rehashing is correctly done, 1 otherwise.
+*/
+static int
+dictchain_rehash(struct dictchain_t* d)
+{
+    struct dictchain_bucket_t *new_table;
+    size_t new_size;
+    struct dictchain_iterator_t it;
+    int key;
+    void *val;
+
+    // Resize is done when load factor (number of elements divided by number
+    // of buckets) is greater than MAX_LOAD_FACTOR.
+    if ((double)d->numelems/d->table_size > MAX_LOAD_FACTOR) {
+        // Alocate the new table
+        new_size = d->table_size * 2;
+        new_table = (struct dictchain_bucket_t*)dictchain_alloc(d,
+            sizeof(struct dictchain_bucket_t) * new_size);
+        if (!new_table) {
+            return 1;
+        }
+        // Initialize the new table
+        if (dictchain_init_table(d, new_table, new_size)) {
+            return 1;
+        }
+        // Rehash the table
+        dictchain_iterator_begin(d, &it);
+        while (dictchain_iterator_next(&it, &key, &val)) {
+            if (dictchain_add_node(d, new_table, key & (new_size - 1), key,
+                val)) {
+                return 1;
+            }
+        }
+        // Update the dictionary with the new table. The old one stays in the
+        // arena until the arena is freed
+        if (!d->arena) {
+            dictchain_free_table(d->table, d->table_size);
+            free(d->table);
+        }
+        d->table = new_table;
+        d->table_size = new_size;
+    }
+    return 0;
+}
+
+/* Return the node with the given key, that must be in the given bucket.
+
+   Parameters:
+     * d: the dictionary.
+     * bucket: the bucket index where the node must be searched.
+     * key: the key of the node being search.
+*/
+static struct dictchain_node_t*
+dictchain_get_node(struct dictchain_t *d, int bucket, int key)
+{
+    struct dictchain_node_t *n = d->table[bucket].first->next;
+
+    while (n) {
+        if (n->key == key) {
+            break;
+        }
+        n = n->next;
+    }
+    return n;
+}
+
+/* Adds an element to the dictionary.
+
+   Parameters:
+     * d: the dictionary.
+     * key: the element's key.
+     * elem: the element to add.
+
+   Return 0 if the element is correctly added, -1 otherwise. In the latter
+   case, errno is set accordingly.
+*/
+int
+dictchain_add(struct dictchain_t *d, int key, void *elem)
+{
+    struct dictchain_node_t *n;
+    int bucket;
+
+    // Rehash the table
+    if (dictchain_rehash(d)) {
+        return 1;
+    }
+    // Search a node with the given key
+    bucket = key & (d->table_size - 1);
+    n = dictchain_get_node(d, bucket, key);
+    if (n) {
+        // A node with the same key exists, replace the value
+        n->value = elem;
+    } else {
+        // No node with this key exists, create a new one
+        if (dictchain_add_node(d, d->table, bucket, key, elem)) {
+            return 1;
+        }
+        d->numelems++;
+    }
+    return 0;
+}
+
+/* Return an element of the dictionary given its key, or NULL if the element is
+   not in the dictionary.
+
+   Parameters:
+     * d: the dictionary.
+     * key: the key.
+*/
+void*
+dictchain_get(struct dictchain_t *d, int key)
+{
+    struct dictchain_node_t *n;
+
+    n = dictchain_get_node(d, key & (d->table_size - 1), key);
+    if (n) {
+        return n->value;
+    }
+    return NULL;
+}
+
+/* Remove an element from the dictionary given its key.
+
+   Parameters:
+     * d: the dictionary.
+     * key: the key of the element to remove.
+
+   Return the removed element, or NULL if the element was not in the
+   dictionary.
+*/
+void*
+dictchain_remove(struct dictchain_t *d, int key)
+{
+    struct dictchain_bucket_t *b = &(d->table[key & (d->table_size - 1)]);
+    struct dictchain_node_t *prev = b->first, *n;
+    void *val;
+
+    // Search the node that precedes the one with the given key
+    while (prev->next && prev->next->key != key) {
+        prev = prev->next;
+    }
+    n = prev->next;
+    if (!n) {
+        return NULL;
+    }
+    // Unlink the node
+    prev->next = n->next;
+    if (b->last == n) {
+        b->last = prev;
+    }
+    val = n->value;
+    if (!d->arena) {
+        free(n);
+    }
+    d->numelems--;
+    return val;
+}
+
+/* Return an iterator to iterate over the elements in the dictionary.
+
+   Parameters:
+     * d: the dictionary to iterate.
+     * i: output parameter that contains the iterator pointing before the first
+         element.
+*/
+void
+dictchain_iterator_begin(struct dictchain_t *d, struct dictchain_iterator_t *i)
+{
+    i->d = d;
+    i->bucket = 0;
+    // A dictionary freed, or not initialized, has no table
+    i->node = d->table ? d->table[0].first : NULL;
+}
+
+/* Return the next element pointed by the iterator i. Increments the position
+   of the iterator.
+
+   Parameters:
+     * i: the iterator. At output, the iterator points to the returned element.
+     * key: output parameter that contains the current element's key.
+     * value: output parameter that contains the current element's value.
+
+   Return 1 if there's next element, 0 if there's no more elements.
+*/
+int
+dictchain_iterator_next(struct dictchain_iterator_t *i, int *key, void **value)
+{
+    // If there's no more buckets, stop iteration
+    if (!i->node || i->bucket >= i->d->table_size) {
+        return 0;
+    }
+    while (1) {
+        i->node = i->node->next;
+        if (!i->node) {
+            // No more nodes in this bucket, go to the next bucket
+            i->bucket++;
+            if (i->bucket < i->d->table_size) {
+                i->node = i->d->table[i->bucket].first;
+            } else {
+                // No more buckets, stop iteration
+                return 0;
+            }
+        } else {
+            // Found next node
+            *key = i->node->key;
+            *value = i->node->value;
+            return 1;
+        }
+    }
+}
+
+/* Return the number of elements in the dictionary.
+
+   Parameters:
+     * d: the dictionary.
+*/
+size_t
+dictchain_size(struct dictchain_t *d)
+{
+    return d->numelems;
+}
+
+/* Free the memory used by the dictionary. The values are not freed, and the
+   memory allocated from an arena is freed with the arena.
+
+   Parameters:
+     * d: the dictionary.
+*/
+void
+dictchain_free(struct dictchain_t *d)
+{
+    if (!d->arena) {
+        dictchain_free_table(d->table, d->table_size);
+        free(d->table);
+    }
+    d->table = NULL;
+    d->table_size = 0;
+    d->numelems = 0;
+}
+
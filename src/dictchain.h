@@ -0,0 +1,168 @@
+/* dictchain.h
+   Dictionary of int keys as an array of linked lists, the implementation
+   that dictint replaced. Only used by dictbench to compare them.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DICTCHAIN_H
+#define DICTCHAIN_H
+
+#include "arena.h"
+#include "list.h"
+
+#include <sys/types.h>  // size_t
+
+struct dictchain_node_t {
+    // The next element
+    struct dictchain_node_t *next;
+
+    // The key
+    int key;
+
+    // The value
+    void *value;
+};
+
+struct dictchain_bucket_t {
+    // The first element in this bucket
+    struct dictchain_node_t *first;
+
+    // The last element in this bucket
+    struct dictchain_node_t *last;
+};
+
+// Dictionary of int keys
+struct dictchain_t {
+    // A dynamic array of lists
+    struct dictchain_bucket_t *table;
+
+    // Size of the array
+    size_t table_size;
+
+    // Number of elements in the dictionary
+    size_t numelems;
+
+    // Arena of the table and the nodes, NULL if they are allocated with
+    // malloc
+    struct arena_t *arena;
+};
+
+// Type used to iterate over the elements of the dictionary
+struct dictchain_iterator_t {
+    // Dictionary being iterated
+    struct dictchain_t *d;
+
+    // Current bucket
+    int bucket;
+
+    // Current node
+    struct dictchain_node_t *node;
+};
+
+/* Initialize the dictionary.
+
+   Parameters:
+     * d: the dictionary to initialize.
+     * a: the arena where the table and the nodes are allocated, or NULL to
+         allocate them with malloc.
+
+   Return 0 if the initialization was correct, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+dictchain_init(struct dictchain_t *d, struct arena_t *a);
+
+/* Adds an element to the dictionary.
+
+   Parameters:
+     * d: the dictionary.
+     * key: the element's key.
+     * elem: the element to add.
+
+   Return 0 if the element is correctly added, -1 otherwise. In the latter
+   case, errno is set accordingly.
+*/
+int
+dictchain_add(struct dictchain_t *d, int key, void *elem);
+
+/* Return an element of the dictionary given its key, or NULL if the element is
+   not in the dictionary.
+
+   Parameters:
+     * d: the dictionary.
+     * key: the key.
+*/
+void *
+dictchain_get(struct dictchain_t *d, int key);
+
+/* Remove an element from the dictionary given its key.
+
+   Parameters:
+     * d: the dictionary.
+     * key: the key of the element to remove.
+
+   Return the removed element, or NULL if the element was not in the
+   dictionary.
+*/
+void *
+dictchain_remove(struct dictchain_t *d, int key);
+
+/* Return an iterator to iterate over the elements in the dictionary.
+
+   Parameters:
+     * d: the dictionary to iterate.
+     * i: output parameter that contains the iterator pointing to the first
+         element.
+*/
+void
+dictchain_iterator_begin(struct dictchain_t *d, struct dictchain_iterator_t *i);
+
+/* Return the next element pointed by the iterator i. Increments the position
+   of the iterator.
+
+   Parameters:
+     * i: the iterator. At output, the iterator points to the next element.
+     * key: output parameter that contains the current element's key.
+     * value: output parameter that contains the current element's value.
+
+   Return 1 if there's next element, 0 if there's no more elements.
+*/
+int
+dictchain_iterator_next(struct dictchain_iterator_t *i, int *key, void **value);
+
+/* Return the number of elements in the dictionary.
+
+   Parameters:
+     * d: the dictionary.
+*/
+size_t
+dictchain_size(struct dictchain_t *d);
+
+/* Free the memory used by the dictionary. The values are not freed, and the
+   memory allocated from an arena is freed with the arena.
+
+   Parameters:
+     * d: the dictionary.
+*/
+void
+dictchain_free(struct dictchain_t *d);
+
+#endif
+
@@ -1,6 +1,7 @@
 
 /* dictint.c
-   Implementation of a dictonary as an array of linked lists.
+   Implementation of a dictionary of int keys as a hash table with open
+   addressing.
    
    Copyright 2018 Antonio Serrano Hernandez
 
@@ -23,198 +24,276 @@
 
 #include "dictint.h"
 
-#include <stdlib.h> // malloc
+#include <stdint.h>     // uint32_t
+#include <stdlib.h>     // malloc
+#include <string.h>     // memset
 
 // Initial size of the dictionary table. This must be ALLWAYS power of 2.
 #define DICTINT_INIT_SIZE   8
 
-// Load factor to trigger a rehash
-#define MAX_LOAD_FACTOR     (2.0/3.0)
+// The table is resized when it would be fuller than MAX_LOAD_NUM /
+// MAX_LOAD_DEN, with integers so the comparison is exact
+#define MAX_LOAD_NUM    3
+#define MAX_LOAD_DEN    4
 
-/* Initialize the dictionary's table.
-   The buckets are initialized. Each bucket has a sentinel node.
+/* Return the hash of a key. The keys are usually small and consecutive (GPIO
+   pins, process ids), the hash spreads them so a stride of keys doesn't fall
+   in the same slots.
 
    Parameters:
-     * table: the dictionary's table to be initialized.
+     * key: the key.
+*/
+static size_t
+dictint_hash(int key)
+{
+    uint32_t h = (uint32_t)key * 0x9e3779b9;
+
+    return h ^ (h >> 16);
+}
+
+/* Allocate an empty table for the dictionary, from its arena if it has one.
+
+   Parameters:
+     * d: the dictionary.
      * size: size of the table.
 
-   Return 0 if the table is correctly initialized, 1 otherwise.
+   Return the table, or NULL in case of error.
 */
-static int
-dictint_init_table(struct bucket_t *table, size_t size)
+static struct dictint_slot_t*
+dictint_alloc_table(struct dictint_t *d, size_t size)
 {
-    struct dictint_node_t *sentinel;
+    struct dictint_slot_t *table;
 
-    for (int i = 0; i < size; i++) {
-        sentinel = (struct dictint_node_t*)malloc(
-            sizeof(struct dictint_node_t));
-        if (!sentinel) {
-            return 1;
-        }
-        sentinel->next = NULL;
-        table[i].first = sentinel;
-        table[i].last = sentinel;
+    if (d->arena) {
+        table = (struct dictint_slot_t*)arena_alloc(d->arena,
+            sizeof(struct dictint_slot_t) * size);
+    } else {
+        table = (struct dictint_slot_t*)malloc(
+            sizeof(struct dictint_slot_t) * size);
     }
-    return 0;
+    if (table) {
+        memset(table, 0, sizeof(struct dictint_slot_t) * size);
+    }
+    return table;
 }
 
 /* Initialize the dictionary.
 
    Parameters:
      * d: the dictionary to initialize.
+     * a: the arena where the table is allocated, or NULL to allocate it with
+         malloc.
 
    Return 0 if the initialization was correct, 1 otherwise, and errno is set
    accordingly.
 */
 int
-dictint_init(struct dictint_t *d)
+dictint_init(struct dictint_t *d, struct arena_t *a)
 {
-    // Allocate the dictionary's table
-    d->table_size = DICTINT_INIT_SIZE;
-    d->table = (struct bucket_t*)malloc(
-        sizeof(struct bucket_t) * d->table_size);
-    if (!d->table) {
-        return 1;
-    }
-    // Initialize the dictionary's table
-    // The bucketsare initialized with a sentinel
+    d->arena = a;
     d->numelems = 0;
-    if (dictint_init_table(d->table, DICTINT_INIT_SIZE)) {
-        return 1;
+    d->table = dictint_alloc_table(d, DICTINT_INIT_SIZE);
+    d->table_size = d->table ? DICTINT_INIT_SIZE : 0;
+    return d->table ? 0 : 1;
+}
+
+/* Insert an element in a table. The key must not be in the table, and the
+   table must have a free slot.
+
+   Parameters:
+     * table: the table.
+     * size: size of the table.
+     * key: the element's key.
+     * val: the element's value.
+*/
+static void
+dictint_insert(struct dictint_slot_t *table, size_t size, int key, void *val)
+{
+    struct dictint_slot_t s = {key, 1, val}, t;
+    size_t mask = size - 1, i = dictint_hash(key) & mask;
+
+    while (table[i].dist) {
+        // The element in the slot is nearer to its home slot than the one
+        // being inserted, so it gives its place and is inserted further
+        if (table[i].dist < s.dist) {
+            t = table[i];
+            table[i] = s;
+            s = t;
+        }
+        i = (i + 1) & mask;
+        s.dist++;
     }
-    return 0;
+    table[i] = s;
 }
 
-/* Creates a new node with a given pair key/val and inserts it into the given
-   bucket of the given table.
+/* Resize the table and rehash its elements.
 
    Parameters:
-     * table: the table where to add the new node.
-     * bucket: the index of the bucket where to add the new node.
-     * key: new element's key.
-     * val: new element's value.
+     * d: the dictionary.
+     * size: the new size of the table, a power of 2 greater than the number
+         of elements.
 
-   Return 0 if the new element is correctly added, 1 otherwise.
+   Return 0 if the rehashing is correctly done, 1 otherwise.
 */
 static int
-dictint_add_node(struct bucket_t *table, int bucket, int key, void *val)
+dictint_rehash(struct dictint_t *d, size_t size)
 {
-    struct dictint_node_t *n;
+    struct dictint_slot_t *table;
 
-    // Allocate a new node
-    n = (struct dictint_node_t*)malloc(sizeof(struct dictint_node_t));
-    if (!n) {
+    table = dictint_alloc_table(d, size);
+    if (!table) {
         return 1;
     }
-    // Initialize the node
-    n->next = NULL;
-    n->key = key;
-    n->value = val;
-    // Insert the node in the corresponding bucket
-    table[bucket].last->next = n;
-    table[bucket].last = n;
+    for (size_t i = 0; i < d->table_size; i++) {
+        if (d->table[i].dist) {
+            dictint_insert(table, size, d->table[i].key, d->table[i].value);
+        }
+    }
+    // The old table stays in the arena until the arena is freed
+    if (!d->arena) {
+        free(d->table);
+    }
+    d->table = table;
+    d->table_size = size;
     return 0;
 }
 
-/* Resize the table (multiply its size by 2) and rehash its elements.
+/* Return the size of the table needed for a number of elements, doubling a
+   size until they fit.
+
+   Parameters:
+     * size: the initial size.
+     * n: the number of elements.
+*/
+static size_t
+dictint_table_size(size_t size, size_t n)
+{
+    while (n * MAX_LOAD_DEN > size * MAX_LOAD_NUM) {
+        size *= 2;
+    }
+    return size;
+}
+
+/* Make room for a number of elements, so they can be added without
+   resizing the table.
 
    Parameters:
      * d: the dictionary.
+     * n: the number of elements that the dictionary must hold.
 
-   Return 0 if the rehashing is correctly done, 1 otherwise.
+   Return 0 if the dictionary has room for the elements, 1 otherwise, and
+   errno is set accordingly.
 */
-static int
-dictint_rehash(struct dictint_t* d)
+int
+dictint_reserve(struct dictint_t *d, size_t n)
 {
-    struct bucket_t *new_table;
-    size_t new_size;
-    struct dictint_iterator_t it;
-    int key, bucket;
-    void *val;
+    size_t size = dictint_table_size(
+        d->table_size ? d->table_size : DICTINT_INIT_SIZE, n);
 
-    // Resize is done when load factor (number of elements divided by number
-    // of buckets) is greater than MAX_LOAD_FACTOR.
-    if (d->numelems/d->table_size > MAX_LOAD_FACTOR) {
-        // Alocate the new table
-        new_size = d->table_size * 2;
-        new_table = (struct bucket_t*)malloc(
-            sizeof(struct bucket_t) * new_size);
-        if (!new_table) {
-            return 1;
-        }
-        // Initialize the new table
-        if (dictint_init_table(new_table, new_size)) {
-            return 1;
-        }
-        // Rehash the table
-        dictint_iterator_begin(d, &it);
-        while (dictint_iterator_next(&it, &key, &val)) {
-            if (!dictint_add_node(new_table, key & (new_size - 1), key, val)) {
-                return 1;
-            }
-        }
-        // Update the dictionary with the new table
-        free(d->table);
-        d->table = new_table;
-        d->table_size = new_size;
+    if (size == d->table_size) {
+        return 0;
     }
-    return 0;
+    return dictint_rehash(d, size);
+}
+
+/* Return the bytes that a dictionary initialized in an arena and then
+   reserved for a number of elements takes from the arena, the table of
+   dictint_init included.
+
+   Parameters:
+     * n: the number of elements reserved.
+*/
+size_t
+dictint_arena_size(size_t n)
+{
+    size_t size = dictint_table_size(DICTINT_INIT_SIZE, n);
+
+    return ARENA_SIZE(sizeof(struct dictint_slot_t) * DICTINT_INIT_SIZE)
+        + (size > DICTINT_INIT_SIZE
+            ? ARENA_SIZE(sizeof(struct dictint_slot_t) * size) : 0);
 }
 
-/* Return the node with the given key, that must be in the given bucket.
+/* Return the slot of the element with the given key, or NULL if the element
+   is not in the dictionary.
 
    Parameters:
      * d: the dictionary.
-     * bucket: the bucket index where the node must be searched.
-     * key: the key of the node being search.
+     * key: the key of the element being searched.
 */
-static struct dictint_node_t*
-dictint_get_node(struct dictint_t *d, int bucket, int key)
+static struct dictint_slot_t*
+dictint_find(struct dictint_t *d, int key)
 {
-    struct dictint_node_t *n = d->table[bucket].first->next;
+    size_t mask = d->table_size - 1, i;
 
-    while (n) {
-        if (n->key == key) {
-            break;
+    if (!d->table_size) {
+        return NULL;
+    }
+    i = dictint_hash(key) & mask;
+    // The elements that are further from their home slot than the key would
+    // be are before it, so the search stops at the first one that is nearer
+    for (unsigned int dist = 1; d->table[i].dist >= dist; dist++) {
+        if (d->table[i].key == key) {
+            return &(d->table[i]);
         }
-        n = n->next;
+        i = (i + 1) & mask;
     }
-    return n;
+    return NULL;
 }
 
-/* Adds an element to the dictionary.
+/* Adds an element to the dictionary. If an element with the same key is
+   already in the dictionary, its value is replaced.
 
    Parameters:
      * d: the dictionary.
      * key: the element's key.
      * elem: the element to add.
 
-   Return 0 if the element is correctly added, -1 otherwise. In the latter
-   case, errno is set accordingly.
+   Return 0 if the element is correctly added, 1 otherwise, and errno is set
+   accordingly.
 */
 int
 dictint_add(struct dictint_t *d, int key, void *elem)
 {
-    struct dictint_node_t *n;
-    int bucket;
+    struct dictint_slot_t *s;
 
-    // Rehash the table
-    if (dictint_rehash(d)) {
+    s = dictint_find(d, key);
+    if (s) {
+        // An element with the same key exists, replace the value
+        s->value = elem;
+        return 0;
+    }
+    if (dictint_reserve(d, d->numelems + 1)) {
         return 1;
     }
-    // Search a node with the given key
-    bucket = key & (d->table_size - 1);
-    n = dictint_get_node(d, bucket, key);
-    if (n) {
-        // A node with the same key exists, replace the value
-        n->value = elem;
-    } else {
-        // No node with this key exists, create a new one
-        if (dictint_add_node(d->table, bucket, key, elem)) {
+    dictint_insert(d->table, d->table_size, key, elem);
+    d->numelems++;
+    return 0;
+}
+
+/* Add many elements to the dictionary at once. The table is resized once,
+   before adding them.
+
+   Parameters:
+     * d: the dictionary.
+     * keys: the keys of the elements.
+     * elems: the elements, in the same order than their keys.
+     * n: the number of elements.
+
+   Return 0 if the elements are correctly added, 1 otherwise, and errno is
+   set accordingly.
+*/
+int
+dictint_build(struct dictint_t *d, const int *keys, void *const *elems,
+    size_t n)
+{
+    if (dictint_reserve(d, d->numelems + n)) {
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (dictint_add(d, keys[i], elems[i])) {
             return 1;
         }
     }
-    d->numelems++;
     return 0;
 }
 
@@ -228,35 +307,66 @@ dictint_add(struct dictint_t *d, int key, void *elem)
 void*
 dictint_get(struct dictint_t *d, int key)
 {
-    struct dictint_node_t *n;
+    struct dictint_slot_t *s = dictint_find(d, key);
 
-    n = dictint_get_node(d, key & (d->table_size - 1), key);
-    if (n) {
-        return n->value;
+    return s ? s->value : NULL;
+}
+
+/* Remove an element from the dictionary given its key.
+
+   Parameters:
+     * d: the dictionary.
+     * key: the key of the element to remove.
+
+   Return the removed element, or NULL if the element was not in the
+   dictionary.
+*/
+void*
+dictint_remove(struct dictint_t *d, int key)
+{
+    struct dictint_slot_t *s = dictint_find(d, key);
+    size_t mask = d->table_size - 1, i, next;
+    void *val;
+
+    if (!s) {
+        return NULL;
     }
-    return NULL;
+    val = s->value;
+    // The elements that follow are moved back one slot, until one that is
+    // in its home slot, so no tombstone is left
+    i = s - d->table;
+    next = (i + 1) & mask;
+    while (d->table[next].dist > 1) {
+        d->table[i] = d->table[next];
+        d->table[i].dist--;
+        i = next;
+        next = (next + 1) & mask;
+    }
+    d->table[i].dist = 0;
+    d->numelems--;
+    return val;
 }
 
-/* Return an iterator to iterate over the elements in the dictionary.
+/* Return an iterator to iterate over the elements in the dictionary. The
+   dictionary must not be changed while it is iterated.
 
    Parameters:
      * d: the dictionary to iterate.
-     * i: output parameter that contains the iterator pointing before the first
+     * i: output parameter that contains the iterator pointing to the first
          element.
 */
 void
 dictint_iterator_begin(struct dictint_t *d, struct dictint_iterator_t *i)
 {
     i->d = d;
-    i->bucket = 0;
-    i->node = d->table[0].first;
+    i->slot = 0;
 }
 
 /* Return the next element pointed by the iterator i. Increments the position
    of the iterator.
 
    Parameters:
-     * i: the iterator. At output, the iterator points to the returned element.
+     * i: the iterator. At output, the iterator points to the next element.
      * key: output parameter that contains the current element's key.
      * value: output parameter that contains the current element's value.
 
@@ -265,28 +375,18 @@ dictint_iterator_begin(struct dictint_t *d, struct dictint_iterator_t *i)
 int
 dictint_iterator_next(struct dictint_iterator_t *i, int *key, void **value)
 {
-    // If there's no more buckets, stop iteration
-    if (i->bucket >= i->d->table_size) {
-        return 0;
-    }
-    while (1) {
-        i->node = i->node->next;
-        if (!i->node) {
-            // No more nodes in this bucket, go to the next bucket
-            i->bucket++;
-            if (i->bucket < i->d->table_size) {
-                i->node = i->d->table[i->bucket].first;
-            } else {
-                // No more buckets, stop iteration
-                return 0;
-            }
-        } else {
-            // Found next node
-            *key = i->node->key;
-            *value = i->node->value;
+    struct dictint_slot_t *s;
+
+    // A dictionary freed, or not initialized, has no table
+    while (i->slot < i->d->table_size) {
+        s = &(i->d->table[i->slot++]);
+        if (s->dist) {
+            *key = s->key;
+            *value = s->value;
             return 1;
         }
     }
+    return 0;
 }
 
 /* Return the number of elements in the dictionary.
@@ -300,3 +400,20 @@ dictint_size(struct dictint_t *d)
     return d->numelems;
 }
 
+/* Free the memory used by the dictionary. The values are not freed, and a
+   table allocated from an arena is freed with the arena.
+
+   Parameters:
+     * d: the dictionary.
+*/
+void
+dictint_free(struct dictint_t *d)
+{
+    if (!d->arena) {
+        free(d->table);
+    }
+    d->table = NULL;
+    d->table_size = 0;
+    d->numelems = 0;
+}
+
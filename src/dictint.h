@@ -25,39 +25,42 @@
 #ifndef DICTINT_H
 #define DICTINT_H
 
-#include "list.h"
+#include "arena.h"
 
 #include <sys/types.h>  // size_t
 
-struct dictint_node_t {
-    // The next element
-    struct dictint_node_t *next;
-
+// Slot of the table of the dictionary. The key and the value are in the
+// table, so a lookup reads a single cache line when the element is in its
+// home slot or near it.
+struct dictint_slot_t {
     // The key
     int key;
 
+    // Distance from the home slot of the key plus 1, 0 if the slot is empty
+    unsigned int dist;
+
     // The value
     void *value;
 };
 
-struct bucket_t {
-    // The first element in this bucket
-    struct dictint_node_t *first;
-
-    // The last element in this bucket
-    struct dictint_node_t *last;
-};
-
-// Dictionary of int keys
+// Dictionary of int keys. It is a hash table with open addressing: an
+// element is in the first free slot after its home slot (linear probing),
+// but an element far from its home slot takes the place of one that is
+// nearer to its own (Robin Hood hashing), so the elements are never far from
+// their home slot and a lookup of a key that is not in the dictionary stops
+// early.
 struct dictint_t {
-    // A dynamic array of lists
-    struct bucket_t *table;
+    // The table
+    struct dictint_slot_t *table;
 
-    // Size of the array
+    // Size of the table, a power of 2
     size_t table_size;
 
     // Number of elements in the dictionary
     size_t numelems;
+
+    // Arena of the table, NULL if it is allocated with malloc
+    struct arena_t *arena;
 };
 
 // Type used to iterate over the elements of the dictionary
@@ -65,37 +68,76 @@ struct dictint_iterator_t {
     // Dictionary being iterated
     struct dictint_t *d;
 
-    // Current bucket
-    int bucket;
-
-    // Current node
-    struct dictint_node_t *node;
+    // Next slot
+    size_t slot;
 };
 
 /* Initialize the dictionary.
 
    Parameters:
      * d: the dictionary to initialize.
+     * a: the arena where the table is allocated, or NULL to allocate it with
+         malloc.
 
    Return 0 if the initialization was correct, 1 otherwise, and errno is set
    accordingly.
 */
 int
-dictint_init(struct dictint_t *d);
+dictint_init(struct dictint_t *d, struct arena_t *a);
+
+/* Make room for a number of elements, so they can be added without
+   resizing the table.
+
+   Parameters:
+     * d: the dictionary.
+     * n: the number of elements that the dictionary must hold.
+
+   Return 0 if the dictionary has room for the elements, 1 otherwise, and
+   errno is set accordingly.
+*/
+int
+dictint_reserve(struct dictint_t *d, size_t n);
+
+/* Return the bytes that a dictionary initialized in an arena and then
+   reserved for a number of elements takes from the arena, the table of
+   dictint_init included.
 
-/* Adds an element to the dictionary.
+   Parameters:
+     * n: the number of elements reserved.
+*/
+size_t
+dictint_arena_size(size_t n);
+
+/* Adds an element to the dictionary. If an element with the same key is
+   already in the dictionary, its value is replaced.
 
    Parameters:
      * d: the dictionary.
      * key: the element's key.
      * elem: the element to add.
 
-   Return 0 if the element is correctly added, -1 otherwise. In the latter
-   case, errno is set accordingly.
+   Return 0 if the element is correctly added, 1 otherwise, and errno is set
+   accordingly.
 */
 int
 dictint_add(struct dictint_t *d, int key, void *elem);
 
+/* Add many elements to the dictionary at once. The table is resized once,
+   before adding them.
+
+   Parameters:
+     * d: the dictionary.
+     * keys: the keys of the elements.
+     * elems: the elements, in the same order than their keys.
+     * n: the number of elements.
+
+   Return 0 if the elements are correctly added, 1 otherwise, and errno is
+   set accordingly.
+*/
+int
+dictint_build(struct dictint_t *d, const int *keys, void *const *elems,
+    size_t n);
+
 /* Return an element of the dictionary given its key, or NULL if the element is
    not in the dictionary.
 
@@ -106,7 +148,20 @@ dictint_add(struct dictint_t *d, int key, void *elem);
 void *
 dictint_get(struct dictint_t *d, int key);
 
-/* Return an iterator to iterate over the elements in the dictionary.
+/* Remove an element from the dictionary given its key.
+
+   Parameters:
+     * d: the dictionary.
+     * key: the key of the element to remove.
+
+   Return the removed element, or NULL if the element was not in the
+   dictionary.
+*/
+void *
+dictint_remove(struct dictint_t *d, int key);
+
+/* Return an iterator to iterate over the elements in the dictionary. The
+   dictionary must not be changed while it is iterated.
 
    Parameters:
      * d: the dictionary to iterate.
@@ -137,5 +192,14 @@ dictint_iterator_next(struct dictint_iterator_t *i, int *key, void **value);
 size_t
 dictint_size(struct dictint_t *d);
 
+/* Free the memory used by the dictionary. The values are not freed, and a
+   table allocated from an arena is freed with the arena.
+
+   Parameters:
+     * d: the dictionary.
+*/
+void
+dictint_free(struct dictint_t *d);
+
 #endif
 
@@ -0,0 +1,147 @@
+/* fakechip.c
+   A fake GPIO chip that counts the writes of the output lines, to check that
+   the lines changed at the same time are set with a single system call.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "fakechip.h"
+
+#include <linux/gpio.h> // GPIO_V2_GET_LINE_IOCTL
+#include <stdarg.h>     // va_list
+#include <sys/syscall.h>    // SYS_ioctl
+#include <unistd.h>     // dup
+
+// Maximum number of line requests counted
+#define FAKECHIP_REQUESTS   16
+
+// Descriptors of the line requests and number of them
+static int requests[FAKECHIP_REQUESTS];
+static unsigned int nrequests = 0;
+
+// Times that each request was set in the current tick
+static unsigned int writes[FAKECHIP_REQUESTS];
+
+// Values of the lines of each request
+static uint64_t values[FAKECHIP_REQUESTS];
+
+/* Count a write of the lines of a request, and keep their values.
+
+   Parameters:
+     * fd: the descriptor of the line request.
+     * v: the values written.
+*/
+static void
+set_values(int fd, const struct gpio_v2_line_values *v)
+{
+    for (unsigned int i = 0; i < nrequests; i++) {
+        if (requests[i] == fd) {
+            writes[i]++;
+            values[i] = (values[i] & ~v->mask) | (v->bits & v->mask);
+            return;
+        }
+    }
+}
+
+/* Replace the ioctl of the C library. The line requests get a copy of the
+   descriptor of the chip and their values are only kept and counted, the
+   other requests go to the kernel.
+
+   Parameters:
+     * fd: the descriptor.
+     * request: the request.
+     * ...: the argument of the request.
+
+   Return 0 on success, -1 in case of error, and errno is set accordingly.
+*/
+int
+ioctl(int fd, unsigned long request, ...)
+{
+    struct gpio_v2_line_request *req;
+    va_list ap;
+    void *arg;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void*);
+    va_end(ap);
+    switch (request) {
+        case GPIO_V2_GET_LINE_IOCTL:
+            req = (struct gpio_v2_line_request*)arg;
+            req->fd = dup(fd);
+            if (req->fd >= 0 && nrequests < FAKECHIP_REQUESTS) {
+                writes[nrequests] = 0;
+                values[nrequests] = 0;
+                requests[nrequests++] = req->fd;
+            }
+            return req->fd < 0 ? -1 : 0;
+        case GPIO_V2_LINE_SET_VALUES_IOCTL:
+            set_values(fd, (struct gpio_v2_line_values*)arg);
+            return 0;
+        default:
+            return syscall(SYS_ioctl, fd, request, arg);
+    }
+}
+
+/* End a tick of the program, after the lines of the tick are set. The
+   program must be linked with fakechip.c, that replaces ioctl: the line
+   requests of any chip opened are accepted and their values are only kept
+   and counted.
+
+   Parameters:
+     * repeated: at output, 1 if a request of lines was set more than once in
+         the tick, 0 otherwise.
+
+   Return the number of times that the values of any request were set in the
+   tick.
+*/
+unsigned int
+fakechip_end_tick(int *repeated)
+{
+    unsigned int n = 0;
+
+    *repeated = 0;
+    for (unsigned int i = 0; i < nrequests; i++) {
+        n += writes[i];
+        if (writes[i] > 1) {
+            *repeated = 1;
+        }
+        writes[i] = 0;
+    }
+    return n;
+}
+
+/* Return the values of the lines of a request, as set by the program.
+
+   Parameters:
+     * fd: the descriptor of the line request.
+
+   Return the values, the bit i for the i-th line requested, 0 if the request
+   is unknown.
+*/
+uint64_t
+fakechip_values(int fd)
+{
+    for (unsigned int i = 0; i < nrequests; i++) {
+        if (requests[i] == fd) {
+            return values[i];
+        }
+    }
+    return 0;
+}
+
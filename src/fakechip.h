@@ -0,0 +1,56 @@
+/* fakechip.h
+   A fake GPIO chip that counts the writes of the output lines, to check that
+   the lines changed at the same time are set with a single system call.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKECHIP_H
+#define FAKECHIP_H
+
+#include <stdint.h>     // uint64_t
+
+/* End a tick of the program, after the lines of the tick are set. The
+   program must be linked with fakechip.c, that replaces ioctl: the line
+   requests of any chip opened are accepted and their values are only kept
+   and counted.
+
+   Parameters:
+     * repeated: at output, 1 if a request of lines was set more than once in
+         the tick, 0 otherwise.
+
+   Return the number of times that the values of any request were set in the
+   tick.
+*/
+unsigned int
+fakechip_end_tick(int *repeated);
+
+/* Return the values of the lines of a request, as set by the program.
+
+   Parameters:
+     * fd: the descriptor of the line request.
+
+   Return the values, the bit i for the i-th line requested, 0 if the request
+   is unknown.
+*/
+uint64_t
+fakechip_values(int fd);
+
+#endif
+
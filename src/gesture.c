@@ -0,0 +1,174 @@
+/* gesture.c
+   Recognizer of the gestures made with a button: clicks, double and triple
+   clicks, long clicks and hold repeats.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "gesture.h"
+
+// Set a transition of a table
+#define SET(g, s, i, n, e, t) \
+    do { \
+        (g)->table[s][i].next = n; \
+        (g)->table[s][i].event = e; \
+        (g)->table[s][i].timer = t; \
+    } while (0)
+
+/* Build the transition table of a recognizer for the events of a button.
+   Only the events that the button has are recognized, so a click is fired
+   at once when the button has no double or triple clicks, and the timer is
+   only armed while the button is held if it has long clicks or hold
+   repeats.
+
+   Parameters:
+     * g: the recognizer.
+     * types: bit mask of the event types of the button, (1 << type).
+*/
+void
+gesture_compile(struct gesture_t *g, unsigned int types)
+{
+    static const unsigned char down[] =
+        {GESTURE_DOWN1, GESTURE_DOWN2, GESTURE_DOWN3};
+    static const unsigned char up[] = {GESTURE_UP1, GESTURE_UP2};
+    static const signed char clicks[] =
+        {EVENT_CLICK, EVENT_DOUBLE_CLICK, EVENT_TRIPLE_CLICK};
+    unsigned int maxclicks, hold, repeat;
+
+    // By default the inputs are ignored
+    for (int s = 0; s < GESTURE_STATES; s++) {
+        for (int i = 0; i < GESTURE_INPUTS; i++) {
+            SET(g, s, i, s, GESTURE_NO_EVENT, GESTURE_TIMER_NONE);
+        }
+    }
+    // Number of clicks of the longest series to recognize
+    if (types & (1 << EVENT_TRIPLE_CLICK)) {
+        maxclicks = 3;
+    } else if (types & (1 << EVENT_DOUBLE_CLICK)) {
+        maxclicks = 2;
+    } else {
+        maxclicks = 1;
+    }
+    // What to do with the timer when the button is pressed and after a long
+    // click. When the timer is not needed it's cancelled, it may be waiting
+    // for the next click.
+    hold = types & (1 << EVENT_LONG_CLICK | 1 << EVENT_HOLD_REPEAT)
+        ? GESTURE_TIMER_HOLD : GESTURE_TIMER_CANCEL;
+    repeat = types & (1 << EVENT_HOLD_REPEAT)
+        ? GESTURE_TIMER_REPEAT : GESTURE_TIMER_NONE;
+    SET(g, GESTURE_IDLE, GESTURE_PRESS, GESTURE_DOWN1, GESTURE_NO_EVENT, hold);
+    for (unsigned int n = 0; n < maxclicks; n++) {
+        // Held long enough, it's a long click whatever the clicks before
+        SET(g, down[n], GESTURE_HOLD, GESTURE_HELD, EVENT_LONG_CLICK, repeat);
+        if (n == maxclicks - 1) {
+            // The last click of the longest series fires at once
+            SET(g, down[n], GESTURE_RELEASE, GESTURE_IDLE, clicks[n],
+                GESTURE_TIMER_CANCEL);
+        } else {
+            // Wait for the next click, or fire this series after the gap
+            SET(g, down[n], GESTURE_RELEASE, up[n], GESTURE_NO_EVENT,
+                GESTURE_TIMER_GAP);
+            SET(g, up[n], GESTURE_PRESS, down[n + 1], GESTURE_NO_EVENT, hold);
+            SET(g, up[n], GESTURE_GAP, GESTURE_IDLE, clicks[n],
+                GESTURE_TIMER_NONE);
+        }
+    }
+    SET(g, GESTURE_HELD, GESTURE_HOLD, GESTURE_HELD, EVENT_HOLD_REPEAT,
+        repeat);
+    SET(g, GESTURE_HELD, GESTURE_RELEASE, GESTURE_IDLE, GESTURE_NO_EVENT,
+        GESTURE_TIMER_CANCEL);
+    SET(g, GESTURE_CHORD, GESTURE_RELEASE, GESTURE_IDLE, GESTURE_NO_EVENT,
+        GESTURE_TIMER_NONE);
+    g->state = GESTURE_IDLE;
+}
+
+/* Build again the transition table of a recognizer for a new set of event
+   types, keeping the current state. If the state doesn't exist in the new
+   table (a series of clicks longer than the new longest one), a button
+   pressed goes to the first press and a button released goes to idle, and
+   the series is dropped.
+
+   Parameters:
+     * g: the recognizer.
+     * types: bit mask of the new event types of the button, (1 << type).
+*/
+void
+gesture_recompile(struct gesture_t *g, unsigned int types)
+{
+    unsigned char state = g->state;
+    int live = 0;
+
+    gesture_compile(g, types);
+    // A state exists in the new table if some input leaves it
+    for (int i = 0; i < GESTURE_INPUTS; i++) {
+        if (g->table[state][i].next != state) {
+            live = 1;
+        }
+    }
+    if (live) {
+        g->state = state;
+    } else if (state == GESTURE_DOWN2 || state == GESTURE_DOWN3) {
+        g->state = GESTURE_DOWN1;
+    }
+}
+
+/* Feed an input to a recognizer.
+
+   Parameters:
+     * g: the recognizer.
+     * input: the input.
+
+   Return the transition taken, its state is already the current one.
+*/
+const struct gesture_transition_t*
+gesture_step(struct gesture_t *g, enum gesture_input_t input)
+{
+    const struct gesture_transition_t *t = &(g->table[g->state][input]);
+
+    g->state = t->next;
+    return t;
+}
+
+/* Return 1 if the button is pressed and the long click was not fired yet, 0
+   otherwise.
+
+   Parameters:
+     * g: the recognizer.
+*/
+int
+gesture_is_down(const struct gesture_t *g)
+{
+    return g->state == GESTURE_DOWN1 || g->state == GESTURE_DOWN2
+        || g->state == GESTURE_DOWN3;
+}
+
+/* Mark the button as part of a chord that was fired, so it doesn't fire any
+   other event until it is released. The timer of the button must be
+   cancelled.
+
+   Parameters:
+     * g: the recognizer.
+*/
+void
+gesture_consume(struct gesture_t *g)
+{
+    g->state = GESTURE_CHORD;
+}
+
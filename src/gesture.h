@@ -0,0 +1,149 @@
+/* gesture.h
+   Recognizer of the gestures made with a button: clicks, double and triple
+   clicks, long clicks and hold repeats.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GESTURE_H
+#define GESTURE_H
+
+// Enumeration of event types.
+// Event types are the different events that a button can generate:
+//   * Short click (or simply, click), fired when the button is released.
+//   * Double and triple clicks, fired when the button is released for the
+//     second or third time in a row.
+//   * Long click, fired when the button has been held the long click time.
+//   * Hold repeat, fired periodically while the button is held after the
+//     long click.
+//   * Chord, fired when several buttons are pressed together (it isn't
+//     generated by the recognizer of a single button).
+enum event_type_t {EVENT_CLICK, EVENT_DOUBLE_CLICK, EVENT_TRIPLE_CLICK,
+    EVENT_LONG_CLICK, EVENT_HOLD_REPEAT, EVENT_CHORD};
+
+// Number of event types
+#define EVENT_TYPES 6
+
+// Event of the transitions that don't fire any event
+#define GESTURE_NO_EVENT    (-1)
+
+// States of the recognizer: the button is released (idle), pressed or
+// released after the Nth click of a series, held after the long click, or
+// part of a chord that was fired.
+enum gesture_state_t {GESTURE_IDLE, GESTURE_DOWN1, GESTURE_UP1, GESTURE_DOWN2,
+    GESTURE_UP2, GESTURE_DOWN3, GESTURE_HELD, GESTURE_CHORD};
+
+// Number of states
+#define GESTURE_STATES  8
+
+// Inputs of the recognizer: the edges of the button and the expiration of
+// its timer, while it is held (hold) or while it waits for the next click of
+// a series (gap).
+enum gesture_input_t {GESTURE_PRESS, GESTURE_RELEASE, GESTURE_HOLD,
+    GESTURE_GAP};
+
+// Number of inputs
+#define GESTURE_INPUTS  4
+
+// What to do with the timer of the button in a transition: nothing, arm it
+// for the long click, for the gap between clicks or for the next hold
+// repeat, or cancel it.
+enum gesture_timer_t {GESTURE_TIMER_NONE, GESTURE_TIMER_HOLD,
+    GESTURE_TIMER_GAP, GESTURE_TIMER_REPEAT, GESTURE_TIMER_CANCEL};
+
+// A transition of the recognizer
+struct gesture_transition_t {
+    // The next state
+    unsigned char next;
+
+    // The event fired, or GESTURE_NO_EVENT
+    signed char event;
+
+    // What to do with the timer
+    unsigned char timer;
+};
+
+// The recognizer of a button
+struct gesture_t {
+    // Transition table, indexed by state and input
+    struct gesture_transition_t table[GESTURE_STATES][GESTURE_INPUTS];
+
+    // Current state
+    unsigned char state;
+};
+
+/* Build the transition table of a recognizer for the events of a button.
+   Only the events that the button has are recognized, so a click is fired
+   at once when the button has no double or triple clicks, and the timer is
+   only armed while the button is held if it has long clicks or hold
+   repeats.
+
+   Parameters:
+     * g: the recognizer.
+     * types: bit mask of the event types of the button, (1 << type).
+*/
+void
+gesture_compile(struct gesture_t *g, unsigned int types);
+
+/* Build again the transition table of a recognizer for a new set of event
+   types, keeping the current state. If the state doesn't exist in the new
+   table (a series of clicks longer than the new longest one), a button
+   pressed goes to the first press and a button released goes to idle, and
+   the series is dropped.
+
+   Parameters:
+     * g: the recognizer.
+     * types: bit mask of the new event types of the button, (1 << type).
+*/
+void
+gesture_recompile(struct gesture_t *g, unsigned int types);
+
+/* Feed an input to a recognizer.
+
+   Parameters:
+     * g: the recognizer.
+     * input: the input.
+
+   Return the transition taken, its state is already the current one.
+*/
+const struct gesture_transition_t*
+gesture_step(struct gesture_t *g, enum gesture_input_t input);
+
+/* Return 1 if the button is pressed and the long click was not fired yet, 0
+   otherwise.
+
+   Parameters:
+     * g: the recognizer.
+*/
+int
+gesture_is_down(const struct gesture_t *g);
+
+/* Mark the button as part of a chord that was fired, so it doesn't fire any
+   other event until it is released. The timer of the button must be
+   cancelled.
+
+   Parameters:
+     * g: the recognizer.
+*/
+void
+gesture_consume(struct gesture_t *g);
+
+#endif
+
@@ -0,0 +1,222 @@
+/* gpiocdev.c
+   Access to the GPIO lines through the character device interface (uAPI v2).
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "gpiocdev.h"
+
+#include <errno.h>      // errno
+#include <fcntl.h>      // open
+#include <string.h>     // memset
+#include <sys/ioctl.h>  // ioctl
+#include <unistd.h>     // read
+
+/* Open a GPIO chip.
+
+   Parameters:
+     * path: path of the chip's character device (/dev/gpiochipN).
+
+   Return the file descriptor of the chip, or -1 in case of error, and errno
+   is set accordingly.
+*/
+int
+gpiocdev_open_chip(const char *path)
+{
+    return open(path, O_RDWR | O_CLOEXEC);
+}
+
+/* Request a line as an input that reports both edges.
+
+   Parameters:
+     * chip: file descriptor of the chip.
+     * offset: offset of the line in the chip.
+     * consumer: label of the consumer of the line.
+     * debounce: debounce period in microseconds, or 0 for no debounce.
+     * debounced: at output, 1 if the kernel debounces the line, 0 if the
+         debounce period was not accepted by the kernel and the line was
+         requested without it.
+
+   Return the file descriptor of the line request, from where the edge events
+   are read, or -1 in case of error, and errno is set accordingly.
+*/
+int
+gpiocdev_request_input(int chip, unsigned int offset, const char *consumer,
+    unsigned int debounce, int *debounced)
+{
+    struct gpio_v2_line_request req;
+    int e;
+
+    memset(&req, 0, sizeof(req));
+    req.offsets[0] = offset;
+    req.num_lines = 1;
+    strncpy(req.consumer, consumer, sizeof(req.consumer) - 1);
+    req.config.flags = GPIO_V2_LINE_FLAG_INPUT
+        | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    *debounced = 0;
+    if (debounce) {
+        req.config.num_attrs = 1;
+        req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+        req.config.attrs[0].attr.debounce_period_us = debounce;
+        req.config.attrs[0].mask = 1;
+        if (!ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &req)) {
+            *debounced = 1;
+            goto requested;
+        }
+        // Old kernels don't know the debounce attribute and some chips
+        // cannot debounce, try again without it
+        if (errno != EINVAL && errno != EOPNOTSUPP) {
+            return -1;
+        }
+        req.config.num_attrs = 0;
+    }
+    if (ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &req)) {
+        return -1;
+    }
+requested:
+    // The events are read until there's no more, so don't block
+    if (fcntl(req.fd, F_SETFL, O_NONBLOCK)) {
+        e = errno;
+        close(req.fd);
+        errno = e;
+        return -1;
+    }
+    return req.fd;
+}
+
+/* Change the debounce period of a line already requested as an input that
+   reports both edges. The edges queued are kept.
+
+   Parameters:
+     * fd: file descriptor of the line request.
+     * debounce: debounce period in microseconds, or 0 for no debounce.
+     * debounced: at output, 1 if the kernel debounces the line, 0 if the
+         debounce period was not accepted by the kernel and the line was
+         configured without it.
+
+   Return 0 if the line was configured, -1 in case of error, and errno is set
+   accordingly.
+*/
+int
+gpiocdev_set_debounce(int fd, unsigned int debounce, int *debounced)
+{
+    struct gpio_v2_line_config cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.flags = GPIO_V2_LINE_FLAG_INPUT
+        | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    *debounced = 0;
+    if (debounce) {
+        cfg.num_attrs = 1;
+        cfg.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+        cfg.attrs[0].attr.debounce_period_us = debounce;
+        cfg.attrs[0].mask = 1;
+        if (!ioctl(fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &cfg)) {
+            *debounced = 1;
+            return 0;
+        }
+        // As when the line is requested, try again without the debounce
+        if (errno != EINVAL && errno != EOPNOTSUPP) {
+            return -1;
+        }
+        cfg.num_attrs = 0;
+    }
+    return ioctl(fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &cfg) ? -1 : 0;
+}
+
+/* Request a group of lines as outputs, all of them low. The lines are set
+   together afterwards with gpiocdev_set_values.
+
+   Parameters:
+     * chip: file descriptor of the chip.
+     * offsets: offsets of the lines in the chip.
+     * n: number of lines, at most GPIO_V2_LINES_MAX.
+     * consumer: label of the consumer of the lines.
+
+   Return the file descriptor of the line request, or -1 in case of error, and
+   errno is set accordingly.
+*/
+int
+gpiocdev_request_outputs(int chip, const unsigned int *offsets,
+    unsigned int n, const char *consumer)
+{
+    struct gpio_v2_line_request req;
+
+    memset(&req, 0, sizeof(req));
+    for (unsigned int i = 0; i < n; i++) {
+        req.offsets[i] = offsets[i];
+    }
+    req.num_lines = n;
+    strncpy(req.consumer, consumer, sizeof(req.consumer) - 1);
+    req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    req.config.num_attrs = 1;
+    req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    req.config.attrs[0].attr.values = 0;
+    req.config.attrs[0].mask =
+        n == GPIO_V2_LINES_MAX ? UINT64_MAX : (1ULL << n) - 1;
+    if (ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &req)) {
+        return -1;
+    }
+    return req.fd;
+}
+
+/* Set the values of some lines of a request, with a single system call.
+
+   Parameters:
+     * fd: file descriptor of the line request.
+     * bits: the values, the bit i is the value of the i-th line requested.
+     * mask: the lines to set, the bit i set for the i-th line requested.
+
+   Return 0 if the lines were set, -1 in case of error, and errno is set
+   accordingly.
+*/
+int
+gpiocdev_set_values(int fd, uint64_t bits, uint64_t mask)
+{
+    struct gpio_v2_line_values values;
+
+    values.bits = bits;
+    values.mask = mask;
+    return ioctl(fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) ? -1 : 0;
+}
+
+/* Read the pending edge events of a line request. The descriptor is not
+   blocking, so this function doesn't wait if there's no events.
+
+   Parameters:
+     * fd: file descriptor of the line request.
+     * events: array where the events are stored.
+     * n: maximum number of events to read.
+
+   Return the number of events read, or -1 in case of error, and errno is set
+   accordingly (EAGAIN if there's no events).
+*/
+ssize_t
+gpiocdev_read_events(int fd, struct gpio_v2_line_event *events, size_t n)
+{
+    ssize_t len;
+
+    // The kernel returns as many whole events as fit in the buffer
+    len = read(fd, events, sizeof(struct gpio_v2_line_event) * n);
+    if (len < 0) {
+        return -1;
+    }
+    return len / sizeof(struct gpio_v2_line_event);
+}
+
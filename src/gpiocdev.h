@@ -0,0 +1,119 @@
+/* gpiocdev.h
+   Access to the GPIO lines through the character device interface (uAPI v2).
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GPIOCDEV_H
+#define GPIOCDEV_H
+
+#include <linux/gpio.h> // struct gpio_v2_line_event
+#include <stdint.h>     // uint64_t
+#include <sys/types.h>  // ssize_t
+
+/* Open a GPIO chip.
+
+   Parameters:
+     * path: path of the chip's character device (/dev/gpiochipN).
+
+   Return the file descriptor of the chip, or -1 in case of error, and errno
+   is set accordingly.
+*/
+int
+gpiocdev_open_chip(const char *path);
+
+/* Request a line as an input that reports both edges.
+
+   Parameters:
+     * chip: file descriptor of the chip.
+     * offset: offset of the line in the chip.
+     * consumer: label of the consumer of the line.
+     * debounce: debounce period in microseconds, or 0 for no debounce.
+     * debounced: at output, 1 if the kernel debounces the line, 0 if the
+         debounce period was not accepted by the kernel and the line was
+         requested without it.
+
+   Return the file descriptor of the line request, from where the edge events
+   are read, or -1 in case of error, and errno is set accordingly.
+*/
+int
+gpiocdev_request_input(int chip, unsigned int offset, const char *consumer,
+    unsigned int debounce, int *debounced);
+
+/* Change the debounce period of a line already requested as an input that
+   reports both edges. The edges queued are kept.
+
+   Parameters:
+     * fd: file descriptor of the line request.
+     * debounce: debounce period in microseconds, or 0 for no debounce.
+     * debounced: at output, 1 if the kernel debounces the line, 0 if the
+         debounce period was not accepted by the kernel and the line was
+         configured without it.
+
+   Return 0 if the line was configured, -1 in case of error, and errno is set
+   accordingly.
+*/
+int
+gpiocdev_set_debounce(int fd, unsigned int debounce, int *debounced);
+
+/* Request a group of lines as outputs, all of them low. The lines are set
+   together afterwards with gpiocdev_set_values.
+
+   Parameters:
+     * chip: file descriptor of the chip.
+     * offsets: offsets of the lines in the chip.
+     * n: number of lines, at most GPIO_V2_LINES_MAX.
+     * consumer: label of the consumer of the lines.
+
+   Return the file descriptor of the line request, or -1 in case of error, and
+   errno is set accordingly.
+*/
+int
+gpiocdev_request_outputs(int chip, const unsigned int *offsets,
+    unsigned int n, const char *consumer);
+
+/* Set the values of some lines of a request, with a single system call.
+
+   Parameters:
+     * fd: file descriptor of the line request.
+     * bits: the values, the bit i is the value of the i-th line requested.
+     * mask: the lines to set, the bit i set for the i-th line requested.
+
+   Return 0 if the lines were set, -1 in case of error, and errno is set
+   accordingly.
+*/
+int
+gpiocdev_set_values(int fd, uint64_t bits, uint64_t mask);
+
+/* Read the pending edge events of a line request. The descriptor is not
+   blocking, so this function doesn't wait if there's no events.
+
+   Parameters:
+     * fd: file descriptor of the line request.
+     * events: array where the events are stored.
+     * n: maximum number of events to read.
+
+   Return the number of events read, or -1 in case of error, and errno is set
+   accordingly (EAGAIN if there's no events).
+*/
+ssize_t
+gpiocdev_read_events(int fd, struct gpio_v2_line_event *events, size_t n);
+
+#endif
+
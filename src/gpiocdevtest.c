@@ -0,0 +1,378 @@
+/* gpiocdevtest.c
+   Test of the access to the GPIO character device, against a fake chip.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <err.h>        // errx
+#include <errno.h>      // errno
+#include <fcntl.h>      // fcntl
+#include <stdarg.h>     // va_list
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // printf
+#include <string.h>     // strcmp
+#include <unistd.h>     // pipe
+
+#include "gpiocdev.h"
+
+#define PROGNAME    "gpiocdevtest"
+
+// Descriptor given as the one of the chip, only the fake ioctl sees it
+#define FAKE_CHIP   1000
+
+// Fail the test if a condition doesn't hold
+#define CHECK(c)    do { \
+        if (!(c)) { \
+            errx(1, "%s:%d: check failed: %s", __FILE__, __LINE__, #c); \
+        } \
+    } while (0)
+
+// Last line request received by the fake chip
+struct gpio_v2_line_request last_request;
+
+// Last configuration set to a line
+struct gpio_v2_line_config last_config;
+
+// Last values set to the lines of a request, and number of times set
+struct gpio_v2_line_values last_values;
+unsigned int sets = 0;
+
+// Number of line requests and of configurations received, including the
+// rejected ones
+unsigned int requests = 0, configs = 0;
+
+// Error returned to the requests and configurations with a debounce period,
+// 0 to accept them
+int debounce_error = 0;
+
+// Write end of the pipe given as the last line request, where the test
+// writes the edges that the kernel would queue
+int edges_fd = -1;
+
+/* Return 1 if a line configuration has a debounce period, 0 otherwise.
+
+   Parameters:
+     * cfg: the configuration.
+*/
+int
+has_debounce(const struct gpio_v2_line_config *cfg)
+{
+    for (unsigned int i = 0; i < cfg->num_attrs; i++) {
+        if (cfg->attrs[i].attr.id == GPIO_V2_LINE_ATTR_ID_DEBOUNCE) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* The fake chip. It replaces the ioctl of the C library, so gpiocdev.c talks
+   to it instead of the kernel. The line requests are pipes, so the edges
+   written by the test are read as the kernel's ones.
+
+   Parameters:
+     * fd: the descriptor of the chip or of a line request.
+     * request: the request.
+     * ...: the argument of the request.
+
+   Return 0 on success, -1 in case of error, and errno is set accordingly.
+*/
+int
+ioctl(int fd, unsigned long request, ...)
+{
+    struct gpio_v2_line_request *req;
+    va_list ap;
+    void *arg;
+    int p[2];
+
+    va_start(ap, request);
+    arg = va_arg(ap, void*);
+    va_end(ap);
+    switch (request) {
+        case GPIO_V2_GET_LINE_IOCTL:
+            req = (struct gpio_v2_line_request*)arg;
+            CHECK(fd == FAKE_CHIP);
+            requests++;
+            last_request = *req;
+            if (debounce_error && has_debounce(&(req->config))) {
+                errno = debounce_error;
+                return -1;
+            }
+            if (pipe(p)) {
+                return -1;
+            }
+            req->fd = p[0];
+            edges_fd = p[1];
+            return 0;
+        case GPIO_V2_LINE_SET_CONFIG_IOCTL:
+            configs++;
+            last_config = *(struct gpio_v2_line_config*)arg;
+            if (debounce_error && has_debounce(&last_config)) {
+                errno = debounce_error;
+                return -1;
+            }
+            return 0;
+        case GPIO_V2_LINE_SET_VALUES_IOCTL:
+            sets++;
+            last_values = *(struct gpio_v2_line_values*)arg;
+            return 0;
+        default:
+            errno = ENOTTY;
+            return -1;
+    }
+}
+
+/* Check that the last line request is a single input line that reports both
+   edges.
+
+   Parameters:
+     * offset: the offset of the line.
+     * debounce: the debounce period requested (us), 0 for none.
+*/
+void
+check_input_request(unsigned int offset, unsigned int debounce)
+{
+    struct gpio_v2_line_config *cfg = &(last_request.config);
+
+    CHECK(last_request.num_lines == 1);
+    CHECK(last_request.offsets[0] == offset);
+    CHECK(!strcmp(last_request.consumer, PROGNAME));
+    CHECK(cfg->flags == (GPIO_V2_LINE_FLAG_INPUT
+        | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING));
+    if (!debounce) {
+        CHECK(cfg->num_attrs == 0);
+        return;
+    }
+    CHECK(cfg->num_attrs == 1);
+    CHECK(cfg->attrs[0].attr.id == GPIO_V2_LINE_ATTR_ID_DEBOUNCE);
+    CHECK(cfg->attrs[0].attr.debounce_period_us == debounce);
+    CHECK(cfg->attrs[0].mask == 1);
+}
+
+/* Request a line through gpiocdev_request_input and check the result.
+
+   Parameters:
+     * debounce: the debounce period (us).
+     * error: error returned by the chip to the debounce period, 0 if the
+         chip accepts it.
+     * nrequests: number of requests that the chip must receive.
+     * debounced: expected value of the debounced output.
+
+   Return the descriptor of the line request, or -1 if it failed.
+*/
+int
+request_input(unsigned int debounce, int error, unsigned int nrequests,
+    int debounced)
+{
+    int fd, d = -1;
+
+    requests = 0;
+    debounce_error = error;
+    fd = gpiocdev_request_input(FAKE_CHIP, 17, PROGNAME, debounce, &d);
+    CHECK(requests == nrequests);
+    if (fd < 0) {
+        return -1;
+    }
+    CHECK(d == debounced);
+    CHECK(fcntl(fd, F_GETFL) & O_NONBLOCK);
+    return fd;
+}
+
+/* Close a line request of the fake chip.
+
+   Parameters:
+     * fd: the descriptor of the line request.
+*/
+void
+release(int fd)
+{
+    close(fd);
+    close(edges_fd);
+    edges_fd = -1;
+}
+
+// Test the requests of input lines, with and without debounce period
+void
+test_request_input()
+{
+    int fd;
+
+    fd = request_input(0, 0, 1, 0);
+    CHECK(fd >= 0);
+    check_input_request(17, 0);
+    release(fd);
+    fd = request_input(5000, 0, 1, 1);
+    CHECK(fd >= 0);
+    check_input_request(17, 5000);
+    release(fd);
+}
+
+// Test that a debounce period not accepted by the kernel is left to the
+// caller, and that the other errors are reported
+void
+test_debounce_fallback()
+{
+    const int errors[] = {0, EINVAL, EOPNOTSUPP};
+    int fd, e, d;
+
+    // Old kernels
+    fd = request_input(5000, EINVAL, 2, 0);
+    CHECK(fd >= 0);
+    check_input_request(17, 0);
+    release(fd);
+    // Chips that cannot debounce
+    fd = request_input(5000, EOPNOTSUPP, 2, 0);
+    CHECK(fd >= 0);
+    check_input_request(17, 0);
+    release(fd);
+    // The line is used by other process
+    fd = request_input(5000, EBUSY, 1, 0);
+    e = errno;
+    CHECK(fd == -1);
+    CHECK(e == EBUSY);
+    // The same when the line is configured again
+    fd = request_input(0, 0, 1, 0);
+    CHECK(fd >= 0);
+    for (int i = 0; i < 3; i++) {
+        configs = 0;
+        debounce_error = errors[i];
+        d = -1;
+        CHECK(!gpiocdev_set_debounce(fd, 2000, &d));
+        CHECK(d == !errors[i]);
+        CHECK(configs == (errors[i] ? 2u : 1u));
+        CHECK(last_config.num_attrs == (errors[i] ? 0u : 1u));
+    }
+    configs = 0;
+    debounce_error = EBUSY;
+    CHECK(gpiocdev_set_debounce(fd, 2000, &d) == -1);
+    CHECK(errno == EBUSY);
+    CHECK(configs == 1);
+    release(fd);
+}
+
+/* Write an edge to the line request of the fake chip, as the kernel.
+
+   Parameters:
+     * rising: 1 for a rising edge, 0 for a falling one.
+     * timestamp: the time of the edge (ns).
+     * seqno: the sequence number of the edge.
+*/
+void
+write_edge(int rising, uint64_t timestamp, unsigned int seqno)
+{
+    struct gpio_v2_line_event e;
+
+    memset(&e, 0, sizeof(e));
+    e.timestamp_ns = timestamp;
+    e.id = rising ? GPIO_V2_LINE_EVENT_RISING_EDGE
+        : GPIO_V2_LINE_EVENT_FALLING_EDGE;
+    e.offset = 17;
+    e.seqno = seqno;
+    e.line_seqno = seqno;
+    CHECK(write(edges_fd, &e, sizeof(e)) == sizeof(e));
+}
+
+// Test the reading of the edges queued, in batches
+void
+test_read_events()
+{
+    struct gpio_v2_line_event events[4];
+    ssize_t n;
+    int fd;
+
+    fd = request_input(0, 0, 1, 0);
+    CHECK(fd >= 0);
+    // Nothing queued yet
+    CHECK(gpiocdev_read_events(fd, events, 4) == -1);
+    CHECK(errno == EAGAIN);
+    for (unsigned int i = 0; i < 7; i++) {
+        write_edge(!(i % 2), 1000000 * (i + 1), i + 1);
+    }
+    // A full batch, then the rest
+    for (unsigned int i = 0, batch = 0; i < 7; i += n, batch++) {
+        n = gpiocdev_read_events(fd, events, 4);
+        CHECK(n == (batch ? 3 : 4));
+        for (ssize_t j = 0; j < n; j++) {
+            CHECK(events[j].id == (((i + j) % 2) ?
+                GPIO_V2_LINE_EVENT_FALLING_EDGE
+                : GPIO_V2_LINE_EVENT_RISING_EDGE));
+            CHECK(events[j].timestamp_ns == 1000000 * (i + j + 1));
+            CHECK(events[j].offset == 17);
+            CHECK(events[j].line_seqno == i + j + 1);
+        }
+    }
+    CHECK(gpiocdev_read_events(fd, events, 4) == -1);
+    CHECK(errno == EAGAIN);
+    release(fd);
+}
+
+// Test the requests of output lines and the setting of their values
+void
+test_outputs()
+{
+    unsigned int offsets[GPIO_V2_LINES_MAX];
+    struct gpio_v2_line_config *cfg = &(last_request.config);
+    int fd;
+
+    for (unsigned int i = 0; i < GPIO_V2_LINES_MAX; i++) {
+        offsets[i] = 100 + i;
+    }
+    // A few lines, all of them low
+    requests = 0;
+    debounce_error = 0;
+    fd = gpiocdev_request_outputs(FAKE_CHIP, offsets, 3, PROGNAME);
+    CHECK(fd >= 0);
+    CHECK(requests == 1);
+    CHECK(last_request.num_lines == 3);
+    CHECK(last_request.offsets[0] == 100 && last_request.offsets[2] == 102);
+    CHECK(!strcmp(last_request.consumer, PROGNAME));
+    CHECK(cfg->flags == GPIO_V2_LINE_FLAG_OUTPUT);
+    CHECK(cfg->num_attrs == 1);
+    CHECK(cfg->attrs[0].attr.id == GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES);
+    CHECK(cfg->attrs[0].attr.values == 0);
+    CHECK(cfg->attrs[0].mask == 7);
+    // Any subset of the lines with a single call
+    sets = 0;
+    CHECK(!gpiocdev_set_values(fd, 5, 6));
+    CHECK(sets == 1);
+    CHECK(last_values.bits == 5 && last_values.mask == 6);
+    release(fd);
+    // All the lines that fit in a request
+    fd = gpiocdev_request_outputs(FAKE_CHIP, offsets, GPIO_V2_LINES_MAX,
+        PROGNAME);
+    CHECK(fd >= 0);
+    CHECK(last_request.num_lines == GPIO_V2_LINES_MAX);
+    CHECK(last_request.offsets[GPIO_V2_LINES_MAX - 1]
+        == 100 + GPIO_V2_LINES_MAX - 1);
+    CHECK(cfg->attrs[0].mask == UINT64_MAX);
+    release(fd);
+}
+
+int
+main(int argc, char **argv)
+{
+    test_request_input();
+    test_debounce_fallback();
+    test_read_events();
+    test_outputs();
+    printf(PROGNAME ": ok\n");
+    return 0;
+}
+
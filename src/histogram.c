@@ -0,0 +1,163 @@
+/* histogram.c
+   Histograms of latencies, with logarithmic buckets.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "histogram.h"
+
+#include <string.h>     // memset
+
+/* Return the bucket of a value. The values lower than HISTOGRAM_SUB have a
+   bucket each. The others are in the group of their most significant bit,
+   and in the bucket of that group given by the next HISTOGRAM_SUB_BITS bits.
+
+   Parameters:
+     * value: the value.
+*/
+static unsigned int
+bucket(uint64_t value)
+{
+    unsigned int msb;
+
+    if (value < HISTOGRAM_SUB) {
+        return value;
+    }
+    msb = 63 - __builtin_clzll(value);
+    return (msb - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB
+        + ((value >> (msb - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB - 1));
+}
+
+/* Return the lowest value of a bucket.
+
+   Parameters:
+     * b: the bucket.
+*/
+static uint64_t
+bucket_low(unsigned int b)
+{
+    unsigned int group = b / HISTOGRAM_SUB;
+
+    if (!group) {
+        return b;
+    }
+    return (uint64_t)(HISTOGRAM_SUB + b % HISTOGRAM_SUB) << (group - 1);
+}
+
+/* Return the highest value of a bucket.
+
+   Parameters:
+     * b: the bucket.
+*/
+static uint64_t
+bucket_high(unsigned int b)
+{
+    unsigned int group = b / HISTOGRAM_SUB;
+
+    if (!group) {
+        return b;
+    }
+    return bucket_low(b) + ((uint64_t)1 << (group - 1)) - 1;
+}
+
+/* Initialize a histogram, without values.
+
+   Parameters:
+     * h: the histogram.
+*/
+void
+histogram_init(struct histogram_t *h)
+{
+    memset(h, 0, sizeof(struct histogram_t));
+}
+
+/* Record a value.
+
+   Parameters:
+     * h: the histogram.
+     * value: the value.
+*/
+void
+histogram_record(struct histogram_t *h, uint64_t value)
+{
+    h->counts[bucket(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+/* Return a percentile of the values recorded: the upper limit of the bucket
+   where the percentile is, but never more than the maximum value. Return 0
+   if the histogram is empty.
+
+   Parameters:
+     * h: the histogram.
+     * p: the percentile, between 0 and 100.
+*/
+uint64_t
+histogram_percentile(const struct histogram_t *h, double p)
+{
+    uint64_t rank, seen = 0;
+    uint64_t high;
+
+    if (!h->count) {
+        return 0;
+    }
+    // Rank of the value of the percentile, from 1 to count
+    rank = (uint64_t)(p / 100.0 * h->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > h->count) {
+        rank = h->count;
+    }
+    for (unsigned int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen >= rank) {
+            high = bucket_high(b);
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
+
+/* Return the number of values recorded lower than or equal to a limit, as
+   the 'le' buckets of Prometheus. The bucket of the limit is counted whole,
+   so the result is exact if the limit is the highest value of a bucket, as
+   all the powers of 2 minus 1 are.
+
+   Parameters:
+     * h: the histogram.
+     * limit: the limit.
+*/
+uint64_t
+histogram_count_at_most(const struct histogram_t *h, uint64_t limit)
+{
+    uint64_t n = 0;
+
+    for (unsigned int b = 0; b < HISTOGRAM_BUCKETS
+        && bucket_low(b) <= limit; b++)
+    {
+        n += h->counts[b];
+    }
+    return n;
+}
+
@@ -0,0 +1,94 @@
+/* histogram.h
+   Histograms of latencies, with logarithmic buckets.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>     // uint64_t
+
+// Each power of 2 is divided in 2^HISTOGRAM_SUB_BITS buckets, so a value is
+// known with an error lower than 1/2^HISTOGRAM_SUB_BITS (12.5%)
+#define HISTOGRAM_SUB_BITS  3
+#define HISTOGRAM_SUB       (1 << HISTOGRAM_SUB_BITS)
+
+// Number of buckets needed to cover all the values of an uint64_t
+#define HISTOGRAM_BUCKETS   ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB)
+
+// A histogram. It has a fixed size, so recording a value never allocates
+// memory.
+struct histogram_t {
+    // Number of values recorded in each bucket
+    uint64_t counts[HISTOGRAM_BUCKETS];
+
+    // Number of values recorded
+    uint64_t count;
+
+    // Sum of the values recorded
+    uint64_t sum;
+
+    // Maximum value recorded
+    uint64_t max;
+};
+
+/* Initialize a histogram, without values.
+
+   Parameters:
+     * h: the histogram.
+*/
+void
+histogram_init(struct histogram_t *h);
+
+/* Record a value.
+
+   Parameters:
+     * h: the histogram.
+     * value: the value.
+*/
+void
+histogram_record(struct histogram_t *h, uint64_t value);
+
+/* Return a percentile of the values recorded: the upper limit of the bucket
+   where the percentile is, but never more than the maximum value. Return 0
+   if the histogram is empty.
+
+   Parameters:
+     * h: the histogram.
+     * p: the percentile, between 0 and 100.
+*/
+uint64_t
+histogram_percentile(const struct histogram_t *h, double p);
+
+/* Return the number of values recorded lower than or equal to a limit, as
+   the 'le' buckets of Prometheus. The bucket of the limit is counted whole,
+   so the result is exact if the limit is the highest value of a bucket, as
+   all the powers of 2 minus 1 are.
+
+   Parameters:
+     * h: the histogram.
+     * limit: the limit.
+*/
+uint64_t
+histogram_count_at_most(const struct histogram_t *h, uint64_t limit);
+
+#endif
+
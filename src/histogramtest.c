@@ -0,0 +1,166 @@
+/* histogramtest.c
+   Test of the histograms of latencies at the edges of their buckets.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <err.h>        // errx
+#include <stdint.h>     // uint64_t, UINT64_MAX
+#include <stdio.h>      // printf
+#include <stdlib.h>     // random, qsort
+
+#include "histogram.h"
+
+#define PROGNAME    "histogramtest"
+
+// Number of random values recorded
+#define VALUES      10000
+
+// Fail the test if a condition doesn't hold
+#define CHECK(c)    do { \
+        if (!(c)) { \
+            errx(1, "%s:%d: check failed: %s", __FILE__, __LINE__, #c); \
+        } \
+    } while (0)
+
+// The histogram under test
+struct histogram_t h;
+
+// The values recorded, sorted, as the model of the histogram
+uint64_t values[VALUES];
+unsigned int nvalues = 0;
+
+// Compare two values for qsort
+int
+compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Record a value in the histogram and in the model.
+
+   Parameters:
+     * value: the value.
+*/
+void
+record(uint64_t value)
+{
+    histogram_record(&h, value);
+    values[nvalues++] = value;
+}
+
+/* Return the number of values of the model lower than or equal to a limit.
+
+   Parameters:
+     * limit: the limit.
+*/
+uint64_t
+model_at_most(uint64_t limit)
+{
+    uint64_t n = 0;
+
+    for (unsigned int i = 0; i < nvalues; i++) {
+        n += values[i] <= limit;
+    }
+    return n;
+}
+
+/* Check the percentiles against the sorted model: never lower than the
+   exact value nor than the maximum, and with an error lower than a bucket.
+*/
+void
+check_percentiles()
+{
+    static const double ps[] = {0, 1, 10, 25, 50, 75, 90, 99, 99.9, 100};
+    uint64_t rank, exact, p;
+
+    qsort(values, nvalues, sizeof(uint64_t), compare);
+    for (unsigned int i = 0; i < sizeof(ps) / sizeof(ps[0]); i++) {
+        rank = (uint64_t)(ps[i] / 100.0 * nvalues + 0.5);
+        rank = rank < 1 ? 1 : rank > nvalues ? nvalues : rank;
+        exact = values[rank - 1];
+        p = histogram_percentile(&h, ps[i]);
+        CHECK(p >= exact);
+        CHECK(p <= h.max);
+        CHECK(p - exact <= exact / HISTOGRAM_SUB);
+    }
+    CHECK(histogram_percentile(&h, 100) == values[nvalues - 1]);
+}
+
+int
+main(int argc, char **argv)
+{
+    uint64_t v;
+
+    // An empty histogram
+    histogram_init(&h);
+    CHECK(histogram_percentile(&h, 50) == 0);
+    CHECK(histogram_count_at_most(&h, UINT64_MAX) == 0);
+
+    // The values below HISTOGRAM_SUB have a bucket each, so they are exact
+    for (v = 0; v < 2 * HISTOGRAM_SUB; v++) {
+        record(v);
+    }
+    for (v = 0; v < 2 * HISTOGRAM_SUB; v++) {
+        CHECK(histogram_count_at_most(&h, v) == v + 1);
+    }
+    check_percentiles();
+    CHECK(histogram_percentile(&h, 50) == HISTOGRAM_SUB - 1);
+
+    // Each power of 2, its neighbours and the highest value: the bucket of
+    // 2^l - 1 ends there, so the counts of the 'le' bounds are exact
+    histogram_init(&h);
+    nvalues = 0;
+    for (unsigned int l = 1; l < 64; l++) {
+        record(((uint64_t)1 << l) - 1);
+        record((uint64_t)1 << l);
+        record(((uint64_t)1 << l) + 1);
+    }
+    record(UINT64_MAX);
+    CHECK(h.max == UINT64_MAX);
+    CHECK(h.count == nvalues);
+    for (unsigned int l = 1; l < 64; l++) {
+        v = ((uint64_t)1 << l) - 1;
+        CHECK(histogram_count_at_most(&h, v) == model_at_most(v));
+    }
+    CHECK(histogram_count_at_most(&h, UINT64_MAX) == nvalues);
+    check_percentiles();
+
+    // Random values of all the magnitudes
+    histogram_init(&h);
+    nvalues = 0;
+    srandom(1);
+    for (unsigned int i = 0; i < VALUES; i++) {
+        record(((uint64_t)random() << 32 | random())
+            >> (random() % 64));
+    }
+    for (unsigned int l = 1; l < 64; l++) {
+        v = ((uint64_t)1 << l) - 1;
+        CHECK(histogram_count_at_most(&h, v) == model_at_most(v));
+    }
+    check_percentiles();
+
+    printf(PROGNAME ": ok\n");
+    return 0;
+}
+
@@ -25,32 +25,129 @@
 
 #include <err.h>    // err
 #include <getopt.h> // getopt_long
+#include <signal.h> // sigaction
+#include <stdint.h> // int64_t
 #include <stdio.h>  // printf
 #include <stdlib.h> // exit
-#include <time.h>   // nanosleep
+#include <string.h> // strlen
+#include <sys/socket.h> // sendto
+#include <sys/un.h> // struct sockaddr_un
+#include <unistd.h> // close
 
 #include <rfsgpio.h>
 
+#include "blinkplay.h"
+#include "blinkseq.h"
+#include "clock.h"
+#include "ledd.h"
+#include "ledlines.h"
 #include "parsenum.h"
 
-#define OPTSTRING   "g:hv"
+#define OPTSTRING   "g:hvcqs:mC:"
 #define PROGNAME    "ledblink"
 
-// GPIO pin where the LED is connected
-gpio_pin_t gpio;
+// Maximum number of toggles measured, a sequence repeated forever has no end
+#define MAX_MEASURES    65536
 
-// Blink sequence
+// A LED and its blink sequence
+struct led_t {
+    // The LED in the player. It is the first member, so the LED is what the
+    // player passes to its functions.
+    struct blinkplay_led_t play;
+
+    // The GPIO pin where the LED is connected
+    struct gpio_t gpio;
+
+    // Flag that tells if the GPIO is open through sysfs
+    int opened;
+
+    // The LED in the lines, when the GPIO character device is used
+    struct ledlines_led_t line;
+
+    // Flag that tells if the LED is toggled in the current tick, and the
+    // scheduled time of the toggle
+    int toggled;
+    uint64_t toggle_deadline;
+
+    // The blink sequence, and the sequence compiled
+    const char *text;
+    struct blinkseq_t seq;
+};
+
+// The LEDs, in the order of the command line
+struct led_t *leds = NULL;
+
+// Number of LEDs
+unsigned int nleds = 0;
+
+// Blink sequence of the LEDs given without one
 const char *blinkseq = 0;
 
+// Player of the sequences of all the LEDs
+struct blinkplay_t player;
+
+// Path to the GPIO character device, NULL to use the sysfs interface
+const char *gpiochip = 0;
+
+// Lines of the LEDs, when the GPIO character device is used
+struct ledlines_t lines;
+
+// The LEDs toggled in the current tick, and number of them
+struct led_t **toggled = NULL;
+unsigned int ntoggled = 0;
+
+// Flag set by SIGINT and SIGTERM to stop the sequences
+volatile sig_atomic_t stopped = 0;
+
+// Mask of signals while sleeping. SIGINT and SIGTERM are blocked the rest of
+// the time, so they can't come between the check of the flag and the sleep
+sigset_t sleep_mask;
+
+// Flag that tells if the sequence is sent to ledd instead of played here
+int client = 0;
+
+// Flag that tells if ledd plays the sequence after the pending ones
+int queue = 0;
+
+// Path of the socket of ledd
+const char *socket_path = LEDD_DEFAULT_SOCKET;
+
+// Flag that tells if the times of the toggles are measured
+int measure = 0;
+
+// Delay of each toggle measured (ns), and number of them
+int64_t *delays = NULL;
+size_t ndelays = 0;
+
 // Print help message and exits
 void
 print_help()
 {
-    printf("Usage: " PROGNAME " [options] SEQUENCE\n"
+    printf("Usage: " PROGNAME " [options] [SEQUENCE]\n"
+"Blink a led. The SEQUENCE is made of 'oMS' (ON) and '_MS' (OFF), for MS\n"
+"milliseconds, and of groups repeated N times, '(...)*N', or forever until a\n"
+"signal is received, '(...)*'.\n"
 "Options:\n"
 "  -h, --help              Show this message and exit.\n"
 "  -v, --version           Show version information.\n"
-"  -g=GPIO, --gpio=GPIO    Give the GPIO pin where the led is connected.\n\n"
+"  -g=GPIO[=SEQUENCE], --gpio=GPIO[=SEQUENCE]\n"
+"                          Give the GPIO pin where a led is connected, and\n"
+"                          its own sequence instead of SEQUENCE. Repeat it to\n"
+"                          blink several leds at the same time.\n"
+"  -c, --client            Send the sequence to ledd, that keeps the led\n"
+"                          open, and exit without waiting for it.\n"
+"  -q, --queue             With -c, play the sequence after the ones that\n"
+"                          the led has pending instead of stopping them.\n"
+"  -s PATH, --socket PATH  With -c, give the socket of ledd\n"
+"                          (" LEDD_DEFAULT_SOCKET " by default).\n"
+"  -m, --measure           Measure the delay of each toggle of the leds from\n"
+"                          its scheduled time, and print its percentiles.\n"
+"  -C CHIP, --gpiochip CHIP\n"
+"                          Drive the leds through the GPIO character device\n"
+"                          CHIP (i.e. /dev/gpiochip0) instead of sysfs. The\n"
+"                          pins are the offsets of the lines in CHIP, and\n"
+"                          the leds toggled at the same time are set with a\n"
+"                          single system call.\n\n"
 
 "Report bugs to:\n"
 "Antonio Serrano Hernandez (" PACKAGE_BUGREPORT ")\n"
@@ -70,6 +167,43 @@ print_version()
     exit(0);
 }
 
+/* Add a LED given in the command line, as GPIO or GPIO=SEQUENCE.
+
+   Parameters:
+     * arg: the argument of the option.
+*/
+void
+add_led(const char *arg)
+{
+    const char *endptr;
+    unsigned int lgpio;
+    struct led_t *led;
+
+    // Check the value of the GPIO pin
+    if (parse_number(arg, &endptr, &lgpio) || endptr == arg
+        || (*endptr != '\0' && *endptr != '='))
+    {
+        errx(1, "invalid GPIO pin number");
+    }
+    for (unsigned int i = 0; i < nleds; i++) {
+        if (leds[i].gpio.pin == lgpio) {
+            errx(1, "repeated GPIO pin %u", lgpio);
+        }
+    }
+    leds = (struct led_t*)realloc(leds, sizeof(struct led_t) * (nleds + 1));
+    if (!leds) {
+        err(1, "allocating LED");
+    }
+    led = &(leds[nleds++]);
+    led->gpio.pin = lgpio;
+    led->gpio.flags = 0;
+    led->opened = 0;
+    led->toggled = 0;
+    led->text = *endptr == '=' ? endptr + 1 : NULL;
+    led->seq.code = NULL;
+    led->seq.size = 0;
+}
+
 /* Parse the command line arguments.
 
    Parameters:
@@ -79,14 +213,15 @@ print_version()
 void
 parse_args(int argc, char **argv)
 {
-    const char *strgpio;
-    unsigned int lgpio;
-    const char *endptr;
-
     struct option long_opts[] = {
         {"help", no_argument, 0, 'h'},
         {"version", no_argument, 0, 'v'},
         {"gpio", required_argument, 0, 'g'},
+        {"client", no_argument, 0, 'c'},
+        {"queue", no_argument, 0, 'q'},
+        {"socket", required_argument, 0, 's'},
+        {"measure", no_argument, 0, 'm'},
+        {"gpiochip", required_argument, 0, 'C'},
         {0, 0, 0, 0}
     };
     int o;
@@ -99,7 +234,22 @@ parse_args(int argc, char **argv)
             case 'v':
                 print_version();
             case 'g':
-                strgpio = optarg;
+                add_led(optarg);
+                break;
+            case 'c':
+                client = 1;
+                break;
+            case 'q':
+                queue = 1;
+                break;
+            case 's':
+                socket_path = optarg;
+                break;
+            case 'm':
+                measure = 1;
+                break;
+            case 'C':
+                gpiochip = optarg;
                 break;
             case '?':
                 exit(1);
@@ -107,106 +257,303 @@ parse_args(int argc, char **argv)
                 break;
         }
     } while (o != -1);
-    // Get the blink sequence
-    if (optind == argc) {
-        errx(1, "missing blink sequence");
+    if (client && measure) {
+        errx(1, "the toggles of ledd cannot be measured");
     }
-    blinkseq = argv[optind];
-
-    // Check the value of the GPIO pin
-    if (!strgpio) {
+    if (!nleds) {
         errx(1, "missing -g option");
     }
-    if (strgpio[0] == '\0') {
-        errx(1, "invalid GPIO pin number");
+    // Get the blink sequence of the LEDs without their own
+    if (optind < argc) {
+        blinkseq = argv[optind];
     }
-    if (parse_number(strgpio, &endptr, &lgpio)) {
-        errx(1, "invalid GPIO pin number");
+    for (unsigned int i = 0; i < nleds; i++) {
+        if (!leds[i].text) {
+            if (!blinkseq) {
+                errx(1, "missing blink sequence");
+            }
+            leds[i].text = blinkseq;
+        }
     }
-    if (*endptr != '\0') {
-        errx(1, "invalid GPIO pin number");
+}
+
+/* Compile the blink sequences, checking that they are correct.
+   A blink sequence must be formed by the characters 'o' (ON) and '_' (OFF)
+   each followed by a sequence of digits (the time in milliseconds), and of
+   groups repeated a number of times, '(...)*N', or forever, '(...)*'.
+*/
+void
+compile_blink_sequences()
+{
+    const char *error;
+    unsigned int pos;
+
+    for (unsigned int i = 0; i < nleds; i++) {
+        if (blinkseq_compile(&(leds[i].seq), leds[i].text, &error, &pos)) {
+            errx(1, "GPIO %u: at position %u: %s",
+                (unsigned int)leds[i].gpio.pin, pos, error);
+        }
     }
-    gpio = lgpio;
 }
 
-/* Check that the blink sequence is correct.
-   The blink sequence must be formed by the characters 'o' (ON) and '_' (OFF)
-   each followed by a sequence of digits (the time in milliseconds).
+/* Stop the sequences, without waiting for the end of the current step.
+   Called when SIGINT or SIGTERM are received.
+
+   Parameters:
+     * signum: the signal received.
 */
 void
-check_blink_sequence()
-{
-    const char *ptr = blinkseq, *eptr;
-    int pos = 0;
-    unsigned int t;
-
-    while (*ptr != '\0') {
-        switch (*ptr) {
-            case 'o':
-            case '_':
-                // Check number that follows
-                if (parse_number(ptr + 1, &eptr, &t)) {
-                    errx(1, "at position %d: wrong time", pos + 1);
-                }
-                // Check that indeed there's a number after the o or _ chars
-                if (eptr == ptr + 1) {
-                    errx(1, "at position %d: time expected", pos + 1);
-                }
-                pos += (eptr - ptr);
-                ptr = eptr;
-                break;
-            default:
-                // Wrong character
-                errx(1,
-                    "at position %d: wrong character '%c' in blink sequence",
-                    pos, *ptr);
+stop_sequence(int signum)
+{
+    stopped = 1;
+}
+
+// Stop the sequences when SIGINT or SIGTERM are received, so the LEDs are
+// switched off and the GPIOs closed. The signals are blocked, and only
+// received while sleeping
+void
+set_signals()
+{
+    struct sigaction sa;
+    sigset_t signals;
+
+    sa.sa_handler = stop_sequence;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    if (sigaction(SIGINT, &sa, NULL) || sigaction(SIGTERM, &sa, NULL)
+        || sigprocmask(SIG_BLOCK, &signals, &sleep_mask))
+    {
+        err(1, "cannot handle the signals");
+    }
+}
+
+/* Compare two delays, for qsort.
+
+   Parameters:
+     * a: pointer to a delay.
+     * b: pointer to the other delay.
+*/
+int
+compare_delays(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Print the percentiles of the delays of the toggles.
+
+   Parameters:
+     * delays: time from the scheduled time of each toggle to the end of the
+         write to the GPIO (ns).
+     * n: the number of toggles.
+*/
+void
+print_delays(int64_t *delays, size_t n)
+{
+    const unsigned int percentiles[] = {50, 90, 99};
+
+    qsort(delays, n, sizeof(int64_t), compare_delays);
+    printf("%zu toggles, delay from the scheduled time (us):\n", n);
+    printf("  min %.1f", delays[0] / 1000.0);
+    for (int i = 0; i < 3; i++) {
+        // Nearest rank
+        printf("  p%u %.1f", percentiles[i],
+            delays[(n * percentiles[i] + 99) / 100 - 1] / 1000.0);
+    }
+    printf("  max %.1f\n", delays[n - 1] / 1000.0);
+}
+
+/* Record the delay of a toggle, if the toggles are measured.
+
+   Parameters:
+     * deadline: the scheduled time of the toggle (ns).
+*/
+void
+measure_toggle(uint64_t deadline)
+{
+    if (measure && ndelays < MAX_MEASURES) {
+        delays[ndelays++] = clock_now() - deadline;
+    }
+}
+
+/* Turn a LED ON or OFF, at the start of a step. Through the GPIO character
+   device the value is only stored, and set with the rest of the tick by
+   flush_leds.
+
+   Parameters:
+     * play: the LED in the player.
+     * on: 1 to turn it ON, 0 to turn it OFF.
+*/
+void
+set_led(struct blinkplay_led_t *play, int on)
+{
+    struct led_t *led = (struct led_t*)play;
+
+    if (!gpiochip) {
+        rfs_gpio_set_value(&(led->gpio), on ? RFS_GPIO_HIGH : RFS_GPIO_LOW);
+        measure_toggle(play->deadline);
+        return;
+    }
+    ledlines_set(&(led->line), on);
+    if (!led->toggled) {
+        led->toggled = 1;
+        led->toggle_deadline = play->deadline;
+        toggled[ntoggled++] = led;
+    }
+}
+
+/* Set the lines of the LEDs toggled in the current tick, with a system call
+   for each request of lines. Called by the player at the end of each tick.
+
+   Parameters:
+     * p: the player.
+*/
+void
+flush_leds(struct blinkplay_t *p)
+{
+    if (ledlines_flush(&lines)) {
+        warn("cannot set the values of the lines");
+    }
+    for (unsigned int i = 0; i < ntoggled; i++) {
+        measure_toggle(toggled[i]->toggle_deadline);
+        toggled[i]->toggled = 0;
+    }
+    ntoggled = 0;
+}
+
+// Switch off and close the GPIOs of the LEDs that are open
+void
+close_leds()
+{
+    if (gpiochip) {
+        ledlines_close(&lines);
+    }
+    for (unsigned int i = 0; i < nleds; i++) {
+        if (leds[i].opened) {
+            rfs_gpio_set_value(&(leds[i].gpio), RFS_GPIO_LOW);
+            rfs_gpio_close(&(leds[i].gpio));
+            leds[i].opened = 0;
         }
     }
 }
 
-// Execute the blink sequence
-void do_sequence() {
-    const char *ptr = blinkseq;
-    struct gpio_t g = {gpio, 0};
-    unsigned int t;
-    struct timespec ts;
+/* Request the lines of the LEDs from the GPIO character device, in groups of
+   up to GPIO_V2_LINES_MAX lines. Exit in case of error.
+*/
+void
+request_lines()
+{
+    toggled = (struct led_t**)malloc(sizeof(struct led_t*) * nleds);
+    if (!toggled || ledlines_init(&lines, nleds)) {
+        err(1, "allocating the lines");
+    }
+    for (unsigned int i = 0; i < nleds; i++) {
+        ledlines_add(&lines, &(leds[i].line), leds[i].gpio.pin);
+    }
+    if (ledlines_request(&lines, gpiochip, PROGNAME)) {
+        warn("cannot request the lines of '%s'", gpiochip);
+        close_leds();
+        exit(1);
+    }
+}
 
-    // Initialize the GPIO
-    if (rfs_gpio_open(&g, RFS_GPIO_OUT_LOW)) {
-        err(1, "opening GPIO #%d", gpio);
+/* Execute the blink sequences of all the LEDs from this thread, with a
+   player that wakes up once for all the LEDs toggled at the same time, so
+   the wakeups depend on the toggles, not on the number of LEDs. SIGINT and
+   SIGTERM are only unblocked during the sleep, so they interrupt it and stop
+   the sequences at once, even if they come just before it.
+*/
+void
+do_sequences()
+{
+    if (measure) {
+        delays = (int64_t*)malloc(sizeof(int64_t) * MAX_MEASURES);
+        if (!delays) {
+            err(1, "allocating the measures");
+        }
     }
+    // Initialize the GPIOs
+    if (gpiochip) {
+        request_lines();
+    }
+    for (unsigned int i = 0; !gpiochip && i < nleds; i++) {
+        if (rfs_gpio_open(&(leds[i].gpio), RFS_GPIO_OUT_LOW)) {
+            warn("opening GPIO #%d", leds[i].gpio.pin);
+            close_leds();
+            exit(1);
+        }
+        leds[i].opened = 1;
+    }
+    blinkplay_init(&player, set_led, gpiochip ? flush_leds : NULL);
+    for (unsigned int i = 0; i < nleds; i++) {
+        blinkplay_add(&player, &(leds[i].play), &(leds[i].seq));
+    }
+    blinkplay_run(&player, &sleep_mask, &stopped);
+    close_leds();
+    if (measure) {
+        if (ndelays) {
+            print_delays(delays, ndelays);
+        }
+        free(delays);
+    }
+}
 
-    while (*ptr != '\0') {
-        switch (*ptr) {
-            case 'o':
-                // Turn ON the led
-                rfs_gpio_set_value(&g, RFS_GPIO_HIGH);
-                break;
-            case '_':
-                // Turn OFF the led
-                rfs_gpio_set_value(&g, RFS_GPIO_LOW);
-                break;
-            default: break;
+/* Send the blink sequences to ledd, that plays them. Each request is a
+   single datagram, so this function doesn't wait for the sequences.
+*/
+void
+send_sequences()
+{
+    struct sockaddr_un addr;
+    char msg[LEDD_MAX_MESSAGE];
+    int fd, len;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        errx(1, "the path '%s' is too long for a socket", socket_path);
+    }
+    strcpy(addr.sun_path, socket_path);
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        err(1, "cannot create the socket");
+    }
+    for (unsigned int i = 0; i < nleds; i++) {
+        len = snprintf(msg, sizeof(msg), "%u %s %s",
+            (unsigned int)leds[i].gpio.pin, queue ? LEDD_QUEUE : LEDD_NOW,
+            leds[i].text);
+        if (len >= (int)sizeof(msg)) {
+            errx(1, "blink sequence too long");
+        }
+        if (sendto(fd, msg, len, 0, (struct sockaddr*)&addr, sizeof(addr))
+            < 0)
+        {
+            err(1, "cannot send the sequence to '%s'", socket_path);
         }
-        // Read the number that follows and sleep that number of
-        // milliseconds
-        parse_number(ptr + 1, &ptr, &t);
-        ts.tv_sec = t/1000;
-        ts.tv_nsec = (t%1000) * 1000000;
-        nanosleep(&ts, NULL);
     }
-    // Switch off the LED
-    rfs_gpio_set_value(&g, RFS_GPIO_LOW);
-    // Close the GPIO pin
-    rfs_gpio_close(&g);
+    close(fd);
 }
 
 int
 main(int argc, char **argv)
 {
     parse_args(argc, argv);
-    check_blink_sequence();
-    do_sequence();
+    compile_blink_sequences();
+    if (client) {
+        send_sequences();
+    } else {
+        set_signals();
+        do_sequences();
+    }
+    for (unsigned int i = 0; i < nleds; i++) {
+        blinkseq_free(&(leds[i].seq));
+    }
+    free(leds);
+    free(toggled);
     return 0;
 }
 
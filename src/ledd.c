@@ -0,0 +1,554 @@
+/* ledd.c
+   Daemon that keeps a bunch of LEDs open and blinks them with the sequences
+   received in a socket.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <err.h>        // err
+#include <errno.h>      // errno
+#include <getopt.h>     // getopt_long
+#include <signal.h>     // sigset_t
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // printf
+#include <stdlib.h>     // exit
+#include <string.h>     // strncmp
+#include <sys/epoll.h>  // EPOLLIN
+#include <sys/socket.h> // socket
+#include <sys/un.h>     // struct sockaddr_un
+#include <unistd.h>     // unlink
+
+#include <rfsgpio.h>
+
+#include "blinkseq.h"
+#include "clock.h"
+#include "daemon.h"
+#include "dictint.h"
+#include "ledd.h"
+#include "parsenum.h"
+#include "reactor.h"
+
+// Short options
+//   * h: help
+//   * v: version
+//   * d: daemonize
+//   * p: pidfile
+//   * s: socket
+#define OPTSTRING   "hvdp:s:"
+
+// Name of the program, to use it in the version and help string
+#define PROGNAME    "ledd"
+
+// Number of sequences that a LED can have queued behind the current one
+#define LED_QUEUE_SIZE  8
+
+// Nanoseconds in a millisecond
+#define NS_PER_MS   1000000ULL
+
+// A LED, open since it receives its first sequence until the daemon exits
+struct led_t {
+    // Timer that expires at the end of each step of the sequence. It is the
+    // first member, so the LED is what the timer passes to its function.
+    struct reactor_timer_t timer;
+
+    // The GPIO pin where the LED is connected
+    struct gpio_t gpio;
+
+    // Flag that tells if the LED is playing a sequence
+    int playing;
+
+    // The sequence being played, and its next step
+    struct blinkseq_t seq;
+    struct blinkseq_iterator_t next;
+
+    // End of the current step (ns of CLOCK_MONOTONIC). The steps are timed
+    // from the end of the previous one, so the delays don't accumulate.
+    uint64_t deadline;
+
+    // The sequences queued, a circular buffer from head
+    struct blinkseq_t queue[LED_QUEUE_SIZE];
+    unsigned int head, queued;
+};
+
+// Dictionary that stores the LEDs indexed by the GPIO pin number where they
+// are connected
+struct dictint_t leds;
+
+// The reactor that waits for the requests, the timers and the signals
+struct reactor_t reactor = REACTOR_INIT;
+
+// Signals received through the reactor: SIGINT and SIGTERM stop the process
+sigset_t signals;
+
+// Flag that tells if this process must be daemonized
+int is_daemon = 0;
+
+const char *pidfile = 0;
+
+// Path of the socket where the requests are received
+const char *socket_path = LEDD_DEFAULT_SOCKET;
+
+// The socket of the requests
+struct reactor_handler_t requests = {-1, 0};
+
+// Print a help message and exit.
+void
+print_help()
+{
+    printf("Usage: " PROGNAME " [options]\n"
+"Keep the LEDs open and blink them with the sequences sent by\n"
+"'ledblink --client'.\n"
+"Options:\n"
+"  -h, --help                  Show this message and exit.\n"
+"  -v, --version               Show version information.\n"
+"  -d, --daemonize             Daemonize this process.\n"
+"  -p PATH, --pidfile PATH     Create a pidfile.\n"
+"  -s PATH, --socket PATH      Receive the sequences in the Unix socket PATH\n"
+"                              (" LEDD_DEFAULT_SOCKET " by default).\n\n"
+
+"Report bugs to:\n"
+"Antonio Serrano Hernandez (" PACKAGE_BUGREPORT ")\n"
+    );
+    exit(0);
+}
+
+// Print a version message and exits
+void
+print_version()
+{
+    printf(PROGNAME " (" PACKAGE_NAME ") " PACKAGE_VERSION "\n"
+"Copyright (C) 2018 Antonio Serrano\n"
+"This is free software; see the source for copying conditions.  There is NO\n"
+"warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n"
+    );
+    exit(0);
+}
+
+/* Parse the command line arguments.
+
+   Parameters:
+     * argc: number of command line arguments.
+     * argv: command line string arguments.
+*/
+void
+parse_args(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {"version", no_argument, 0, 'v'},
+        {"daemonize", no_argument, 0, 'd'},
+        {"pidfile", required_argument, 0, 'p'},
+        {"socket", required_argument, 0, 's'},
+        {0, 0, 0, 0}
+    };
+    int o;
+
+    do {
+        o = getopt_long(argc, argv, OPTSTRING, long_opts, 0);
+        switch (o) {
+            case 'h':
+                print_help();
+            case 'v':
+                print_version();
+            case 'd':
+                is_daemon = 1;
+                break;
+            case 'p':
+                pidfile = optarg;
+                break;
+            case 's':
+                socket_path = optarg;
+                break;
+            case '?':
+                exit(1);
+            default:
+                break;
+        }
+    } while (o != -1);
+}
+
+/* Block the signals SIGINT and SIGTERM. They are received later through the
+   reactor's signalfd.
+
+   Return 0 if the signals were blocked, 1 otherwise.
+*/
+int
+set_signals()
+{
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    if (reactor_block_signals(&signals)) {
+        warn("cannot block signals");
+        return 1;
+    }
+    return 0;
+}
+
+/* Turn a LED ON or OFF.
+
+   Parameters:
+     * led: the LED.
+     * on: 1 to turn it ON, 0 to turn it OFF.
+*/
+void
+set_led(struct led_t *led, int on)
+{
+    if (rfs_gpio_set_value(&(led->gpio), on ? RFS_GPIO_HIGH : RFS_GPIO_LOW)) {
+        warn("cannot set the value of GPIO %d", led->gpio.pin);
+    }
+}
+
+/* Free the sequence being played by a LED and the ones queued.
+
+   Parameters:
+     * led: the LED.
+*/
+void
+free_sequences(struct led_t *led)
+{
+    if (led->playing) {
+        blinkseq_free(&(led->seq));
+        led->playing = 0;
+    }
+    while (led->queued) {
+        blinkseq_free(&(led->queue[led->head]));
+        led->head = (led->head + 1) % LED_QUEUE_SIZE;
+        led->queued--;
+    }
+}
+
+/* Start the next step of the sequence of a LED, when the previous one ends.
+   At the end of the sequence the next one queued is started, without delay,
+   or else the LED is turned OFF.
+
+   Parameters:
+     * led: the LED.
+*/
+void
+led_step(struct led_t *led)
+{
+    unsigned int ms;
+    int on;
+
+    while (!blinkseq_iterator_next(&(led->next), &on, &ms)) {
+        blinkseq_free(&(led->seq));
+        led->playing = 0;
+        if (!led->queued) {
+            set_led(led, 0);
+            return;
+        }
+        led->seq = led->queue[led->head];
+        led->playing = 1;
+        blinkseq_iterator_begin(&(led->seq), &(led->next));
+        led->head = (led->head + 1) % LED_QUEUE_SIZE;
+        led->queued--;
+    }
+    set_led(led, on);
+    led->deadline += ms * NS_PER_MS;
+    if (reactor_timer_arm(&(led->timer), led->deadline)) {
+        warn("cannot arm the timer of GPIO %d", led->gpio.pin);
+    }
+}
+
+/* Function called when the current step of a LED ends.
+
+   Parameters:
+     * t: the timer of the LED.
+*/
+void
+led_expired(struct reactor_timer_t *t)
+{
+    led_step((struct led_t*)t);
+}
+
+/* Return the LED connected to a GPIO pin, opening it if it's the first time.
+
+   Parameters:
+     * pin: the GPIO pin.
+
+   Return the LED, or NULL in case of error.
+*/
+struct led_t*
+get_led(gpio_pin_t pin)
+{
+    struct led_t *led;
+
+    led = dictint_get(&leds, pin);
+    if (led) {
+        return led;
+    }
+    led = (struct led_t*)calloc(1, sizeof(struct led_t));
+    if (!led) {
+        warn("allocating LED");
+        return NULL;
+    }
+    led->gpio.pin = pin;
+    led->gpio.flags = 0;
+    if (rfs_gpio_open(&(led->gpio), RFS_GPIO_OUT_LOW)) {
+        warn("opening GPIO #%d", pin);
+        free(led);
+        return NULL;
+    }
+    if (reactor_timer_init(&reactor, &(led->timer), led_expired)) {
+        warn("cannot create the timer of GPIO %d", pin);
+        rfs_gpio_close(&(led->gpio));
+        free(led);
+        return NULL;
+    }
+    if (dictint_add(&leds, pin, led)) {
+        warn("adding new LED to dictionary");
+        reactor_timer_close(&(led->timer));
+        rfs_gpio_close(&(led->gpio));
+        free(led);
+        return NULL;
+    }
+    return led;
+}
+
+/* Play a sequence in a LED, at once or after the ones it has pending. A
+   sequence queued behind one that is repeated forever is never played.
+
+   Parameters:
+     * led: the LED.
+     * seq: the compiled sequence, that the LED takes. It is freed when it
+         ends.
+     * queue: 1 to play it after the pending ones, 0 to discard them.
+*/
+void
+play_sequence(struct led_t *led, struct blinkseq_t *seq, int queue)
+{
+    if (queue && led->playing) {
+        if (led->queued == LED_QUEUE_SIZE) {
+            warnx("the queue of GPIO %d is full", led->gpio.pin);
+            blinkseq_free(seq);
+            return;
+        }
+        led->queue[(led->head + led->queued) % LED_QUEUE_SIZE] = *seq;
+        led->queued++;
+        return;
+    }
+    free_sequences(led);
+    led->seq = *seq;
+    led->playing = 1;
+    blinkseq_iterator_begin(&(led->seq), &(led->next));
+    led->deadline = clock_now();
+    led_step(led);
+}
+
+/* Parse and execute a request (see ledd.h).
+
+   Parameters:
+     * msg: the request.
+*/
+void
+parse_request(char *msg)
+{
+    const char *ptr, *error;
+    unsigned int pin, pos;
+    int queue;
+    struct led_t *led;
+    struct blinkseq_t seq;
+
+    if (parse_number(msg, &ptr, &pin) || ptr == msg || *ptr != ' ') {
+        warnx("request without GPIO pin");
+        return;
+    }
+    ptr++;
+    if (!strncmp(ptr, LEDD_NOW " ", sizeof(LEDD_NOW))) {
+        queue = 0;
+        ptr += sizeof(LEDD_NOW);
+    } else if (!strncmp(ptr, LEDD_QUEUE " ", sizeof(LEDD_QUEUE))) {
+        queue = 1;
+        ptr += sizeof(LEDD_QUEUE);
+    } else {
+        warnx("request for GPIO %u without mode", pin);
+        return;
+    }
+    if (blinkseq_compile(&seq, ptr, &error, &pos)) {
+        warnx("request for GPIO %u: at position %u: %s", pin, pos, error);
+        return;
+    }
+    led = get_led(pin);
+    if (!led) {
+        blinkseq_free(&seq);
+        return;
+    }
+    play_sequence(led, &seq, queue);
+}
+
+/* Receive the requests queued in the socket. Called by the reactor.
+
+   Parameters:
+     * h: the handler of the socket.
+     * events: the epoll events (not used).
+*/
+void
+requests_ready(struct reactor_handler_t *h, uint32_t events)
+{
+    char msg[LEDD_MAX_MESSAGE + 1];
+    ssize_t len;
+
+    // MSG_TRUNC returns the real length of a request that doesn't fit
+    while ((len = recv(h->fd, msg, LEDD_MAX_MESSAGE, MSG_TRUNC)) >= 0) {
+        if (len > LEDD_MAX_MESSAGE) {
+            warnx("request of %zd bytes discarded", len);
+            continue;
+        }
+        if (len && msg[len - 1] == '\n') {
+            len--;
+        }
+        msg[len] = '\0';
+        parse_request(msg);
+    }
+    if (errno != EAGAIN) {
+        warn("cannot receive requests");
+    }
+}
+
+/* Create the socket of the requests and add it to the reactor. An old socket
+   in the path is replaced.
+
+   Return 0 if the socket is being watched, 1 otherwise.
+*/
+int
+open_socket()
+{
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        warnx("the path '%s' is too long for a socket", socket_path);
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+    requests.fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+        0);
+    if (requests.fd < 0) {
+        warn("cannot create the socket");
+        return 1;
+    }
+    unlink(socket_path);
+    if (bind(requests.fd, (struct sockaddr*)&addr, sizeof(addr))) {
+        warn("cannot bind to '%s'", socket_path);
+        return 1;
+    }
+    requests.callback = requests_ready;
+    if (reactor_add(&reactor, &requests, EPOLLIN)) {
+        warn("cannot watch the socket");
+        return 1;
+    }
+    return 0;
+}
+
+// Close the socket of the requests and remove it from the file system
+void
+close_socket()
+{
+    if (requests.fd >= 0) {
+        close(requests.fd);
+        unlink(socket_path);
+    }
+}
+
+// Turn OFF and close all the LEDs
+void
+close_leds()
+{
+    struct dictint_iterator_t i;
+    struct led_t *led;
+    int gpio;
+
+    dictint_iterator_begin(&leds, &i);
+    while (dictint_iterator_next(&i, &gpio, (void**)&led)) {
+        free_sequences(led);
+        set_led(led, 0);
+        rfs_gpio_close(&(led->gpio));
+        reactor_timer_close(&(led->timer));
+        free(led);
+    }
+    dictint_free(&leds);
+}
+
+/* Process a signal received through the reactor. SIGINT and SIGTERM stop the
+   main loop.
+
+   Parameters:
+     * signum: the signal received.
+*/
+void
+on_signal(int signum)
+{
+    switch (signum) {
+        case SIGINT:
+        case SIGTERM:
+            reactor_stop(&reactor, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Main entry point.
+
+   Parameters:
+     * argc: number of command line arguments.
+     * argv: array of command line arguments.
+*/
+int
+main(int argc, char **argv)
+{
+    int e = 0;
+
+    // Parse the command line arguments
+    parse_args(argc, argv);
+    // Block the signals SIGINT and SIGTERM, they are processed later by the
+    // reactor
+    if (set_signals()) {
+        return 1;
+    }
+    if (dictint_init(&leds, NULL)) {
+        warn("cannot create the dictionary of LEDs");
+        return 1;
+    }
+    // Daemonize, if demanded
+    if (is_daemon && daemonize(pidfile, -1)) {
+        return 1;
+    }
+    // Create the reactor. This is done after daemonizing because daemonize
+    // closes all the descriptors.
+    if (reactor_init(&reactor, &signals, on_signal)) {
+        warn("cannot create the reactor");
+        e = 1;
+        goto end;
+    }
+    // Receive the requests until a signal stops the loop
+    if (open_socket() || reactor_run(&reactor)) {
+        e = 1;
+    }
+end:
+    close_leds();
+    close_socket();
+    reactor_close(&reactor);
+    return e;
+}
+
@@ -0,0 +1,44 @@
+/* ledd.h
+   Messages that ledd receives in its socket, sent by ledblink --client.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEDD_H
+#define LEDD_H
+
+// Each datagram received in the socket is a single request in text:
+//
+//   <pin> <mode> <sequence>
+//
+// Where pin is the GPIO pin of the LED, sequence is a blink sequence (see
+// blinkseq.h) and mode is LEDD_NOW, to stop what the LED is doing and start
+// the sequence at once, or LEDD_QUEUE, to start it when the sequences that
+// the LED has pending are finished. A trailing newline is ignored.
+#define LEDD_NOW    "now"
+#define LEDD_QUEUE  "queue"
+
+// Default path of the socket
+#define LEDD_DEFAULT_SOCKET RUNSTATEDIR "/ledd.sock"
+
+// Maximum size of a request
+#define LEDD_MAX_MESSAGE    1024
+
+#endif
+
@@ -0,0 +1,175 @@
+/* ledlines.c
+   LEDs driven through the GPIO character device, set once per tick.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "ledlines.h"
+
+#include <stdlib.h>     // malloc
+#include <unistd.h>     // close
+
+#include "gpiocdev.h"
+
+/* Initialize the lines of a set of LEDs, without LEDs.
+
+   Parameters:
+     * l: the lines.
+     * n: maximum number of LEDs.
+
+   Return 0 on success, 1 if the memory couldn't be allocated.
+*/
+int
+ledlines_init(struct ledlines_t *l, unsigned int n)
+{
+    unsigned int size = (n + GPIO_V2_LINES_MAX - 1) / GPIO_V2_LINES_MAX;
+
+    l->chip_fd = -1;
+    l->nrequests = 0;
+    l->requests = (struct ledlines_request_t*)malloc(
+        sizeof(struct ledlines_request_t) * (size ? size : 1));
+    return l->requests ? 0 : 1;
+}
+
+/* Add a LED to the lines, in the group of the previous one if it's not full.
+
+   Parameters:
+     * l: the lines.
+     * led: the LED.
+     * offset: the offset of the line of the LED in the chip.
+*/
+void
+ledlines_add(struct ledlines_t *l, struct ledlines_led_t *led,
+    unsigned int offset)
+{
+    struct ledlines_request_t *r;
+
+    if (!l->nrequests
+        || l->requests[l->nrequests - 1].noffsets == GPIO_V2_LINES_MAX)
+    {
+        r = &(l->requests[l->nrequests++]);
+        r->fd = -1;
+        r->noffsets = 0;
+        r->bits = 0;
+        r->mask = 0;
+    } else {
+        r = &(l->requests[l->nrequests - 1]);
+    }
+    led->request = r;
+    led->bit = 1ULL << r->noffsets;
+    r->offsets[r->noffsets++] = offset;
+}
+
+/* Request the lines of the LEDs added, as outputs at low level.
+
+   Parameters:
+     * l: the lines.
+     * chip: path to the GPIO character device.
+     * consumer: name of the consumer of the lines.
+
+   Return 0 on success, 1 otherwise, and errno is set accordingly. The
+   lines must be closed anyway.
+*/
+int
+ledlines_request(struct ledlines_t *l, const char *chip,
+    const char *consumer)
+{
+    struct ledlines_request_t *r;
+
+    l->chip_fd = gpiocdev_open_chip(chip);
+    if (l->chip_fd < 0) {
+        return 1;
+    }
+    for (unsigned int i = 0; i < l->nrequests; i++) {
+        r = &(l->requests[i]);
+        r->fd = gpiocdev_request_outputs(l->chip_fd, r->offsets, r->noffsets,
+            consumer);
+        if (r->fd < 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Turn a LED ON or OFF. The value is only stored, and set with the rest of
+   the tick by ledlines_flush.
+
+   Parameters:
+     * led: the LED.
+     * on: 1 to turn it ON, 0 to turn it OFF.
+*/
+void
+ledlines_set(struct ledlines_led_t *led, int on)
+{
+    if (on) {
+        led->request->bits |= led->bit;
+    } else {
+        led->request->bits &= ~led->bit;
+    }
+    led->request->mask |= led->bit;
+}
+
+/* Set the lines of the LEDs turned ON or OFF since the previous call, with a
+   system call for each group of lines.
+
+   Parameters:
+     * l: the lines.
+
+   Return 0 on success, 1 if the values of a group couldn't be set, and errno
+   is set accordingly.
+*/
+int
+ledlines_flush(struct ledlines_t *l)
+{
+    struct ledlines_request_t *r;
+    int e = 0;
+
+    for (unsigned int i = 0; i < l->nrequests; i++) {
+        r = &(l->requests[i]);
+        if (r->mask && gpiocdev_set_values(r->fd, r->bits, r->mask)) {
+            e = 1;
+        }
+        r->mask = 0;
+    }
+    return e;
+}
+
+/* Switch off and release the lines, and close the GPIO character device.
+
+   Parameters:
+     * l: the lines.
+*/
+void
+ledlines_close(struct ledlines_t *l)
+{
+    for (unsigned int i = 0; i < l->nrequests; i++) {
+        if (l->requests[i].fd >= 0) {
+            gpiocdev_set_values(l->requests[i].fd, 0, UINT64_MAX);
+            close(l->requests[i].fd);
+        }
+    }
+    free(l->requests);
+    l->requests = NULL;
+    l->nrequests = 0;
+    if (l->chip_fd >= 0) {
+        close(l->chip_fd);
+        l->chip_fd = -1;
+    }
+}
+
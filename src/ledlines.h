@@ -0,0 +1,128 @@
+/* ledlines.h
+   LEDs driven through the GPIO character device, set once per tick.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEDLINES_H
+#define LEDLINES_H
+
+#include <linux/gpio.h> // GPIO_V2_LINES_MAX
+#include <stdint.h>     // uint64_t
+
+// Lines of the GPIO character device requested together, and the values to
+// set at the end of the current tick
+struct ledlines_request_t {
+    // File descriptor of the line request, -1 if not requested
+    int fd;
+
+    // Offsets of the lines in the chip, and number of them
+    unsigned int offsets[GPIO_V2_LINES_MAX];
+    unsigned int noffsets;
+
+    // Values of the lines and lines to set, the bit i for the i-th line
+    // requested
+    uint64_t bits, mask;
+};
+
+// A LED in the lines: its request and its bit in it
+struct ledlines_led_t {
+    struct ledlines_request_t *request;
+    uint64_t bit;
+};
+
+// The lines of a set of LEDs, in groups of up to GPIO_V2_LINES_MAX lines, so
+// the LEDs toggled in a tick are set with a system call for each group
+struct ledlines_t {
+    // Descriptor of the GPIO character device, -1 if not open
+    int chip_fd;
+
+    // The requests of lines and number of them
+    struct ledlines_request_t *requests;
+    unsigned int nrequests;
+};
+
+/* Initialize the lines of a set of LEDs, without LEDs.
+
+   Parameters:
+     * l: the lines.
+     * n: maximum number of LEDs.
+
+   Return 0 on success, 1 if the memory couldn't be allocated.
+*/
+int
+ledlines_init(struct ledlines_t *l, unsigned int n);
+
+/* Add a LED to the lines, in the group of the previous one if it's not full.
+
+   Parameters:
+     * l: the lines.
+     * led: the LED.
+     * offset: the offset of the line of the LED in the chip.
+*/
+void
+ledlines_add(struct ledlines_t *l, struct ledlines_led_t *led,
+    unsigned int offset);
+
+/* Request the lines of the LEDs added, as outputs at low level.
+
+   Parameters:
+     * l: the lines.
+     * chip: path to the GPIO character device.
+     * consumer: name of the consumer of the lines.
+
+   Return 0 on success, 1 otherwise, and errno is set accordingly. The
+   lines must be closed anyway.
+*/
+int
+ledlines_request(struct ledlines_t *l, const char *chip,
+    const char *consumer);
+
+/* Turn a LED ON or OFF. The value is only stored, and set with the rest of
+   the tick by ledlines_flush.
+
+   Parameters:
+     * led: the LED.
+     * on: 1 to turn it ON, 0 to turn it OFF.
+*/
+void
+ledlines_set(struct ledlines_led_t *led, int on);
+
+/* Set the lines of the LEDs turned ON or OFF since the previous call, with a
+   system call for each group of lines.
+
+   Parameters:
+     * l: the lines.
+
+   Return 0 on success, 1 if the values of a group couldn't be set, and errno
+   is set accordingly.
+*/
+int
+ledlines_flush(struct ledlines_t *l);
+
+/* Switch off and release the lines, and close the GPIO character device.
+
+   Parameters:
+     * l: the lines.
+*/
+void
+ledlines_close(struct ledlines_t *l);
+
+#endif
+
@@ -25,19 +25,39 @@
 
 #include <stdlib.h> // malloc
 
+/* Allocate a node of a list, from its arena if it has one.
+
+   Parameters:
+     * l: the list.
+
+   Return the node, or NULL if there's no memory.
+*/
+static struct list_node_t*
+list_alloc_node(struct list_t *l)
+{
+    if (l->arena) {
+        return (struct list_node_t*)arena_alloc(l->arena,
+            sizeof(struct list_node_t));
+    }
+    return (struct list_node_t*)malloc(sizeof(struct list_node_t));
+}
+
 /* Initialize the list.
 
    Parameters:
      * l: the list.
+     * a: the arena where the nodes are allocated, or NULL to allocate them
+         with malloc.
 
    Return 0 if the list was correctly initialized, 1 otherwise.
 */
 int
-list_init(struct list_t *l)
+list_init(struct list_t *l, struct arena_t *a)
 {
     struct list_node_t *sentinel;
 
-    sentinel = (struct list_node_t*)malloc(sizeof(struct list_node_t));
+    l->arena = a;
+    sentinel = list_alloc_node(l);
     if (!sentinel) {
         return 1;
     }
@@ -62,7 +82,7 @@ list_add(struct list_t *l, void *elem)
     struct list_node_t *n;
 
     // Allocate the new node
-    n = (struct list_node_t*)malloc(sizeof(struct list_node_t));
+    n = list_alloc_node(l);
     if (!n) {
         return 1;
     }
@@ -109,3 +129,34 @@ list_iterator_next(struct list_iterator_t *i, void **elem)
     }
 }
 
+/* Replace the element pointed by the iterator.
+
+   Parameters:
+     * i: the iterator, that points to an element.
+     * elem: the new element.
+*/
+void
+list_iterator_set(struct list_iterator_t *i, void *elem)
+{
+    i->n->data = elem;
+}
+
+/* Free the nodes of the list. The elements are not freed, and the nodes
+   allocated from an arena are freed with the arena.
+
+   Parameters:
+     * l: the list.
+*/
+void
+list_free(struct list_t *l)
+{
+    struct list_node_t *n, *next;
+
+    for (n = l->arena ? NULL : l->first; n; n = next) {
+        next = n->next;
+        free(n);
+    }
+    l->first = NULL;
+    l->last = NULL;
+}
+
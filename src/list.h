@@ -24,6 +24,8 @@
 #ifndef LIST_H
 #define LIST_H
 
+#include "arena.h"
+
 // Node of the list
 struct list_node_t {
     // Pointer to the next node in the list
@@ -40,6 +42,9 @@ struct list_t {
 
     // Pointer to last node in the list
     struct list_node_t *last;
+
+    // Arena of the nodes, NULL if they are allocated with malloc
+    struct arena_t *arena;
 };
 
 // Type to iterate over the list
@@ -55,11 +60,13 @@ struct list_iterator_t {
 
    Parameters:
      * l: the list.
+     * a: the arena where the nodes are allocated, or NULL to allocate them
+         with malloc.
 
    Return 0 if the list was correctly initialized, 1 otherwise.
 */
 int
-list_init(struct list_t *l);
+list_init(struct list_t *l, struct arena_t *a);
 
 /* Add an element at the end of the list.
 
@@ -95,5 +102,23 @@ list_iterator_begin(struct list_t *d, struct list_iterator_t *i);
 int
 list_iterator_next(struct list_iterator_t *i, void **elem);
 
+/* Replace the element pointed by the iterator.
+
+   Parameters:
+     * i: the iterator, that points to an element.
+     * elem: the new element.
+*/
+void
+list_iterator_set(struct list_iterator_t *i, void *elem);
+
+/* Free the nodes of the list. The elements are not freed, and the nodes
+   allocated from an arena are freed with the arena.
+
+   Parameters:
+     * l: the list.
+*/
+void
+list_free(struct list_t *l);
+
 #endif
 
@@ -0,0 +1,305 @@
+/* reactor.c
+   Event loop built on top of epoll, signalfd and timerfd.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "reactor.h"
+
+#include <errno.h>          // errno
+#include <stddef.h>         // offsetof
+#include <sys/epoll.h>      // epoll_create1
+#include <sys/signalfd.h>   // signalfd
+#include <sys/timerfd.h>    // timerfd_create
+#include <unistd.h>         // read
+
+// Maximum number of events returned by a single call to epoll_wait
+#define REACTOR_MAX_EVENTS  64
+
+/* Read all the pending signals from the signalfd and pass them to the
+   reactor's signal function.
+
+   Parameters:
+     * h: the handler of the signalfd.
+     * events: the epoll events (not used).
+*/
+static void
+reactor_read_signals(struct reactor_handler_t *h, uint32_t events)
+{
+    // The handler is a member of the reactor that owns it
+    struct reactor_t *r =
+        (struct reactor_t*)((char*)h - offsetof(struct reactor_t, signals));
+    struct signalfd_siginfo si;
+
+    while (read(h->fd, &si, sizeof(si)) == sizeof(si)) {
+        r->on_signal(si.ssi_signo);
+    }
+}
+
+/* Read the expiration count of a timerfd and call the timer's function.
+
+   Parameters:
+     * h: the handler of the timerfd.
+     * events: the epoll events (not used).
+*/
+static void
+reactor_read_timer(struct reactor_handler_t *h, uint32_t events)
+{
+    struct reactor_timer_t *t = (struct reactor_timer_t*)h;
+    uint64_t expirations;
+
+    // The read fails with EAGAIN if the timer was rearmed after the event was
+    // reported, in that case there's nothing to do
+    if (read(h->fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+    {
+        t->expired(t);
+    }
+}
+
+/* Initialize the reactor.
+   The signals in the given set are received through a signalfd, so they
+   must be blocked before calling this function (see reactor_block_signals).
+
+   Parameters:
+     * r: the reactor to initialize.
+     * signals: set of signals to listen to, or NULL for a reactor that
+         doesn't receive signals.
+     * on_signal: function called each time one of the signals is received.
+
+   Return 0 if the reactor was correctly initialized, 1 otherwise, and errno
+   is set accordingly.
+*/
+int
+reactor_init(struct reactor_t *r, const sigset_t *signals,
+    void (*on_signal)(int signum))
+{
+    r->stop = 0;
+    r->error = 0;
+    r->on_signal = on_signal;
+    r->signals.fd = -1;
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->epfd < 0) {
+        return 1;
+    }
+    if (!signals) {
+        return 0;
+    }
+    // Create the signalfd and watch it as any other descriptor
+    r->signals.fd = signalfd(-1, signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (r->signals.fd < 0) {
+        return 1;
+    }
+    r->signals.callback = reactor_read_signals;
+    return reactor_add(r, &(r->signals), EPOLLIN);
+}
+
+/* Block a set of signals, so they are not delivered asynchronously but
+   through the reactor's signalfd.
+
+   Parameters:
+     * signals: the set of signals to block.
+
+   Return 0 if the signals were blocked, 1 otherwise.
+*/
+int
+reactor_block_signals(const sigset_t *signals)
+{
+    return sigprocmask(SIG_BLOCK, signals, NULL) ? 1 : 0;
+}
+
+/* Add a handler to the reactor.
+
+   Parameters:
+     * r: the reactor.
+     * h: the handler. Its fd member must be already set.
+     * events: the epoll events to listen to.
+
+   Return 0 if the handler was added, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+reactor_add(struct reactor_t *r, struct reactor_handler_t *h,
+    uint32_t events)
+{
+    struct epoll_event ev;
+
+    ev.events = events;
+    ev.data.ptr = h;
+    return epoll_ctl(r->epfd, EPOLL_CTL_ADD, h->fd, &ev) ? 1 : 0;
+}
+
+/* Change the handler and the events watched of a descriptor already added to
+   the reactor, i.e. when the object that owns the descriptor is replaced.
+
+   Parameters:
+     * r: the reactor.
+     * h: the new handler, with the descriptor already added.
+     * events: the epoll events to watch (EPOLLIN, EPOLLPRI...).
+
+   Return 0 if the handler was changed, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+reactor_mod(struct reactor_t *r, struct reactor_handler_t *h,
+    uint32_t events)
+{
+    struct epoll_event ev;
+
+    ev.events = events;
+    ev.data.ptr = h;
+    return epoll_ctl(r->epfd, EPOLL_CTL_MOD, h->fd, &ev) ? 1 : 0;
+}
+
+/* Remove a handler from the reactor.
+
+   Parameters:
+     * r: the reactor.
+     * h: the handler to remove.
+
+   Return 0 if the handler was removed, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+reactor_del(struct reactor_t *r, struct reactor_handler_t *h)
+{
+    return epoll_ctl(r->epfd, EPOLL_CTL_DEL, h->fd, NULL) ? 1 : 0;
+}
+
+/* Initialize a timer and add it to the reactor. The timer is created
+   disarmed, so it doesn't wake up the reactor until it is armed.
+
+   Parameters:
+     * r: the reactor.
+     * t: the timer to initialize.
+     * expired: function called when the timer expires.
+
+   Return 0 if the timer was correctly created, 1 otherwise.
+*/
+int
+reactor_timer_init(struct reactor_t *r, struct reactor_timer_t *t,
+    void (*expired)(struct reactor_timer_t *t))
+{
+    t->handler.fd = timerfd_create(
+        CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (t->handler.fd < 0) {
+        return 1;
+    }
+    t->handler.callback = reactor_read_timer;
+    t->expired = expired;
+    return reactor_add(r, &(t->handler), EPOLLIN);
+}
+
+/* Arm a timer.
+
+   Parameters:
+     * t: the timer.
+     * deadline: absolute time, in nanoseconds of CLOCK_MONOTONIC, when the
+         timer must expire. A deadline of 0 disarms the timer.
+
+   Return 0 if the timer was armed, 1 otherwise.
+*/
+int
+reactor_timer_arm(struct reactor_timer_t *t, uint64_t deadline)
+{
+    struct itimerspec its = {{0, 0}, {0, 0}};
+
+    its.it_value.tv_sec = deadline / 1000000000;
+    its.it_value.tv_nsec = deadline % 1000000000;
+    return timerfd_settime(t->handler.fd, TFD_TIMER_ABSTIME, &its, NULL)
+        ? 1 : 0;
+}
+
+/* Close a timer. The timer is removed from the reactor when its descriptor is
+   closed.
+
+   Parameters:
+     * t: the timer.
+*/
+void
+reactor_timer_close(struct reactor_timer_t *t)
+{
+    if (t->handler.fd >= 0) {
+        close(t->handler.fd);
+        t->handler.fd = -1;
+    }
+}
+
+/* Run the main loop until reactor_stop is called.
+
+   Parameters:
+     * r: the reactor.
+
+   Return 0 if the loop was stopped without errors, 1 otherwise.
+*/
+int
+reactor_run(struct reactor_t *r)
+{
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    struct reactor_handler_t *h;
+    int n;
+
+    while (!r->stop) {
+        // Block until any descriptor is ready. There's no timeout, the
+        // signals that stop the loop are also received as descriptor events.
+        n = epoll_wait(r->epfd, events, REACTOR_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        // Only the ready handlers are visited
+        for (int i = 0; i < n; i++) {
+            h = (struct reactor_handler_t*)events[i].data.ptr;
+            h->callback(h, events[i].events);
+        }
+    }
+    return r->error;
+}
+
+/* Stop the main loop of the reactor. The loop finishes after the current
+   batch of events is processed.
+
+   Parameters:
+     * r: the reactor.
+     * error: 1 if the loop is stopped because of an error, 0 otherwise.
+*/
+void
+reactor_stop(struct reactor_t *r, int error)
+{
+    r->stop = 1;
+    r->error |= error;
+}
+
+/* Close the descriptors owned by the reactor.
+
+   Parameters:
+     * r: the reactor.
+*/
+void
+reactor_close(struct reactor_t *r)
+{
+    if (r->signals.fd >= 0) {
+        close(r->signals.fd);
+    }
+    if (r->epfd >= 0) {
+        close(r->epfd);
+    }
+}
+
@@ -0,0 +1,216 @@
+/* reactor.h
+   Event loop built on top of epoll, signalfd and timerfd.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <signal.h>     // sigset_t
+#include <stdint.h>     // uint32_t
+
+struct reactor_handler_t;
+
+/* Function called when the descriptor of a handler is ready.
+
+   Parameters:
+     * h: the handler whose descriptor is ready.
+     * events: the epoll events that are ready (EPOLLIN, EPOLLPRI, ...).
+*/
+typedef void (*reactor_callback_t)(struct reactor_handler_t *h,
+    uint32_t events);
+
+// Something watched by the reactor: a file descriptor and the function to
+// call when it is ready. The handler is what the reactor stores in the epoll
+// data, so if it is the first member of a bigger struct the callback can cast
+// the handler back to that struct without any lookup.
+struct reactor_handler_t {
+    // The file descriptor being watched
+    int fd;
+
+    // Function called when the file descriptor is ready
+    reactor_callback_t callback;
+};
+
+// A one shot timer, implemented with a timerfd.
+struct reactor_timer_t {
+    // The handler of the timerfd. Must be the first member.
+    struct reactor_handler_t handler;
+
+    // Function called when the timer expires
+    void (*expired)(struct reactor_timer_t *t);
+};
+
+// The reactor itself
+struct reactor_t {
+    // The epoll instance
+    int epfd;
+
+    // The signalfd used to receive the signals
+    struct reactor_handler_t signals;
+
+    // Function called for each signal received
+    void (*on_signal)(int signum);
+
+    // Flag that tells the main loop that it must finish
+    int stop;
+
+    // Flag that tells that the main loop was stopped because of an error
+    int error;
+};
+
+// Define to initialize a static instance of struct reactor_t, so it can be
+// closed safely even if reactor_init was never called
+#define REACTOR_INIT    {-1, {-1, 0}, 0, 0, 0}
+
+/* Initialize the reactor.
+   The signals in the given set are received through a signalfd, so they
+   must be blocked before calling this function (see reactor_block_signals).
+
+   Parameters:
+     * r: the reactor to initialize.
+     * signals: set of signals to listen to, or NULL for a reactor that
+         doesn't receive signals.
+     * on_signal: function called each time one of the signals is received.
+
+   Return 0 if the reactor was correctly initialized, 1 otherwise, and errno
+   is set accordingly.
+*/
+int
+reactor_init(struct reactor_t *r, const sigset_t *signals,
+    void (*on_signal)(int signum));
+
+/* Block a set of signals, so they are not delivered asynchronously but
+   through the reactor's signalfd.
+
+   Parameters:
+     * signals: the set of signals to block.
+
+   Return 0 if the signals were blocked, 1 otherwise.
+*/
+int
+reactor_block_signals(const sigset_t *signals);
+
+/* Add a handler to the reactor.
+
+   Parameters:
+     * r: the reactor.
+     * h: the handler. Its fd member must be already set.
+     * events: the epoll events to listen to.
+
+   Return 0 if the handler was added, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+reactor_add(struct reactor_t *r, struct reactor_handler_t *h,
+    uint32_t events);
+
+/* Change the handler and the events watched of a descriptor already added to
+   the reactor, i.e. when the object that owns the descriptor is replaced.
+
+   Parameters:
+     * r: the reactor.
+     * h: the new handler, with the descriptor already added.
+     * events: the epoll events to watch (EPOLLIN, EPOLLPRI...).
+
+   Return 0 if the handler was changed, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+reactor_mod(struct reactor_t *r, struct reactor_handler_t *h,
+    uint32_t events);
+
+/* Remove a handler from the reactor.
+
+   Parameters:
+     * r: the reactor.
+     * h: the handler to remove.
+
+   Return 0 if the handler was removed, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+reactor_del(struct reactor_t *r, struct reactor_handler_t *h);
+
+/* Initialize a timer and add it to the reactor. The timer is created
+   disarmed, so it doesn't wake up the reactor until it is armed.
+
+   Parameters:
+     * r: the reactor.
+     * t: the timer to initialize.
+     * expired: function called when the timer expires.
+
+   Return 0 if the timer was correctly created, 1 otherwise.
+*/
+int
+reactor_timer_init(struct reactor_t *r, struct reactor_timer_t *t,
+    void (*expired)(struct reactor_timer_t *t));
+
+/* Arm a timer.
+
+   Parameters:
+     * t: the timer.
+     * deadline: absolute time, in nanoseconds of CLOCK_MONOTONIC, when the
+         timer must expire. A deadline of 0 disarms the timer.
+
+   Return 0 if the timer was armed, 1 otherwise.
+*/
+int
+reactor_timer_arm(struct reactor_timer_t *t, uint64_t deadline);
+
+/* Close a timer. The timer is removed from the reactor when its descriptor is
+   closed.
+
+   Parameters:
+     * t: the timer.
+*/
+void
+reactor_timer_close(struct reactor_timer_t *t);
+
+/* Run the main loop until reactor_stop is called.
+
+   Parameters:
+     * r: the reactor.
+
+   Return 0 if the loop was stopped without errors, 1 otherwise.
+*/
+int
+reactor_run(struct reactor_t *r);
+
+/* Stop the main loop of the reactor. The loop finishes after the current
+   batch of events is processed.
+
+   Parameters:
+     * r: the reactor.
+     * error: 1 if the loop is stopped because of an error, 0 otherwise.
+*/
+void
+reactor_stop(struct reactor_t *r, int error);
+
+/* Close the descriptors owned by the reactor.
+
+   Parameters:
+     * r: the reactor.
+*/
+void
+reactor_close(struct reactor_t *r);
+
+#endif
+
@@ -0,0 +1,104 @@
+#!/bin/sh
+# reloadtest.sh
+#   Reload the configuration of buttonsd while a button is held, with SIGHUP
+#   and by rewriting the file, and compare the actions executed with the
+#   expected ones.
+#
+#   Copyright 2018 Antonio Serrano Hernandez
+#
+#   This file is part of rfsutils.
+#
+#   rfsutils is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   rfsutils is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with rfsutils; see the file COPYING.  If not, see
+#   <http://www.gnu.org/licenses/>.
+
+data="${srcdir:-.}/testdata"
+dir="$PWD/reloadtest.dir"
+out=reloadtest.out
+
+# Write the configuration, through a temporary file as an editor does. The
+# actions append the pin, the event and the version of the configuration to
+# the output.
+#   * $1: the version.
+#   * $2...: the pins of the clicks, besides 6.
+configure() {
+    version=$1
+    shift
+    action="!echo \$BUTTONSD_PIN \$BUTTONSD_EVENT $version >> $dir/out"
+    {
+        echo "6_click=$action"
+        echo "6_long_click=$action"
+        echo "6_long_click_time=500"
+        for pin; do
+            echo "${pin}_click=$action"
+        done
+    } > "$dir/conf.tmp"
+    mv "$dir/conf.tmp" "$dir/buttons.conf"
+}
+
+# Write an edge (1 pressed, 0 released) of a pin, then wait some time (s)
+edge() {
+    ./simedge "$dir" $1 $2 && sleep $3
+}
+
+click() {
+    edge $1 1 0.05 && edge $1 0 0.3
+}
+
+cleanup() {
+    kill $pid 2> /dev/null
+    wait $pid
+    rm -rf "$dir" $out
+}
+
+rm -rf "$dir"
+mkdir "$dir" || exit 1
+for pin in 6 7 9; do
+    mkfifo "$dir/$pin" || exit 1
+done
+: > "$dir/out"
+configure v1 7
+./buttonsd -c "$dir/buttons.conf" -S "$dir" -w 2> "$dir/log" &
+pid=$!
+trap cleanup EXIT
+
+# A long click held across a SIGHUP, that adds 9 and removes 7. Its timer
+# fires before the click of 9, so it kept the time of the press.
+click 7 || exit 1
+edge 6 1 0.2 || exit 1
+configure v2 9
+kill -HUP $pid
+sleep 0.4
+click 9 || exit 1
+edge 6 0 0.3 || exit 1
+./simedge "$dir" 7 1 2> /dev/null && exit 1
+
+# The same across a rewrite of the file, that adds 7 back and removes 9
+edge 6 1 0.2 || exit 1
+configure v3 7
+sleep 0.4
+click 7 || exit 1
+edge 6 0 0.3 || exit 1
+./simedge "$dir" 9 1 2> /dev/null && exit 1
+
+# A broken file keeps the configuration in use
+echo "6_click" > "$dir/conf.tmp"
+mv "$dir/conf.tmp" "$dir/buttons.conf"
+sleep 0.3
+click 6 || exit 1
+
+kill $pid
+wait $pid || exit 1
+pid=
+cp "$dir/out" $out
+diff -u "$data/reload.out" $out
@@ -0,0 +1,41 @@
+#!/bin/sh
+# replaytest.sh
+#   Replay traces of edges through buttonsd and compare the events recognized
+#   with the expected ones: one recorded from real buttons and one built at
+#   the limits of the times of the gestures.
+#
+#   Copyright 2018 Antonio Serrano Hernandez
+#
+#   This file is part of rfsutils.
+#
+#   rfsutils is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   rfsutils is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with rfsutils; see the file COPYING.  If not, see
+#   <http://www.gnu.org/licenses/>.
+
+data="${srcdir:-.}/testdata"
+out=replaytest.out
+
+# Only the events recognized go to the standard output, the statistics of the
+# replay, that change with each run, go to the standard error.
+#   * buttons: recorded from real buttons.
+#   * timing: a click 1 ms shorter than the default long click and a long
+#     click released when it fires, the hold repeats after a long click, a
+#     double click and two clicks 1 ms too far apart, and bounces within the
+#     debounce window, one of them with no change of level.
+for name in buttons timing; do
+    ./buttonsd -c "$data/$name.conf" -P "$data/$name.trace" > $out \
+        || exit 1
+    diff -u "$data/$name.out" $out || exit 1
+done
+rm -f $out
+
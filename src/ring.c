@@ -0,0 +1,143 @@
+/* ring.c
+   Lock-free ring of edges, with a single producer and a single consumer.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "ring.h"
+
+#include <errno.h>      // EINVAL
+#include <stdlib.h>     // malloc
+
+/* Initialize the ring.
+
+   Parameters:
+     * r: the ring.
+     * size: the minimum number of edges that the ring can keep, rounded up
+         to a power of 2.
+
+   Return 0 if the ring was initialized, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+ring_init(struct ring_t *r, size_t size)
+{
+    size_t n = 1;
+
+    if (!size) {
+        errno = EINVAL;
+        return 1;
+    }
+    // With a power of 2 the indexes wrap with a mask
+    while (n < size) {
+        n <<= 1;
+    }
+    r->edges = (struct ring_edge_t*)malloc(sizeof(struct ring_edge_t) * n);
+    if (!r->edges) {
+        return 1;
+    }
+    r->mask = n - 1;
+    atomic_init(&(r->tail), 0);
+    atomic_init(&(r->head), 0);
+    atomic_init(&(r->overflows), 0);
+    atomic_init(&(r->high_watermark), 0);
+    return 0;
+}
+
+/* Push an edge. Must only be called by the producer.
+
+   Parameters:
+     * r: the ring.
+     * e: the edge.
+
+   Return 0 if the edge was pushed, 1 if the ring was full and the edge was
+   dropped.
+*/
+int
+ring_push(struct ring_t *r, const struct ring_edge_t *e)
+{
+    size_t tail, used;
+
+    tail = atomic_load_explicit(&(r->tail), memory_order_relaxed);
+    // Acquire: the consumer finished reading the slots before the head
+    used = tail - atomic_load_explicit(&(r->head), memory_order_acquire);
+    if (used > r->mask) {
+        atomic_fetch_add_explicit(&(r->overflows), 1, memory_order_relaxed);
+        return 1;
+    }
+    r->edges[tail & r->mask] = *e;
+    // Release: the edge is written before the consumer can see it
+    atomic_store_explicit(&(r->tail), tail + 1, memory_order_release);
+    if (used + 1 > atomic_load_explicit(&(r->high_watermark),
+        memory_order_relaxed))
+    {
+        atomic_store_explicit(&(r->high_watermark), used + 1,
+            memory_order_relaxed);
+    }
+    return 0;
+}
+
+/* Pop an edge. Must only be called by the consumer.
+
+   Parameters:
+     * r: the ring.
+     * e: at output, the edge.
+
+   Return 0 if an edge was popped, 1 if the ring was empty.
+*/
+int
+ring_pop(struct ring_t *r, struct ring_edge_t *e)
+{
+    size_t head;
+
+    head = atomic_load_explicit(&(r->head), memory_order_relaxed);
+    // Acquire: the edges before the tail are completely written
+    if (head == atomic_load_explicit(&(r->tail), memory_order_acquire)) {
+        return 1;
+    }
+    *e = r->edges[head & r->mask];
+    // Release: the slot is read before the producer can reuse it
+    atomic_store_explicit(&(r->head), head + 1, memory_order_release);
+    return 0;
+}
+
+/* Return the number of edges that the ring can keep.
+
+   Parameters:
+     * r: the ring.
+*/
+size_t
+ring_size(const struct ring_t *r)
+{
+    return r->mask + 1;
+}
+
+/* Free the memory used by the ring.
+
+   Parameters:
+     * r: the ring.
+*/
+void
+ring_free(struct ring_t *r)
+{
+    free(r->edges);
+    r->edges = NULL;
+}
+
@@ -0,0 +1,125 @@
+/* ring.h
+   Lock-free ring of edges, with a single producer and a single consumer.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>  // atomic_size_t
+#include <stdint.h>     // uint64_t
+#include <sys/types.h>  // size_t
+
+// Size of a cache line, the indexes of the producer and the consumer are in
+// different lines so they don't bounce between the CPUs
+#define RING_CACHE_LINE 64
+
+// An edge read from a GPIO line
+struct ring_edge_t {
+    // What generated the edge (the button)
+    void *source;
+
+    // The GPIO pin
+    uint32_t pin;
+
+    // Level of the line after the edge (1 high, 0 low)
+    uint32_t level;
+
+    // Time of the edge (ns of CLOCK_MONOTONIC)
+    uint64_t timestamp;
+};
+
+// The ring. The producer only writes the tail and the consumer only writes
+// the head, so no locks are needed.
+struct ring_t {
+    // Index of the next edge to push, it only grows
+    _Alignas(RING_CACHE_LINE) atomic_size_t tail;
+
+    // Number of edges dropped because the ring was full
+    atomic_ulong overflows;
+
+    // Maximum number of edges that the ring has had
+    atomic_size_t high_watermark;
+
+    // Index of the next edge to pop, it only grows
+    _Alignas(RING_CACHE_LINE) atomic_size_t head;
+
+    // The edges
+    _Alignas(RING_CACHE_LINE) struct ring_edge_t *edges;
+
+    // Number of edges of the ring (a power of 2) minus one
+    size_t mask;
+};
+
+/* Initialize the ring.
+
+   Parameters:
+     * r: the ring.
+     * size: the minimum number of edges that the ring can keep, rounded up
+         to a power of 2.
+
+   Return 0 if the ring was initialized, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+ring_init(struct ring_t *r, size_t size);
+
+/* Push an edge. Must only be called by the producer.
+
+   Parameters:
+     * r: the ring.
+     * e: the edge.
+
+   Return 0 if the edge was pushed, 1 if the ring was full and the edge was
+   dropped.
+*/
+int
+ring_push(struct ring_t *r, const struct ring_edge_t *e);
+
+/* Pop an edge. Must only be called by the consumer.
+
+   Parameters:
+     * r: the ring.
+     * e: at output, the edge.
+
+   Return 0 if an edge was popped, 1 if the ring was empty.
+*/
+int
+ring_pop(struct ring_t *r, struct ring_edge_t *e);
+
+/* Return the number of edges that the ring can keep.
+
+   Parameters:
+     * r: the ring.
+*/
+size_t
+ring_size(const struct ring_t *r);
+
+/* Free the memory used by the ring.
+
+   Parameters:
+     * r: the ring.
+*/
+void
+ring_free(struct ring_t *r);
+
+#endif
+
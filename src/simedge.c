@@ -0,0 +1,116 @@
+/* simedge.c
+   Write an edge to a button of a buttonsd simulation, for the tests.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "config.h"
+
+#include <err.h>        // err
+#include <errno.h>      // errno
+#include <fcntl.h>      // open
+#include <linux/gpio.h> // struct gpio_v2_line_event
+#include <limits.h>     // PATH_MAX
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // snprintf
+#include <string.h>     // memset
+#include <time.h>       // clock_gettime
+#include <unistd.h>     // write
+
+#include "parsenum.h"
+
+#define PROGNAME    "simedge"
+
+// Time waited for buttonsd to open the FIFO (ms)
+#define OPEN_TIMEOUT    1000
+
+// Nanoseconds in a millisecond
+#define NS_PER_MS   1000000ULL
+
+// Return the current time of CLOCK_MONOTONIC, in nanoseconds
+uint64_t
+now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Parse a number given in the command line or exit.
+
+   Parameters:
+     * s: the string that contains the number.
+*/
+unsigned int
+parse_arg_number(const char *s)
+{
+    const char *eptr;
+    unsigned int n;
+
+    if (parse_number(s, &eptr, &n) || eptr == s || *eptr != '\0') {
+        errx(1, "invalid number '%s'", s);
+    }
+    return n;
+}
+
+/* Write an edge of a pin to the FIFO DIR/PIN of a simulation of buttonsd
+   (option -S), timestamped as the kernel does, when it is written. The
+   program waits a bit for buttonsd to open the FIFO, and fails if it
+   doesn't, as when the pin is not in the configuration.
+
+   Usage: simedge DIR PIN LEVEL
+*/
+int
+main(int argc, char **argv)
+{
+    struct gpio_v2_line_event ev;
+    char path[PATH_MAX];
+    unsigned int pin, level;
+    uint64_t deadline;
+    int fd;
+
+    if (argc != 4) {
+        errx(1, "usage: " PROGNAME " DIR PIN LEVEL");
+    }
+    pin = parse_arg_number(argv[2]);
+    level = parse_arg_number(argv[3]);
+    snprintf(path, sizeof(path), "%s/%u", argv[1], pin);
+    // Opening a FIFO for writing without blocking fails until there's a
+    // reader
+    deadline = now() + OPEN_TIMEOUT * NS_PER_MS;
+    while ((fd = open(path, O_WRONLY | O_NONBLOCK | O_CLOEXEC)) < 0) {
+        if (errno != ENXIO || now() > deadline) {
+            err(1, "cannot open '%s'", path);
+        }
+        usleep(10000);
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.id = level ? GPIO_V2_LINE_EVENT_RISING_EDGE
+        : GPIO_V2_LINE_EVENT_FALLING_EDGE;
+    ev.offset = pin;
+    ev.timestamp_ns = now();
+    if (write(fd, &ev, sizeof(ev)) != sizeof(ev)) {
+        err(1, "cannot write '%s'", path);
+    }
+    close(fd);
+    return 0;
+}
+
@@ -0,0 +1,230 @@
+/* spawnbench.c
+   Benchmark of the ways of launching the actions of buttonsd.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <err.h>        // err
+#include <getopt.h>     // getopt_long
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // printf
+#include <stdlib.h>     // exit
+#include <string.h>     // memset
+#include <sys/wait.h>   // waitpid
+#include <time.h>       // clock_gettime
+#include <unistd.h>     // fork
+
+#include "action.h"
+#include "parsenum.h"
+
+#define OPTSTRING   "hn:m:"
+#define PROGNAME    "spawnbench"
+
+// Default number of processes launched by each method
+#define DEFAULT_RUNS    1000
+
+// Default size of the memory touched by the benchmark (MB), to have page
+// tables of a size similar to a running daemon
+#define DEFAULT_MEMORY  16
+
+// Command launched by default
+#define DEFAULT_COMMAND "/bin/true"
+
+// Number of processes launched by each method
+unsigned int runs = DEFAULT_RUNS;
+
+// Memory touched before starting (MB)
+unsigned int memory = DEFAULT_MEMORY;
+
+// Command to launch
+const char *command = DEFAULT_COMMAND;
+
+// Print help message and exits
+void
+print_help()
+{
+    printf("Usage: " PROGNAME " [options] [COMMAND]\n"
+"Launch COMMAND (by default " DEFAULT_COMMAND ") many times, with fork and\n"
+"system and with posix_spawn, and print the time spent.\n"
+"Options:\n"
+"  -h, --help              Show this message and exit.\n"
+"  -n N, --runs N          Number of launches per method.\n"
+"  -m MB, --memory MB      Memory touched before starting.\n"
+    );
+    exit(0);
+}
+
+/* Parse a positive number given in the command line or exit.
+
+   Parameters:
+     * s: the string that contains the number.
+*/
+unsigned int
+parse_arg_number(const char *s)
+{
+    const char *eptr;
+    unsigned int n;
+
+    if (parse_number(s, &eptr, &n) || eptr == s || *eptr != '\0') {
+        errx(1, "invalid number '%s'", s);
+    }
+    return n;
+}
+
+/* Parse the command line arguments.
+
+   Parameters:
+     * argc: number of command line arguments.
+     * argv: command line string arguments.
+*/
+void
+parse_args(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {"runs", required_argument, 0, 'n'},
+        {"memory", required_argument, 0, 'm'},
+        {0, 0, 0, 0}
+    };
+    int o;
+
+    do {
+        o = getopt_long(argc, argv, OPTSTRING, long_opts, 0);
+        switch (o) {
+            case 'h':
+                print_help();
+            case 'n':
+                runs = parse_arg_number(optarg);
+                break;
+            case 'm':
+                memory = parse_arg_number(optarg);
+                break;
+            case '?':
+                exit(1);
+            default:
+                break;
+        }
+    } while (o != -1);
+    if (optind < argc) {
+        command = argv[optind];
+    }
+    if (!runs) {
+        errx(1, "the number of runs must be greater than 0");
+    }
+}
+
+// Return the current time of CLOCK_MONOTONIC, in nanoseconds
+uint64_t
+now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Launch the command with fork and system, as buttonsd used to do.
+
+   Parameters:
+     * pid: at output, the process id of the new process.
+
+   Return 0 if the process was launched, 1 otherwise.
+*/
+int
+launch_fork_system(pid_t *pid)
+{
+    *pid = fork();
+    if (*pid < 0) {
+        return 1;
+    } else if (*pid == 0) {
+        _exit(WEXITSTATUS(system(command)));
+    }
+    return 0;
+}
+
+/* Launch the command with action_spawn.
+
+   Parameters:
+     * a: the action, already tokenized.
+     * pid: at output, the process id of the new process.
+
+   Return 0 if the process was launched, 1 otherwise.
+*/
+int
+launch_spawn(struct action_t *a, pid_t *pid)
+{
+    return action_spawn(a, NULL, pid) ? 1 : 0;
+}
+
+/* Run the benchmark of a method and print the results.
+
+   Parameters:
+     * name: the name of the method.
+     * a: the action to launch with action_spawn, or NULL to use fork and
+         system.
+*/
+void
+bench(const char *name, struct action_t *a)
+{
+    uint64_t t0, t1, t2, call = 0, total = 0;
+    pid_t pid;
+
+    for (unsigned int i = 0; i < runs; i++) {
+        t0 = now();
+        if (a ? launch_spawn(a, &pid) : launch_fork_system(&pid)) {
+            err(1, "cannot launch '%s'", command);
+        }
+        t1 = now();
+        waitpid(pid, NULL, 0);
+        t2 = now();
+        call += t1 - t0;
+        total += t2 - t0;
+    }
+    printf("%-16s %14.1f %16.1f\n", name, (double)call / runs / 1000.0,
+        (double)total / runs / 1000.0);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct action_t a;
+    const char *error;
+    char *mem;
+
+    parse_args(argc, argv);
+    if (action_init(&a, command, NULL, &error)) {
+        errx(1, "%s: %s", command, error);
+    }
+    // Touch the memory, so fork has to copy the page tables
+    mem = (char*)malloc((size_t)memory * 1024 * 1024);
+    if (!mem) {
+        err(1, "cannot allocate %u MB", memory);
+    }
+    memset(mem, 1, (size_t)memory * 1024 * 1024);
+    printf("%u launches of '%s', %u MB resident\n", runs, command, memory);
+    printf("%-16s %14s %16s\n", "method", "call (us)", "exec+exit (us)");
+    bench("fork+system", NULL);
+    bench("posix_spawn", &a);
+    action_free(&a);
+    free(mem);
+    return 0;
+}
+
@@ -0,0 +1,806 @@
+/* spawner.c
+   Helper process that launches and reaps the actions of a daemon.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+// sched_setaffinity is a GNU extension
+#define _GNU_SOURCE
+
+#include "spawner.h"
+
+#include <err.h>            // warn
+#include <errno.h>          // errno
+#include <fcntl.h>          // open
+#include <sched.h>          // sched_setscheduler
+#include <stdio.h>          // snprintf
+#include <stdlib.h>         // malloc
+#include <string.h>         // strlen
+#include <sys/mman.h>       // munlockall
+#include <sys/epoll.h>      // EPOLLIN
+#include <sys/socket.h>     // socketpair
+#include <sys/wait.h>       // waitpid
+#include <time.h>           // clock_gettime
+#include <unistd.h>         // fork
+
+#include "supervisor.h"
+
+// Initial number of actions in the tables of actions
+#define SPAWNER_INIT_ACTIONS    16
+
+// Names of the environment variables that describe the event to the action
+#define SPAWNER_ENV_PIN         "BUTTONSD_PIN="
+#define SPAWNER_ENV_EVENT       "BUTTONSD_EVENT="
+#define SPAWNER_ENV_TIMESTAMP   "BUTTONSD_TIMESTAMP="
+
+// Number of environment variables that describe the event to the action
+#define SPAWNER_ENV_VARS        3
+
+extern char **environ;
+
+// Types of messages exchanged between the daemon and the helper
+enum spawner_message_type_t {
+    // Daemon to helper: definition of a new action. The message is followed
+    // by the source, the event and the serialized action (see action_pack).
+    SPAWNER_DEFINE,
+
+    // Daemon to helper: an action is not used anymore
+    SPAWNER_UNDEFINE,
+
+    // Daemon to helper: launch an action
+    SPAWNER_RUN,
+
+    // Daemon to helper: detach from the terminal
+    SPAWNER_DETACH,
+
+    // Helper to daemon: an action has been launched
+    SPAWNER_STARTED,
+
+    // Helper to daemon: an action has finished
+    SPAWNER_FINISHED,
+
+    // Helper to daemon: an action couldn't be launched
+    SPAWNER_FAILED,
+
+    // Helper to daemon: an action undefined has no execution running, its
+    // id can be used by a new action
+    SPAWNER_RELEASED
+};
+
+// Header of all the messages exchanged between the daemon and the helper.
+// The socket is a SOCK_SEQPACKET, so each message is received at once.
+struct spawner_message_t {
+    // Type of message
+    uint32_t type;
+
+    // Id of the action
+    uint32_t id;
+
+    // SPAWNER_RUN: timestamp of the event. SPAWNER_STARTED: time from the
+    // request to the launch. SPAWNER_FINISHED: time that the action was
+    // running.
+    uint64_t time;
+
+    // SPAWNER_FINISHED: exit status. SPAWNER_FAILED: error number.
+    int32_t status;
+
+    // SPAWNER_RUN: time when the request was sent (ns of CLOCK_MONOTONIC)
+    uint64_t sent;
+};
+
+// An action, as known by the helper
+struct helper_action_t {
+    // The action
+    struct action_t action;
+
+    // Environment variables with the source and the event, NULL if the
+    // action is not defined
+    char *source;
+    char *event;
+
+    // Number of executions of the action running
+    unsigned int running;
+};
+
+// Actions defined in the helper, indexed by id
+static struct helper_action_t *helper_actions = NULL;
+
+// Number of actions defined in the helper and size of the table
+static uint32_t helper_nactions = 0, helper_size = 0;
+
+// Environment of the actions. The variables that describe the event are
+// placed at the end, after the ones inherited by the helper.
+static char **helper_envp = NULL;
+
+// Number of environment variables inherited
+static size_t helper_nenv = 0;
+
+// Environment variable with the timestamp of the event
+static char helper_timestamp[sizeof(SPAWNER_ENV_TIMESTAMP) + 24];
+
+// The helper's reactor
+static struct reactor_t helper_reactor = REACTOR_INIT;
+
+// The supervisor of the helper's children
+static struct supervisor_t helper_supervisor;
+
+// The helper's end of the socket
+static struct reactor_handler_t helper_socket;
+
+// Buffer where the helper receives the messages
+static char *helper_buf = NULL;
+
+// Size of the helper's buffer
+static size_t helper_buf_size = 0;
+
+// Return the current time of CLOCK_MONOTONIC, in nanoseconds
+static uint64_t
+spawner_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Receive a message of any size from a socket, enlarging the buffer if
+   necessary.
+
+   Parameters:
+     * fd: the socket.
+     * buf: the buffer. It is reallocated if the message doesn't fit in it.
+     * size: size of the buffer. Updated if the buffer is reallocated.
+
+   Return the length of the message, 0 if the other end was closed and -1 in
+   case of error (EAGAIN if there's no message).
+*/
+static ssize_t
+spawner_recv(int fd, char **buf, size_t *size)
+{
+    ssize_t len;
+    char *b;
+
+    // Obtain the length of the next message
+    len = recv(fd, NULL, 0, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+    if (len <= 0) {
+        return len;
+    }
+    if (len > *size) {
+        b = (char*)realloc(*buf, len);
+        if (!b) {
+            return -1;
+        }
+        *buf = b;
+        *size = len;
+    }
+    return recv(fd, *buf, len, MSG_DONTWAIT);
+}
+
+/* Send a message from the helper to the daemon.
+
+   Parameters:
+     * type: the type of the message.
+     * id: the id of the action.
+     * time: the time field of the message.
+     * status: the status field of the message.
+*/
+static void
+helper_send(uint32_t type, uint32_t id, uint64_t time, int32_t status)
+{
+    struct spawner_message_t m = {type, id, time, status, 0};
+
+    if (send(helper_socket.fd, &m, sizeof(m), MSG_NOSIGNAL) < 0) {
+        warn("spawner: cannot send message");
+    }
+}
+
+/* Send the result of an action to the daemon. Called by the helper's
+   supervisor.
+
+   Parameters:
+     * data: the id of the action.
+     * status: exit status of the action.
+     * duration: time that the action was running.
+*/
+static void
+helper_finished(void *data, int status, uint64_t duration)
+{
+    uint32_t id = (uintptr_t)data;
+    struct helper_action_t *ha = &(helper_actions[id]);
+
+    helper_send(SPAWNER_FINISHED, id, duration, status);
+    // The last execution of an action undefined releases its id
+    if (!--ha->running && !ha->source) {
+        helper_send(SPAWNER_RELEASED, id, 0, 0);
+    }
+}
+
+/* Process a signal received by the helper.
+
+   Parameters:
+     * signum: the signal received.
+*/
+static void
+helper_signal(int signum)
+{
+    if (signum == SIGCHLD) {
+        supervisor_reap(&helper_supervisor);
+    }
+}
+
+/* Build an environment variable given its name and value.
+
+   Parameters:
+     * name: the name of the variable, followed by '='.
+     * value: the value of the variable.
+
+   Return the variable, or NULL if there's no memory.
+*/
+static char*
+helper_env(const char *name, const char *value)
+{
+    char *v;
+
+    v = (char*)malloc(strlen(name) + strlen(value) + 1);
+    if (v) {
+        strcpy(v, name);
+        strcat(v, value);
+    }
+    return v;
+}
+
+/* Define a new action in the helper.
+
+   Parameters:
+     * m: the message that contains the definition.
+     * len: length of the message.
+
+   Return 0 if the action was defined, 1 otherwise.
+*/
+static int
+helper_define(struct spawner_message_t *m, size_t len)
+{
+    const char *source, *event, *packed, *end;
+    struct helper_action_t *ha;
+
+    // The new actions are defined in order, or take the id of an action
+    // released
+    if (m->id > helper_nactions || (m->id < helper_nactions
+        && (helper_actions[m->id].source || helper_actions[m->id].running)))
+    {
+        return 1;
+    }
+    if (m->id == helper_nactions && helper_nactions == helper_size) {
+        helper_size = helper_size ? helper_size * 2 : SPAWNER_INIT_ACTIONS;
+        ha = (struct helper_action_t*)realloc(helper_actions,
+            sizeof(struct helper_action_t) * helper_size);
+        if (!ha) {
+            return 1;
+        }
+        helper_actions = ha;
+    }
+    // Split the source, the event and the action
+    source = (const char*)(m + 1);
+    end = (const char*)m + len;
+    event = memchr(source, '\0', end - source);
+    if (!event++) {
+        return 1;
+    }
+    packed = memchr(event, '\0', end - event);
+    if (!packed++) {
+        return 1;
+    }
+    ha = &(helper_actions[m->id]);
+    if (m->id == helper_nactions) {
+        ha->source = NULL;
+        ha->event = NULL;
+        ha->running = 0;
+        helper_nactions++;
+    }
+    if (action_unpack(&(ha->action), packed, end - packed)) {
+        return 1;
+    }
+    ha->source = helper_env(SPAWNER_ENV_PIN, source);
+    ha->event = helper_env(SPAWNER_ENV_EVENT, event);
+    if (!ha->source || !ha->event) {
+        free(ha->source);
+        ha->source = NULL;
+        free(ha->event);
+        ha->event = NULL;
+        action_free(&(ha->action));
+        return 1;
+    }
+    return 0;
+}
+
+/* Free an action defined in the helper. The requests to launch it fail, and
+   its id is released once its executions running finish.
+
+   Parameters:
+     * m: the message with the id of the action.
+*/
+static void
+helper_undefine(struct spawner_message_t *m)
+{
+    struct helper_action_t *ha;
+
+    if (m->id >= helper_nactions || !helper_actions[m->id].source) {
+        return;
+    }
+    ha = &(helper_actions[m->id]);
+    action_free(&(ha->action));
+    free(ha->source);
+    free(ha->event);
+    ha->source = NULL;
+    ha->event = NULL;
+    if (!ha->running) {
+        helper_send(SPAWNER_RELEASED, m->id, 0, 0);
+    }
+}
+
+/* Launch an action.
+
+   Parameters:
+     * m: the message that requests the action.
+*/
+static void
+helper_run(struct spawner_message_t *m)
+{
+    struct helper_action_t *ha;
+    pid_t pid;
+    int e;
+
+    if (m->id >= helper_nactions || !helper_actions[m->id].source) {
+        helper_send(SPAWNER_FAILED, m->id, 0, EINVAL);
+        return;
+    }
+    ha = &(helper_actions[m->id]);
+    // Complete the environment with the event context
+    snprintf(helper_timestamp, sizeof(helper_timestamp), "%s%llu",
+        SPAWNER_ENV_TIMESTAMP, (unsigned long long)m->time);
+    helper_envp[helper_nenv] = ha->source;
+    helper_envp[helper_nenv + 1] = ha->event;
+    helper_envp[helper_nenv + 2] = helper_timestamp;
+    e = action_spawn(&(ha->action), helper_envp, &pid);
+    if (e) {
+        helper_send(SPAWNER_FAILED, m->id, 0, e);
+        return;
+    }
+    // The clock is system wide, so the delay includes the time that the
+    // request was queued in the socket
+    helper_send(SPAWNER_STARTED, m->id, spawner_now() - m->sent, 0);
+    if (supervisor_add(&helper_supervisor, pid, (void*)(uintptr_t)m->id)) {
+        // The process is reaped anyway, but its result is lost
+        warn("spawner: cannot supervise action '%s'", ha->action.command);
+    } else {
+        ha->running++;
+    }
+}
+
+// Detach the helper from the terminal, as daemonize does with the daemon
+static void
+helper_detach()
+{
+    int fd;
+
+    setsid();
+    if (chdir("/") < 0) {
+        warn("spawner: can't change directory to /");
+    }
+    fd = open("/dev/null", O_RDWR);
+    if (fd >= 0) {
+        dup2(fd, 0);
+        dup2(fd, 1);
+        dup2(fd, 2);
+        if (fd > 2) {
+            close(fd);
+        }
+    }
+}
+
+/* Read the messages sent by the daemon to the helper.
+
+   Parameters:
+     * h: the handler of the helper's socket.
+     * events: the epoll events (not used).
+*/
+static void
+helper_read(struct reactor_handler_t *h, uint32_t events)
+{
+    struct spawner_message_t *m;
+    ssize_t len;
+
+    while ((len = spawner_recv(h->fd, &helper_buf, &helper_buf_size)) > 0) {
+        if (len < sizeof(struct spawner_message_t)) {
+            continue;
+        }
+        m = (struct spawner_message_t*)helper_buf;
+        switch (m->type) {
+            case SPAWNER_DEFINE:
+                if (helper_define(m, len)) {
+                    warnx("spawner: cannot define action %u", m->id);
+                }
+                break;
+            case SPAWNER_UNDEFINE:
+                helper_undefine(m);
+                break;
+            case SPAWNER_RUN:
+                helper_run(m);
+                break;
+            case SPAWNER_DETACH:
+                helper_detach();
+                break;
+            default:
+                break;
+        }
+    }
+    // The daemon has finished (or the socket is broken), so finish too
+    if (len == 0 || errno != EAGAIN) {
+        reactor_stop(&helper_reactor, len != 0);
+    }
+}
+
+/* Reset the helper to the normal scheduling, in all the CPUs and without
+   locked memory. The daemon may have been launched with a real-time class
+   (chrt, taskset) and the actions inherit the settings of the helper, so
+   they never run with the real-time settings of the daemon.
+*/
+static void
+helper_normal_scheduling()
+{
+    struct sched_param param;
+    cpu_set_t cpus;
+
+    param.sched_priority = 0;
+    sched_setscheduler(0, SCHED_OTHER, &param);
+    // The kernel ignores the CPUs that don't exist
+    memset(&cpus, 0xff, sizeof(cpus));
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+    munlockall();
+}
+
+/* Main function of the helper process. Never returns.
+
+   Parameters:
+     * fd: the helper's end of the socket.
+*/
+static void
+helper_main(int fd)
+{
+    sigset_t signals;
+    size_t n = 0;
+
+    // Copy the inherited environment, leaving room for the event context
+    while (environ[n]) n++;
+    helper_envp = (char**)malloc(sizeof(char*) * (n + SPAWNER_ENV_VARS + 1));
+    if (!helper_envp) {
+        warn("spawner: cannot allocate environment");
+        _exit(1);
+    }
+    memcpy(helper_envp, environ, sizeof(char*) * n);
+    helper_nenv = n;
+    helper_envp[n + SPAWNER_ENV_VARS] = NULL;
+    // The actions must not inherit a real-time class
+    helper_normal_scheduling();
+    // The signals blocked by the daemon are blocked here too, but the helper
+    // only listens to SIGCHLD. It finishes when the daemon closes the socket.
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    if (reactor_block_signals(&signals)
+        || reactor_init(&helper_reactor, &signals, helper_signal))
+    {
+        warn("spawner: cannot create the reactor");
+        _exit(1);
+    }
+    if (supervisor_init(&helper_supervisor, helper_finished)) {
+        warn("spawner: cannot create the supervisor");
+        _exit(1);
+    }
+    helper_socket.fd = fd;
+    helper_socket.callback = helper_read;
+    if (reactor_add(&helper_reactor, &helper_socket, EPOLLIN)) {
+        warn("spawner: cannot watch the socket");
+        _exit(1);
+    }
+    _exit(reactor_run(&helper_reactor));
+}
+
+/* Send a message to the helper.
+
+   Parameters:
+     * s: the spawner.
+     * m: the message.
+     * len: length of the message.
+     * flags: flags for send.
+
+   Return 0 if the message was sent, 1 otherwise.
+*/
+static int
+spawner_send(struct spawner_t *s, const void *m, size_t len, int flags)
+{
+    return send(s->handler.fd, m, len, flags | MSG_NOSIGNAL) < 0 ? 1 : 0;
+}
+
+/* Read the messages sent by the helper to the daemon.
+
+   Parameters:
+     * h: the handler of the daemon's socket (the spawner itself).
+     * events: the epoll events (not used).
+*/
+static void
+spawner_read(struct reactor_handler_t *h, uint32_t events)
+{
+    struct spawner_t *s = (struct spawner_t*)h;
+    struct spawner_message_t m;
+    ssize_t len;
+
+    while ((len = recv(h->fd, &m, sizeof(m), MSG_DONTWAIT)) > 0) {
+        if (len < sizeof(m) || m.id >= s->nactions) {
+            continue;
+        }
+        // The id is taken by the next action defined. Nothing else is
+        // received for it, the helper sends this message after the results
+        // of all its executions.
+        if (m.type == SPAWNER_RELEASED) {
+            if (!s->data[m.id]) {
+                s->free_ids[s->nfree++] = m.id;
+            }
+            continue;
+        }
+        // The messages of the actions undefined are dropped
+        if (!s->data[m.id]) {
+            continue;
+        }
+        if (m.type == SPAWNER_STARTED) {
+            s->started(s->data[m.id], m.time);
+        } else if (m.type == SPAWNER_FINISHED) {
+            s->finished(s->data[m.id], m.status, m.time);
+        } else if (m.type == SPAWNER_FAILED) {
+            s->failed(s->data[m.id], m.status);
+        }
+    }
+    if (len == 0 || errno != EAGAIN) {
+        warnx("the spawner process has finished unexpectedly");
+        reactor_del(s->reactor, h);
+        reactor_stop(s->reactor, 1);
+    }
+}
+
+/* Start the helper process. This must be done as soon as possible, while the
+   daemon's address space is still small, because the helper is a copy of
+   it.
+
+   Parameters:
+     * s: the spawner.
+
+   Return 0 if the helper was started, 1 otherwise.
+*/
+int
+spawner_start(struct spawner_t *s)
+{
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds)) {
+        return 1;
+    }
+    s->pid = fork();
+    if (s->pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return 1;
+    } else if (s->pid == 0) {
+        close(fds[0]);
+        helper_main(fds[1]);
+    }
+    close(fds[1]);
+    s->handler.fd = fds[0];
+    s->handler.callback = spawner_read;
+    return 0;
+}
+
+/* Send the definition of an action to the helper. The action can be launched
+   afterwards using the id returned.
+
+   Parameters:
+     * s: the spawner.
+     * a: the action.
+     * source: what triggers the action (the GPIO pin of a button), passed
+         to the action in the environment variable BUTTONSD_PIN.
+     * event: the event that triggers the action, passed to the action in the
+         environment variable BUTTONSD_EVENT.
+     * data: data passed to the callbacks when the action finishes or fails.
+     * id: at output, the id of the action.
+
+   Return 0 if the action was sent to the helper, 1 otherwise.
+*/
+int
+spawner_define(struct spawner_t *s, struct action_t *a, const char *source,
+    const char *event, void *data, uint32_t *id)
+{
+    struct spawner_message_t m = {SPAWNER_DEFINE, s->nactions, 0, 0, 0};
+    size_t slen = strlen(source) + 1, elen = strlen(event) + 1, len;
+    uint32_t *f, size;
+    void **d;
+    char *b;
+
+    // Take the id of an action released, so the tables don't grow with the
+    // reloads of the configuration, or make room for a new one
+    if (s->nfree) {
+        m.id = s->free_ids[s->nfree - 1];
+    } else if (s->nactions == s->size) {
+        size = s->size ? s->size * 2 : SPAWNER_INIT_ACTIONS;
+        f = (uint32_t*)realloc(s->free_ids, sizeof(uint32_t) * size);
+        if (!f) {
+            return 1;
+        }
+        s->free_ids = f;
+        d = (void**)realloc(s->data, sizeof(void*) * size);
+        if (!d) {
+            return 1;
+        }
+        s->data = d;
+        s->size = size;
+    }
+    // Build the message
+    len = sizeof(m) + slen + elen + action_pack(a, NULL, 0);
+    if (len > s->buf_size) {
+        b = (char*)realloc(s->buf, len);
+        if (!b) {
+            return 1;
+        }
+        s->buf = b;
+        s->buf_size = len;
+    }
+    memcpy(s->buf, &m, sizeof(m));
+    memcpy(s->buf + sizeof(m), source, slen);
+    memcpy(s->buf + sizeof(m) + slen, event, elen);
+    action_pack(a, s->buf + sizeof(m) + slen + elen,
+        len - sizeof(m) - slen - elen);
+    if (spawner_send(s, s->buf, len, 0)) {
+        return 1;
+    }
+    s->data[m.id] = data;
+    *id = m.id;
+    if (m.id == s->nactions) {
+        s->nactions++;
+    } else {
+        s->nfree--;
+    }
+    return 0;
+}
+
+/* Change the data passed to the callbacks of an action already defined, i.e.
+   when the object that owns the action is replaced.
+
+   Parameters:
+     * s: the spawner.
+     * id: the id of the action.
+     * data: the new data.
+*/
+void
+spawner_set_data(struct spawner_t *s, uint32_t id, void *data)
+{
+    if (id < s->nactions) {
+        s->data[id] = data;
+    }
+}
+
+/* Remove the definition of an action from the helper. The results of the
+   executions of the action still running are not reported, and the id is
+   given to a new action once all of them finish.
+
+   Parameters:
+     * s: the spawner.
+     * id: the id of the action.
+
+   Return 0 if the request was sent, 1 otherwise.
+*/
+int
+spawner_undefine(struct spawner_t *s, uint32_t id)
+{
+    struct spawner_message_t m = {SPAWNER_UNDEFINE, id, 0, 0, 0};
+
+    if (id >= s->nactions) {
+        return 1;
+    }
+    s->data[id] = NULL;
+    return spawner_send(s, &m, sizeof(m), 0);
+}
+
+/* Ask the helper to launch an action. The function doesn't wait for the
+   action to be launched.
+
+   Parameters:
+     * s: the spawner.
+     * id: the id of the action.
+     * timestamp: time of the event that triggers the action (ns of
+         CLOCK_MONOTONIC), passed to the action in the environment variable
+         BUTTONSD_TIMESTAMP.
+
+   Return 0 if the request was sent, 1 otherwise.
+*/
+int
+spawner_run(struct spawner_t *s, uint32_t id, uint64_t timestamp)
+{
+    struct spawner_message_t m = {SPAWNER_RUN, id, timestamp, 0,
+        spawner_now()};
+
+    // Never block the daemon, if the helper is overwhelmed the request fails
+    return spawner_send(s, &m, sizeof(m), MSG_DONTWAIT);
+}
+
+/* Detach the helper from the terminal, after the daemon has been daemonized.
+
+   Parameters:
+     * s: the spawner.
+
+   Return 0 if the request was sent, 1 otherwise.
+*/
+int
+spawner_detach(struct spawner_t *s)
+{
+    struct spawner_message_t m = {SPAWNER_DETACH, 0, 0, 0, 0};
+
+    return spawner_send(s, &m, sizeof(m), 0);
+}
+
+/* Add the spawner to a reactor, to receive the results of the actions.
+
+   Parameters:
+     * s: the spawner.
+     * r: the reactor.
+     * started: function called each time an action is launched.
+     * finished: function called each time an action finishes.
+     * failed: function called each time an action cannot be launched.
+
+   Return 0 if the spawner was added to the reactor, 1 otherwise.
+*/
+int
+spawner_watch(struct spawner_t *s, struct reactor_t *r,
+    spawner_started_t started, spawner_finished_t finished,
+    spawner_failed_t failed)
+{
+    s->reactor = r;
+    s->started = started;
+    s->finished = finished;
+    s->failed = failed;
+    return reactor_add(r, &(s->handler), EPOLLIN);
+}
+
+/* Stop the helper process. The actions still running are not killed.
+
+   Parameters:
+     * s: the spawner.
+*/
+void
+spawner_stop(struct spawner_t *s)
+{
+    if (s->handler.fd >= 0) {
+        // The helper finishes when it finds the socket closed
+        close(s->handler.fd);
+        s->handler.fd = -1;
+        // The helper is not a child of the daemon anymore if the daemon was
+        // daemonized, in that case waitpid just fails
+        waitpid(s->pid, NULL, 0);
+    }
+    free(s->data);
+    free(s->free_ids);
+    free(s->buf);
+}
+
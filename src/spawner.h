@@ -0,0 +1,206 @@
+/* spawner.h
+   Helper process that launches and reaps the actions of a daemon.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPAWNER_H
+#define SPAWNER_H
+
+#include <stdint.h>     // uint32_t
+#include <sys/types.h>  // pid_t
+
+#include "action.h"
+#include "reactor.h"
+
+/* Function called when the spawner has launched an action.
+
+   Parameters:
+     * data: the data given when the action was defined.
+     * delay: time from the request to the launch, in nanoseconds.
+*/
+typedef void (*spawner_started_t)(void *data, uint64_t delay);
+
+/* Function called when an action launched by the spawner finishes.
+
+   Parameters:
+     * data: the data given when the action was defined.
+     * status: the exit status of the action, as returned by waitpid.
+     * duration: time that the action was running, in nanoseconds.
+*/
+typedef void (*spawner_finished_t)(void *data, int status,
+    uint64_t duration);
+
+/* Function called when the spawner cannot launch an action.
+
+   Parameters:
+     * data: the data given when the action was defined.
+     * error: the error number.
+*/
+typedef void (*spawner_failed_t)(void *data, int error);
+
+// The daemon's side of the spawner
+struct spawner_t {
+    // The reactor handler of the socket connected to the helper process. It
+    // is the first member, so the spawner is what the reactor passes to the
+    // callback.
+    struct reactor_handler_t handler;
+
+    // Process id of the helper process
+    pid_t pid;
+
+    // Data of each action defined, indexed by the action's id
+    void **data;
+
+    // Number of ids given to the actions and size of the data array
+    uint32_t nactions, size;
+
+    // Ids of the actions undefined that the helper has released, to give
+    // them to new actions, and number of them
+    uint32_t *free_ids;
+    uint32_t nfree;
+
+    // The reactor that receives the messages from the helper
+    struct reactor_t *reactor;
+
+    // Function called when an action is launched
+    spawner_started_t started;
+
+    // Function called when an action finishes
+    spawner_finished_t finished;
+
+    // Function called when an action cannot be launched
+    spawner_failed_t failed;
+
+    // Buffer used to build the messages
+    char *buf;
+
+    // Size of the buffer
+    size_t buf_size;
+};
+
+// Define to initialize a static instance of struct spawner_t
+#define SPAWNER_INIT    {{-1, 0}, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+
+/* Start the helper process. This must be done as soon as possible, while the
+   daemon's address space is still small, because the helper is a copy of
+   it.
+
+   Parameters:
+     * s: the spawner.
+
+   Return 0 if the helper was started, 1 otherwise.
+*/
+int
+spawner_start(struct spawner_t *s);
+
+/* Send the definition of an action to the helper. The action can be launched
+   afterwards using the id returned.
+
+   Parameters:
+     * s: the spawner.
+     * a: the action.
+     * source: what triggers the action (the GPIO pin of a button), passed
+         to the action in the environment variable BUTTONSD_PIN.
+     * event: the event that triggers the action, passed to the action in the
+         environment variable BUTTONSD_EVENT.
+     * data: data passed to the callbacks when the action finishes or fails.
+     * id: at output, the id of the action.
+
+   Return 0 if the action was sent to the helper, 1 otherwise.
+*/
+int
+spawner_define(struct spawner_t *s, struct action_t *a, const char *source,
+    const char *event, void *data, uint32_t *id);
+
+/* Change the data passed to the callbacks of an action already defined, i.e.
+   when the object that owns the action is replaced.
+
+   Parameters:
+     * s: the spawner.
+     * id: the id of the action.
+     * data: the new data.
+*/
+void
+spawner_set_data(struct spawner_t *s, uint32_t id, void *data);
+
+/* Remove the definition of an action from the helper. The results of the
+   executions of the action still running are not reported, and the id is
+   given to a new action once all of them finish.
+
+   Parameters:
+     * s: the spawner.
+     * id: the id of the action.
+
+   Return 0 if the request was sent, 1 otherwise.
+*/
+int
+spawner_undefine(struct spawner_t *s, uint32_t id);
+
+/* Ask the helper to launch an action. The function doesn't wait for the
+   action to be launched.
+
+   Parameters:
+     * s: the spawner.
+     * id: the id of the action.
+     * timestamp: time of the event that triggers the action (ns of
+         CLOCK_MONOTONIC), passed to the action in the environment variable
+         BUTTONSD_TIMESTAMP.
+
+   Return 0 if the request was sent, 1 otherwise.
+*/
+int
+spawner_run(struct spawner_t *s, uint32_t id, uint64_t timestamp);
+
+/* Detach the helper from the terminal, after the daemon has been daemonized.
+
+   Parameters:
+     * s: the spawner.
+
+   Return 0 if the request was sent, 1 otherwise.
+*/
+int
+spawner_detach(struct spawner_t *s);
+
+/* Add the spawner to a reactor, to receive the results of the actions.
+
+   Parameters:
+     * s: the spawner.
+     * r: the reactor.
+     * started: function called each time an action is launched.
+     * finished: function called each time an action finishes.
+     * failed: function called each time an action cannot be launched.
+
+   Return 0 if the spawner was added to the reactor, 1 otherwise.
+*/
+int
+spawner_watch(struct spawner_t *s, struct reactor_t *r,
+    spawner_started_t started, spawner_finished_t finished,
+    spawner_failed_t failed);
+
+/* Stop the helper process. The actions still running are not killed.
+
+   Parameters:
+     * s: the spawner.
+*/
+void
+spawner_stop(struct spawner_t *s);
+
+#endif
+
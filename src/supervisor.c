@@ -0,0 +1,118 @@
+/* supervisor.c
+   Supervision of the child processes launched by a daemon.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "supervisor.h"
+
+#include <stdlib.h>     // malloc
+#include <sys/wait.h>   // waitpid
+#include <time.h>       // clock_gettime
+
+// Return the current time of CLOCK_MONOTONIC, in nanoseconds
+static uint64_t
+supervisor_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Initialize the supervisor.
+
+   Parameters:
+     * s: the supervisor.
+     * finished: function called each time a supervised child finishes.
+
+   Return 0 if the supervisor was correctly initialized, 1 otherwise.
+*/
+int
+supervisor_init(struct supervisor_t *s, supervisor_callback_t finished)
+{
+    s->free = NULL;
+    s->finished = finished;
+    return dictint_init(&(s->children), NULL);
+}
+
+/* Start supervising a child process.
+
+   Parameters:
+     * s: the supervisor.
+     * pid: the process id of the child.
+     * data: data passed to the finished callback when the child finishes.
+
+   Return 0 if the child is supervised, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+supervisor_add(struct supervisor_t *s, pid_t pid, void *data)
+{
+    struct child_t *c;
+
+    // Reuse a free record if possible
+    if (s->free) {
+        c = s->free;
+        s->free = c->next;
+    } else {
+        c = (struct child_t*)malloc(sizeof(struct child_t));
+        if (!c) {
+            return 1;
+        }
+    }
+    c->pid = pid;
+    c->start = supervisor_now();
+    c->data = data;
+    if (dictint_add(&(s->children), pid, c)) {
+        c->next = s->free;
+        s->free = c;
+        return 1;
+    }
+    return 0;
+}
+
+/* Reap all the children that have finished. This function must be called
+   when SIGCHLD is received. The finished callback is called for each
+   supervised child reaped. Children that were not added to the supervisor
+   are reaped too, but silently.
+
+   Parameters:
+     * s: the supervisor.
+*/
+void
+supervisor_reap(struct supervisor_t *s)
+{
+    struct child_t *c;
+    pid_t pid;
+    int status;
+
+    // Several children may finish before the signal is processed, and only
+    // one SIGCHLD is queued for all of them, so loop until there's nothing
+    // more to reap
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        c = dictint_remove(&(s->children), pid);
+        if (c) {
+            s->finished(c->data, status, supervisor_now() - c->start);
+            c->next = s->free;
+            s->free = c;
+        }
+    }
+}
+
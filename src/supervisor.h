@@ -0,0 +1,105 @@
+/* supervisor.h
+   Supervision of the child processes launched by a daemon.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdint.h>     // uint64_t
+#include <sys/types.h>  // pid_t
+
+#include "dictint.h"
+
+// A child process being supervised
+struct child_t {
+    // Process id of the child
+    pid_t pid;
+
+    // Time when the child was launched (ns of CLOCK_MONOTONIC)
+    uint64_t start;
+
+    // Data given when the child was added, passed back when it finishes
+    void *data;
+
+    // Next child in the list of free records
+    struct child_t *next;
+};
+
+/* Function called when a supervised child finishes.
+
+   Parameters:
+     * data: the data given when the child was added.
+     * status: the exit status of the child, as returned by waitpid.
+     * duration: time that the child was running, in nanoseconds.
+*/
+typedef void (*supervisor_callback_t)(void *data, int status,
+    uint64_t duration);
+
+// The supervisor
+struct supervisor_t {
+    // Dictionary of the running children, indexed by pid
+    struct dictint_t children;
+
+    // List of child records that can be reused, so launching a child doesn't
+    // allocate memory once the supervisor has seen enough children
+    struct child_t *free;
+
+    // Function called when a child finishes
+    supervisor_callback_t finished;
+};
+
+/* Initialize the supervisor.
+
+   Parameters:
+     * s: the supervisor.
+     * finished: function called each time a supervised child finishes.
+
+   Return 0 if the supervisor was correctly initialized, 1 otherwise.
+*/
+int
+supervisor_init(struct supervisor_t *s, supervisor_callback_t finished);
+
+/* Start supervising a child process.
+
+   Parameters:
+     * s: the supervisor.
+     * pid: the process id of the child.
+     * data: data passed to the finished callback when the child finishes.
+
+   Return 0 if the child is supervised, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+supervisor_add(struct supervisor_t *s, pid_t pid, void *data);
+
+/* Reap all the children that have finished. This function must be called
+   when SIGCHLD is received. The finished callback is called for each
+   supervised child reaped. Children that were not added to the supervisor
+   are reaped too, but silently.
+
+   Parameters:
+     * s: the supervisor.
+*/
+void
+supervisor_reap(struct supervisor_t *s);
+
+#endif
+
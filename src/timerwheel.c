@@ -0,0 +1,297 @@
+/* timerwheel.c
+   Hierarchical timing wheel, to keep many timers with a single timerfd.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "timerwheel.h"
+
+#include <string.h>     // memset
+
+// Mask of the slot index
+#define SLOT_MASK   (TIMERWHEEL_SLOTS - 1)
+
+// Number of ticks covered by the whole wheel (bits)
+#define WHEEL_BITS  (TIMERWHEEL_LEVELS * TIMERWHEEL_SLOT_BITS)
+
+/* Link a timer in the slot that corresponds to its tick. A timer goes to the
+   lowest level whose upper digits (the digits of the tick in base 64) are
+   the same that the ones of the current tick, so the timers of level 0 are
+   in the current 64 ticks, the ones of level 1 in the current 4096 ticks,
+   and so on. When the current tick enters a slot of an upper level, the
+   timers of that slot are moved to the lower levels (see cascade).
+
+   Parameters:
+     * w: the wheel.
+     * t: the timer, its tick must not be before the current tick.
+*/
+static void
+link_timer(struct timerwheel_t *w, struct timerwheel_timer_t *t)
+{
+    struct timerwheel_timer_t **head;
+    int level = 0, shift;
+
+    while (level < TIMERWHEEL_LEVELS) {
+        shift = (level + 1) * TIMERWHEEL_SLOT_BITS;
+        if ((t->expires >> shift) == (w->now >> shift)) {
+            break;
+        }
+        level++;
+    }
+    t->level = level;
+    if (level == TIMERWHEEL_LEVELS) {
+        head = &(w->overflow);
+    } else {
+        t->slot = (t->expires >> (level * TIMERWHEEL_SLOT_BITS)) & SLOT_MASK;
+        head = &(w->slots[level][t->slot]);
+        w->occupied[level] |= (uint64_t)1 << t->slot;
+    }
+    t->next = *head;
+    if (t->next) {
+        t->next->pprev = &(t->next);
+    }
+    *head = t;
+    t->pprev = head;
+}
+
+/* Unlink a timer from its slot.
+
+   Parameters:
+     * w: the wheel.
+     * t: the timer, it must be armed.
+*/
+static void
+unlink_timer(struct timerwheel_t *w, struct timerwheel_timer_t *t)
+{
+    *(t->pprev) = t->next;
+    if (t->next) {
+        t->next->pprev = t->pprev;
+    }
+    t->pprev = NULL;
+    if (t->level < TIMERWHEEL_LEVELS && !w->slots[t->level][t->slot]) {
+        w->occupied[t->level] &= ~((uint64_t)1 << t->slot);
+    }
+}
+
+/* Move the timers of a list to the slots that correspond to them now.
+
+   Parameters:
+     * w: the wheel.
+     * head: the list of timers.
+*/
+static void
+cascade(struct timerwheel_t *w, struct timerwheel_timer_t **head)
+{
+    struct timerwheel_timer_t *t = *head, *next;
+
+    if (!t) {
+        return;
+    }
+    // Detach the whole list first, the timers of the overflow list can go
+    // back to it
+    if (t->level < TIMERWHEEL_LEVELS) {
+        w->occupied[t->level] &= ~((uint64_t)1 << t->slot);
+    }
+    *head = NULL;
+    while (t) {
+        next = t->next;
+        link_timer(w, t);
+        t = next;
+    }
+}
+
+/* Return the next tick when something must be done: expire the timers of a
+   slot of level 0 or cascade a slot of an upper level. Only the occupied
+   slots are taken into account, using the bit maps, so the empty ticks are
+   skipped.
+
+   Parameters:
+     * w: the wheel.
+*/
+static uint64_t
+next_tick(const struct timerwheel_t *w)
+{
+    uint64_t next, tick, mask;
+    unsigned int shift, digit;
+
+    // The overflow list is checked each time the whole wheel turns
+    next = ((w->now >> WHEEL_BITS) + 1) << WHEEL_BITS;
+    for (int level = 0; level < TIMERWHEEL_LEVELS; level++) {
+        shift = level * TIMERWHEEL_SLOT_BITS;
+        digit = (w->now >> shift) & SLOT_MASK;
+        // The occupied slots are always after the current one
+        mask = digit == SLOT_MASK ? 0 : w->occupied[level] >> (digit + 1);
+        if (mask) {
+            tick = (w->now >> (shift + TIMERWHEEL_SLOT_BITS))
+                << (shift + TIMERWHEEL_SLOT_BITS);
+            tick += (uint64_t)(digit + 1 + __builtin_ctzll(mask)) << shift;
+            if (tick < next) {
+                next = tick;
+            }
+        }
+    }
+    return next;
+}
+
+/* Initialize the wheel, without timers.
+
+   Parameters:
+     * w: the wheel.
+     * resolution: duration of a tick, in nanoseconds. The timers expire at
+         the first tick after their deadline.
+     * now: current time (ns of CLOCK_MONOTONIC).
+*/
+void
+timerwheel_init(struct timerwheel_t *w, uint64_t resolution, uint64_t now)
+{
+    memset(w, 0, sizeof(struct timerwheel_t));
+    w->resolution = resolution;
+    w->now = now / resolution;
+}
+
+/* Initialize a timer, not armed.
+
+   Parameters:
+     * t: the timer.
+     * expired: function called when the timer expires.
+*/
+void
+timerwheel_timer_init(struct timerwheel_timer_t *t,
+    timerwheel_callback_t expired)
+{
+    t->next = NULL;
+    t->pprev = NULL;
+    t->deadline = 0;
+    t->expires = 0;
+    t->expired = expired;
+}
+
+/* Arm a timer, or move it if it was already armed. The cost doesn't depend
+   on the number of timers.
+
+   Parameters:
+     * w: the wheel.
+     * t: the timer.
+     * deadline: time when the timer must expire (ns of CLOCK_MONOTONIC). A
+         deadline in the past expires at the next advance of the wheel.
+*/
+void
+timerwheel_arm(struct timerwheel_t *w, struct timerwheel_timer_t *t,
+    uint64_t deadline)
+{
+    if (t->pprev) {
+        unlink_timer(w, t);
+    } else {
+        w->count++;
+    }
+    t->deadline = deadline;
+    // Round up, so the timer never expires before its deadline
+    t->expires = (deadline + w->resolution - 1) / w->resolution;
+    if (t->expires <= w->now) {
+        t->expires = w->now + 1;
+    }
+    link_timer(w, t);
+}
+
+/* Cancel a timer. Nothing is done if the timer isn't armed.
+
+   Parameters:
+     * w: the wheel.
+     * t: the timer.
+*/
+void
+timerwheel_cancel(struct timerwheel_t *w, struct timerwheel_timer_t *t)
+{
+    if (t->pprev) {
+        unlink_timer(w, t);
+        w->count--;
+    }
+}
+
+/* Return 1 if a timer is armed, 0 otherwise.
+
+   Parameters:
+     * t: the timer.
+*/
+int
+timerwheel_armed(const struct timerwheel_timer_t *t)
+{
+    return t->pprev != NULL;
+}
+
+/* Advance the wheel up to the current time, calling the functions of the
+   timers that expire. The functions can arm and cancel any timer.
+
+   Parameters:
+     * w: the wheel.
+     * now: current time (ns of CLOCK_MONOTONIC).
+*/
+void
+timerwheel_advance(struct timerwheel_t *w, uint64_t now)
+{
+    struct timerwheel_timer_t **head, *t;
+    uint64_t target = now / w->resolution, tick;
+    unsigned int shift;
+
+    while ((tick = next_tick(w)) <= target) {
+        w->now = tick;
+        // Move down the timers of the upper slots entered in this tick,
+        // from the top, so a timer can go down several levels at once
+        if (!(tick & (((uint64_t)1 << WHEEL_BITS) - 1))) {
+            cascade(w, &(w->overflow));
+        }
+        for (int level = TIMERWHEEL_LEVELS - 1; level > 0; level--) {
+            shift = level * TIMERWHEEL_SLOT_BITS;
+            if (!(tick & (((uint64_t)1 << shift) - 1))) {
+                cascade(w, &(w->slots[level][(tick >> shift) & SLOT_MASK]));
+            }
+        }
+        // Expire the timers of the current slot. They are unlinked one by
+        // one, because each function can cancel other timers.
+        head = &(w->slots[0][tick & SLOT_MASK]);
+        while ((t = *head)) {
+            unlink_timer(w, t);
+            w->count--;
+            t->expired(t);
+        }
+    }
+    // No slot is entered until the target, so the current tick can jump
+    if (target > w->now) {
+        w->now = target;
+    }
+}
+
+/* Return the time when the wheel must be advanced next (ns of
+   CLOCK_MONOTONIC), or 0 if there's no timers. That time is never later than
+   the first deadline, but it can be earlier when far timers must be moved
+   to a lower level.
+
+   Parameters:
+     * w: the wheel.
+*/
+uint64_t
+timerwheel_next(const struct timerwheel_t *w)
+{
+    if (!w->count) {
+        return 0;
+    }
+    return next_tick(w) * w->resolution;
+}
+
@@ -0,0 +1,164 @@
+/* timerwheel.h
+   Hierarchical timing wheel, to keep many timers with a single timerfd.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>     // uint64_t
+
+// Number of levels of the wheel and number of slots of each level (bits of
+// the slot index). A level covers 64 times the time of the previous one, so
+// with 1 ms ticks the wheel covers 4.6 hours, farther timers wait in an
+// overflow list.
+#define TIMERWHEEL_LEVELS       4
+#define TIMERWHEEL_SLOT_BITS    6
+#define TIMERWHEEL_SLOTS        (1 << TIMERWHEEL_SLOT_BITS)
+
+struct timerwheel_timer_t;
+
+/* Function called when a timer expires.
+
+   Parameters:
+     * t: the timer that expired.
+*/
+typedef void (*timerwheel_callback_t)(struct timerwheel_timer_t *t);
+
+// A one shot timer. The timer is intrusive: it is a member of the struct
+// that owns it and the wheel only links it, so arming and cancelling it
+// never allocates.
+struct timerwheel_t;
+struct timerwheel_timer_t {
+    // Next timer in the same slot
+    struct timerwheel_timer_t *next;
+
+    // Pointer that points to this timer in the slot, NULL if not armed
+    struct timerwheel_timer_t **pprev;
+
+    // Time when the timer expires (ns of CLOCK_MONOTONIC)
+    uint64_t deadline;
+
+    // Tick when the timer expires
+    uint64_t expires;
+
+    // Level and slot where the timer is
+    unsigned char level, slot;
+
+    // Function called when the timer expires
+    timerwheel_callback_t expired;
+};
+
+// The timing wheel
+struct timerwheel_t {
+    // Lists of timers of each slot of each level
+    struct timerwheel_timer_t *slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+
+    // Bit map of the slots that have any timer, for each level
+    uint64_t occupied[TIMERWHEEL_LEVELS];
+
+    // List of the timers beyond the last level
+    struct timerwheel_timer_t *overflow;
+
+    // Current tick
+    uint64_t now;
+
+    // Duration of a tick (ns)
+    uint64_t resolution;
+
+    // Number of timers armed
+    unsigned int count;
+};
+
+/* Initialize the wheel, without timers.
+
+   Parameters:
+     * w: the wheel.
+     * resolution: duration of a tick, in nanoseconds. The timers expire at
+         the first tick after their deadline.
+     * now: current time (ns of CLOCK_MONOTONIC).
+*/
+void
+timerwheel_init(struct timerwheel_t *w, uint64_t resolution, uint64_t now);
+
+/* Initialize a timer, not armed.
+
+   Parameters:
+     * t: the timer.
+     * expired: function called when the timer expires.
+*/
+void
+timerwheel_timer_init(struct timerwheel_timer_t *t,
+    timerwheel_callback_t expired);
+
+/* Arm a timer, or move it if it was already armed. The cost doesn't depend
+   on the number of timers.
+
+   Parameters:
+     * w: the wheel.
+     * t: the timer.
+     * deadline: time when the timer must expire (ns of CLOCK_MONOTONIC). A
+         deadline in the past expires at the next advance of the wheel.
+*/
+void
+timerwheel_arm(struct timerwheel_t *w, struct timerwheel_timer_t *t,
+    uint64_t deadline);
+
+/* Cancel a timer. Nothing is done if the timer isn't armed.
+
+   Parameters:
+     * w: the wheel.
+     * t: the timer.
+*/
+void
+timerwheel_cancel(struct timerwheel_t *w, struct timerwheel_timer_t *t);
+
+/* Return 1 if a timer is armed, 0 otherwise.
+
+   Parameters:
+     * t: the timer.
+*/
+int
+timerwheel_armed(const struct timerwheel_timer_t *t);
+
+/* Advance the wheel up to the current time, calling the functions of the
+   timers that expire. The functions can arm and cancel any timer.
+
+   Parameters:
+     * w: the wheel.
+     * now: current time (ns of CLOCK_MONOTONIC).
+*/
+void
+timerwheel_advance(struct timerwheel_t *w, uint64_t now);
+
+/* Return the time when the wheel must be advanced next (ns of
+   CLOCK_MONOTONIC), or 0 if there's no timers. That time is never later than
+   the first deadline, but it can be earlier when far timers must be moved
+   to a lower level.
+
+   Parameters:
+     * w: the wheel.
+*/
+uint64_t
+timerwheel_next(const struct timerwheel_t *w);
+
+#endif
+
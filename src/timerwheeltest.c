@@ -0,0 +1,288 @@
+/* timerwheeltest.c
+   Test of the timing wheel against a brute-force model of its timers.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <err.h>        // errx
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // printf
+#include <stdlib.h>     // random
+
+#include "timerwheel.h"
+
+#define PROGNAME    "timerwheeltest"
+
+// Duration of a tick (ns)
+#define RESOLUTION  1000
+
+// Number of timers and of advances of the wheel
+#define TIMERS      1000
+#define ADVANCES    200000
+
+// Ticks covered by each level of the wheel: 64, 64^2, 64^3 and 64^4
+#define LEVEL_TICKS(l)  ((uint64_t)1 << (((l) + 1) * TIMERWHEEL_SLOT_BITS))
+
+// Fail the test if a condition doesn't hold
+#define CHECK(c)    do { \
+        if (!(c)) { \
+            errx(1, "%s:%d: check failed: %s", __FILE__, __LINE__, #c); \
+        } \
+    } while (0)
+
+// A timer of the test and its model
+struct test_timer_t {
+    // The timer in the wheel
+    struct timerwheel_timer_t timer;
+
+    // The model: if the timer is armed, the tick when it must expire and the
+    // tick when it was armed
+    int armed;
+    uint64_t expires, armed_at;
+};
+
+// The timers
+struct test_timer_t timers[TIMERS];
+
+// The wheel under test
+struct timerwheel_t wheel;
+
+// Number of timers armed in the model
+unsigned int armed = 0;
+
+// Tick when the last timer expired, to check the order
+uint64_t last_expired = 0;
+
+// Number of timers expired by how far they were armed: in the range of each
+// level of the wheel, and beyond the wheel
+unsigned long expired_by_level[TIMERWHEEL_LEVELS + 1];
+
+// Number of timers just cascaded that were cancelled by the expired
+// functions
+unsigned long cascade_cancels = 0;
+
+// Return a random 64 bits number
+uint64_t
+random64()
+{
+    return ((uint64_t)random() << 33) ^ ((uint64_t)random() << 11)
+        ^ (uint64_t)random();
+}
+
+/* Return a random delay from the current tick (ns). The delays are spread
+   over all the levels of the wheel and beyond them, and some fall on the
+   ticks where the levels are cascaded.
+*/
+uint64_t
+random_delay()
+{
+    uint64_t ticks, boundary;
+    int level = random() % (TIMERWHEEL_LEVELS + 2);
+
+    if (level <= TIMERWHEEL_LEVELS) {
+        // Up to 4 times the wheel for the overflow list
+        ticks = random64() % (level < TIMERWHEEL_LEVELS ? LEVEL_TICKS(level)
+            : 4 * LEVEL_TICKS(TIMERWHEEL_LEVELS - 1));
+    } else {
+        // Around the next tick that cascades a level
+        level = random() % TIMERWHEEL_LEVELS;
+        boundary = (wheel.now / LEVEL_TICKS(level) + 1) * LEVEL_TICKS(level);
+        ticks = boundary - wheel.now + random() % 3 - 1;
+    }
+    return ticks * RESOLUTION + random() % RESOLUTION;
+}
+
+/* Arm a timer in the wheel and in the model.
+
+   Parameters:
+     * t: the timer.
+     * deadline: its deadline (ns).
+*/
+void
+arm(struct test_timer_t *t, uint64_t deadline)
+{
+    timerwheel_arm(&wheel, &(t->timer), deadline);
+    if (!t->armed) {
+        armed++;
+    }
+    t->armed = 1;
+    // The first tick not before the deadline, and never the current one
+    t->expires = (deadline + RESOLUTION - 1) / RESOLUTION;
+    if (t->expires <= wheel.now) {
+        t->expires = wheel.now + 1;
+    }
+    t->armed_at = wheel.now;
+}
+
+/* Cancel a timer in the wheel and in the model.
+
+   Parameters:
+     * t: the timer.
+*/
+void
+cancel(struct test_timer_t *t)
+{
+    timerwheel_cancel(&wheel, &(t->timer));
+    if (t->armed) {
+        armed--;
+    }
+    t->armed = 0;
+}
+
+/* Arm or cancel a random timer, or do nothing.
+
+   Parameters:
+     * now: the current time (ns).
+*/
+void
+random_change(uint64_t now)
+{
+    struct test_timer_t *t = &(timers[random() % TIMERS]);
+
+    switch (random() % 4) {
+        case 0:
+            cancel(t);
+            break;
+        case 1:
+            arm(t, now + random_delay());
+            break;
+        default:
+            break;
+    }
+}
+
+/* Cancel a timer that was just moved down from an upper level, at a tick
+   where the wheel cascades: a timer that expires later in the current 64
+   ticks.
+
+   Parameters:
+     * self: the timer that expired, it is not cancelled.
+*/
+void
+cancel_cascaded(struct test_timer_t *self)
+{
+    for (unsigned int i = 0; i < TIMERS; i++) {
+        if (&(timers[i]) != self && timers[i].armed
+            && timers[i].expires > wheel.now
+            && timers[i].expires < wheel.now + LEVEL_TICKS(0))
+        {
+            cancel(&(timers[i]));
+            cascade_cancels++;
+            return;
+        }
+    }
+}
+
+/* Function called when a timer expires: check it against the model and
+   change other timers, as the callbacks of the programs do.
+
+   Parameters:
+     * timer: the timer that expired.
+*/
+void
+expired(struct timerwheel_timer_t *timer)
+{
+    struct test_timer_t *t = (struct test_timer_t*)timer;
+    uint64_t distance;
+    int level = 0;
+
+    CHECK(t->armed);
+    CHECK(!timerwheel_armed(timer));
+    // At its tick, neither before nor after
+    CHECK(wheel.now == t->expires);
+    CHECK(wheel.now >= last_expired);
+    last_expired = wheel.now;
+    t->armed = 0;
+    armed--;
+    distance = t->expires - t->armed_at;
+    while (level < TIMERWHEEL_LEVELS && distance >= LEVEL_TICKS(level)) {
+        level++;
+    }
+    expired_by_level[level]++;
+    if (!(wheel.now % LEVEL_TICKS(0))) {
+        cancel_cascaded(t);
+    }
+    random_change(wheel.now * RESOLUTION);
+}
+
+// Check that the wheel has expired all the timers due and only them
+void
+check_wheel()
+{
+    uint64_t first = UINT64_MAX, next;
+
+    for (unsigned int i = 0; i < TIMERS; i++) {
+        CHECK(timers[i].armed == timerwheel_armed(&(timers[i].timer)));
+        if (timers[i].armed) {
+            CHECK(timers[i].expires > wheel.now);
+            if (timers[i].expires < first) {
+                first = timers[i].expires;
+            }
+        }
+    }
+    CHECK(wheel.count == armed);
+    // The next advance is never after the first deadline
+    next = timerwheel_next(&wheel);
+    if (!armed) {
+        CHECK(next == 0);
+    } else {
+        CHECK(next > wheel.now * RESOLUTION);
+        CHECK(next <= first * RESOLUTION);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    uint64_t now;
+
+    srandom(1);
+    // Start near the end of the wheel, so the overflow list is soon cascaded
+    now = (LEVEL_TICKS(TIMERWHEEL_LEVELS - 1) - 1000) * RESOLUTION;
+    timerwheel_init(&wheel, RESOLUTION, now);
+    for (unsigned int i = 0; i < TIMERS; i++) {
+        timerwheel_timer_init(&(timers[i].timer), expired);
+        timers[i].armed = 0;
+        arm(&(timers[i]), now + random_delay());
+    }
+    for (unsigned int i = 0; i < ADVANCES; i++) {
+        random_change(now);
+        // As the programs, to the next time given by the wheel, or later
+        if (random() % 2 && timerwheel_next(&wheel)) {
+            now = timerwheel_next(&wheel);
+        } else {
+            now += random_delay();
+        }
+        timerwheel_advance(&wheel, now);
+        CHECK(wheel.now == now / RESOLUTION);
+        check_wheel();
+    }
+    for (int level = 0; level <= TIMERWHEEL_LEVELS; level++) {
+        CHECK(expired_by_level[level] > 0);
+    }
+    CHECK(cascade_cancels > 0);
+    printf(PROGNAME ": expired by level %lu %lu %lu %lu, overflow %lu, "
+        "%lu cancels in cascades: ok\n", expired_by_level[0],
+        expired_by_level[1], expired_by_level[2], expired_by_level[3],
+        expired_by_level[4], cascade_cancels);
+    return 0;
+}
+
@@ -0,0 +1,204 @@
+/* trace.c
+   Compact binary traces of the edges of the buttons.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "trace.h"
+
+#include <errno.h>      // errno
+#include <string.h>     // memcmp
+
+/* Write a number as unsigned LEB128: 7 bits per byte, from the lowest ones,
+   with the highest bit set in all the bytes but the last.
+
+   Parameters:
+     * f: the file.
+     * n: the number.
+
+   Return 0 if the number was written, 1 otherwise.
+*/
+static int
+write_number(FILE *f, uint64_t n)
+{
+    do {
+        if (putc_unlocked((n & 0x7f) | (n > 0x7f ? 0x80 : 0), f) == EOF) {
+            return 1;
+        }
+        n >>= 7;
+    } while (n);
+    return 0;
+}
+
+/* Read a number written as unsigned LEB128.
+
+   Parameters:
+     * f: the file.
+     * n: at output, the number.
+
+   Return 0 if the number was read, 1 at the end of the file before the
+   first byte and -1 if the number is truncated or too long.
+*/
+static int
+read_number(FILE *f, uint64_t *n)
+{
+    int c;
+
+    *n = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        c = getc_unlocked(f);
+        if (c == EOF) {
+            return shift ? -1 : 1;
+        }
+        *n |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Create a trace to record edges in it.
+
+   Parameters:
+     * t: the trace.
+     * path: the path of the file.
+
+   Return 0 if the trace was created, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+trace_create(struct trace_t *t, const char *path)
+{
+    t->f = fopen(path, "we");
+    if (!t->f) {
+        return 1;
+    }
+    t->last = 0;
+    if (fwrite(TRACE_MAGIC, TRACE_MAGIC_LEN, 1, t->f) != 1) {
+        fclose(t->f);
+        t->f = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+/* Record an edge. The edges must be recorded in order of time.
+
+   Parameters:
+     * t: the trace.
+     * pin: the GPIO pin.
+     * level: level of the line after the edge (1 high, 0 low).
+     * timestamp: time of the edge (ns of CLOCK_MONOTONIC).
+
+   Return 0 if the edge was recorded, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+trace_write(struct trace_t *t, uint32_t pin, int level, uint64_t timestamp)
+{
+    // The edges of different lines may come slightly out of order, they are
+    // recorded at the time of the previous one
+    uint64_t delta = timestamp > t->last ? timestamp - t->last : 0;
+
+    t->last += delta;
+    return write_number(t->f, delta)
+        || write_number(t->f, ((uint64_t)pin << 1) | (level ? 1 : 0));
+}
+
+/* Open a trace to replay it.
+
+   Parameters:
+     * t: the trace.
+     * path: the path of the file.
+
+   Return 0 if the trace was opened, 1 otherwise, and errno is set
+   accordingly (EINVAL if the file is not a trace).
+*/
+int
+trace_open(struct trace_t *t, const char *path)
+{
+    char magic[TRACE_MAGIC_LEN];
+
+    t->f = fopen(path, "re");
+    if (!t->f) {
+        return 1;
+    }
+    t->last = 0;
+    if (fread(magic, TRACE_MAGIC_LEN, 1, t->f) != 1
+        || memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN))
+    {
+        fclose(t->f);
+        t->f = NULL;
+        errno = EINVAL;
+        return 1;
+    }
+    return 0;
+}
+
+/* Read the next edge of a trace.
+
+   Parameters:
+     * t: the trace.
+     * pin: at output, the GPIO pin.
+     * level: at output, level of the line after the edge (1 high, 0 low).
+     * timestamp: at output, time of the edge (ns of CLOCK_MONOTONIC).
+
+   Return 0 if an edge was read, 1 at the end of the trace and -1 in case of
+   error, and errno is set accordingly (EINVAL if the trace is truncated).
+*/
+int
+trace_read(struct trace_t *t, uint32_t *pin, int *level,
+    uint64_t *timestamp)
+{
+    uint64_t delta, n;
+    int e;
+
+    e = read_number(t->f, &delta);
+    if (e > 0 && !ferror(t->f)) {
+        return 1;
+    }
+    if (e || read_number(t->f, &n) || (n >> 1) > UINT32_MAX) {
+        // If it's not an error reading the file, the trace is truncated
+        if (!ferror(t->f)) {
+            errno = EINVAL;
+        }
+        return -1;
+    }
+    t->last += delta;
+    *timestamp = t->last;
+    *pin = n >> 1;
+    *level = n & 1;
+    return 0;
+}
+
+/* Close a trace. The edges recorded are written to the file.
+
+   Parameters:
+     * t: the trace.
+
+   Return 0 if the trace was closed, 1 if the last edges couldn't be written.
+*/
+int
+trace_close(struct trace_t *t)
+{
+    return fclose(t->f) ? 1 : 0;
+}
+
@@ -0,0 +1,110 @@
+/* trace.h
+   Compact binary traces of the edges of the buttons.
+
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>     // uint64_t
+#include <stdio.h>      // FILE
+
+// First bytes of a trace
+#define TRACE_MAGIC     "BTRACE1\n"
+#define TRACE_MAGIC_LEN 8
+
+// A trace, opened to record or to replay. After the magic, each edge is
+// written as two unsigned LEB128 numbers: the time since the previous edge
+// (ns) and the pin shifted one bit to the left, with the level in the lowest
+// bit. Most of the edges take 4 to 6 bytes.
+struct trace_t {
+    // The file of the trace
+    FILE *f;
+
+    // Time of the last edge written or read (ns of CLOCK_MONOTONIC)
+    uint64_t last;
+};
+
+/* Create a trace to record edges in it.
+
+   Parameters:
+     * t: the trace.
+     * path: the path of the file.
+
+   Return 0 if the trace was created, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+trace_create(struct trace_t *t, const char *path);
+
+/* Record an edge. The edges must be recorded in order of time.
+
+   Parameters:
+     * t: the trace.
+     * pin: the GPIO pin.
+     * level: level of the line after the edge (1 high, 0 low).
+     * timestamp: time of the edge (ns of CLOCK_MONOTONIC).
+
+   Return 0 if the edge was recorded, 1 otherwise, and errno is set
+   accordingly.
+*/
+int
+trace_write(struct trace_t *t, uint32_t pin, int level, uint64_t timestamp);
+
+/* Open a trace to replay it.
+
+   Parameters:
+     * t: the trace.
+     * path: the path of the file.
+
+   Return 0 if the trace was opened, 1 otherwise, and errno is set
+   accordingly (EINVAL if the file is not a trace).
+*/
+int
+trace_open(struct trace_t *t, const char *path);
+
+/* Read the next edge of a trace.
+
+   Parameters:
+     * t: the trace.
+     * pin: at output, the GPIO pin.
+     * level: at output, level of the line after the edge (1 high, 0 low).
+     * timestamp: at output, time of the edge (ns of CLOCK_MONOTONIC).
+
+   Return 0 if an edge was read, 1 at the end of the trace and -1 in case of
+   error, and errno is set accordingly (EINVAL if the trace is truncated).
+*/
+int
+trace_read(struct trace_t *t, uint32_t *pin, int *level,
+    uint64_t *timestamp);
+
+/* Close a trace. The edges recorded are written to the file.
+
+   Parameters:
+     * t: the trace.
+
+   Return 0 if the trace was closed, 1 if the last edges couldn't be written.
+*/
+int
+trace_close(struct trace_t *t);
+
+#endif
+
@@ -0,0 +1,99 @@
+/* vector.c
+   Implements a growable array of pointers.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include "vector.h"
+
+#include <stdlib.h> // malloc
+#include <string.h> // memcpy
+
+/* Initialize the vector, empty. Nothing is allocated until the first element
+   is added.
+
+   Parameters:
+     * v: the vector.
+     * a: the arena where the array is allocated, or NULL to allocate it with
+         malloc.
+*/
+void
+vector_init(struct vector_t *v, struct arena_t *a)
+{
+    v->elems = NULL;
+    v->size = 0;
+    v->capacity = 0;
+    v->arena = a;
+}
+
+/* Add an element at the end of the vector. The array doubles its size when
+   it's full, so the elements that were in the vector may move.
+
+   Parameters:
+     * v: the vector.
+     * elem: the element to add.
+
+   Return 0 if the element was correctly added, 1 otherwise. In case of error,
+   errno is set accordingly.
+*/
+int
+vector_add(struct vector_t *v, void *elem)
+{
+    size_t capacity;
+    void **elems;
+
+    if (v->size == v->capacity) {
+        // Most vectors keep a single element, so start with one
+        capacity = v->capacity ? v->capacity * 2 : 1;
+        if (v->arena) {
+            // The old array is left in the arena
+            elems = (void**)arena_alloc(v->arena, sizeof(void*) * capacity);
+            if (elems && v->size) {
+                memcpy(elems, v->elems, sizeof(void*) * v->size);
+            }
+        } else {
+            elems = (void**)realloc(v->elems, sizeof(void*) * capacity);
+        }
+        if (!elems) {
+            return 1;
+        }
+        v->elems = elems;
+        v->capacity = capacity;
+    }
+    v->elems[v->size++] = elem;
+    return 0;
+}
+
+/* Free the array of the vector. The elements are not freed, and an array
+   allocated from an arena is freed with the arena.
+
+   Parameters:
+     * v: the vector.
+*/
+void
+vector_free(struct vector_t *v)
+{
+    if (!v->arena) {
+        free(v->elems);
+    }
+    v->elems = NULL;
+    v->size = 0;
+    v->capacity = 0;
+}
+
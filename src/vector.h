@@ -0,0 +1,77 @@
+/* vector.h
+   A growable array of pointers, contiguous in memory.
+
+   Copyright 2018 Antonio Serrano Hernandez
+
+   This file is part of rfsutils.
+
+   rfsutils is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   rfsutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with rfsutils; see the file COPYING.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stddef.h>     // size_t
+
+#include "arena.h"
+
+// Vector descriptor. The elements can be read directly, elems[0] to
+// elems[size - 1].
+struct vector_t {
+    // The elements
+    void **elems;
+
+    // Number of elements and size of the array
+    size_t size, capacity;
+
+    // Arena of the array, NULL if it is allocated with malloc
+    struct arena_t *arena;
+};
+
+/* Initialize the vector, empty. Nothing is allocated until the first element
+   is added.
+
+   Parameters:
+     * v: the vector.
+     * a: the arena where the array is allocated, or NULL to allocate it with
+         malloc.
+*/
+void
+vector_init(struct vector_t *v, struct arena_t *a);
+
+/* Add an element at the end of the vector. The array doubles its size when
+   it's full, so the elements that were in the vector may move.
+
+   Parameters:
+     * v: the vector.
+     * elem: the element to add.
+
+   Return 0 if the element was correctly added, 1 otherwise. In case of error,
+   errno is set accordingly.
+*/
+int
+vector_add(struct vector_t *v, void *elem);
+
+/* Free the array of the vector. The elements are not freed, and an array
+   allocated from an arena is freed with the arena.
+
+   Parameters:
+     * v: the vector.
+*/
+void
+vector_free(struct vector_t *v);
+
+#endif
+